@@ -47,9 +47,25 @@ THE SOFTWARE.
 // binned BVH building: bin count
 #define BVHBINS 8
 
+// multi-threaded BVH building: nodes with at least this many primitives
+// are binned by all threads together
+#define BVH_MTBINMIN 65536
+
+// spatial splits (BuildHQ): bins per axis, the default memory budget (extra
+// references, as a fraction of the primitive count), and the minimum overlap
+// of the children of an object split, relative to the root surface area, for
+// which spatial splits are considered (Stich et al., 2009)
+#define BVH_SBVHBINS 16
+#define BVH_SBVHBUDGET 0.3f
+#define BVH_SBVHALPHA 1e-5f
+
 // include fast AVX BVH builder
 #define BVH_USEAVX
 
+// packet traversal: when fewer rays than this remain active in a subtree,
+// they continue as single rays
+#define BVH_PACKETMINRAYS 3
+
 // ============================================================================
 //
 //        P R E L I M I N A R I E S
@@ -71,6 +87,16 @@ THE SOFTWARE.
 // https://stackoverflow.com/questions/32612881/why-use-mm-malloc-as-opposed-to-aligned-malloc-alligned-alloc-or-posix-mem
 #endif
 
+#ifdef TINYBVH_IMPLEMENTATION
+// standard library headers for the multi-threaded builder and the optimizer
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#endif
+
 namespace tinybvh {
 
 #ifdef _MSC_VER
@@ -209,8 +235,40 @@ struct Ray
 	Intersection hit; // total ray size: 64 bytes
 };
 
+// Ray packet for BVH::Intersect8 and BVH::Intersect16, as a structure of
+// arrays. Packets work best for coherent rays, e.g. primary rays for a
+// 4x2 or 4x4 pixel tile, or shadow rays towards a point light from those.
+template <int N> struct ALIGNED( 64 ) RayPacket
+{
+	void Set( const int i, const Ray& ray )
+	{
+		Ox[i] = ray.O.x, Oy[i] = ray.O.y, Oz[i] = ray.O.z, Dx[i] = ray.D.x, Dy[i] = ray.D.y, Dz[i] = ray.D.z;
+		rDx[i] = ray.rD.x, rDy[i] = ray.rD.y, rDz[i] = ray.rD.z;
+		t[i] = ray.hit.t, u[i] = ray.hit.u, v[i] = ray.hit.v, prim[i] = ray.hit.prim;
+	}
+	Ray Get( const int i ) const
+	{
+		Ray ray;
+		ray.O = bvhvec3( Ox[i], Oy[i], Oz[i] ), ray.D = bvhvec3( Dx[i], Dy[i], Dz[i] ), ray.rD = bvhvec3( rDx[i], rDy[i], rDz[i] );
+		ray.hit.t = t[i], ray.hit.u = u[i], ray.hit.v = v[i], ray.hit.prim = prim[i];
+		return ray;
+	}
+	float Ox[N], Oy[N], Oz[N];		// ray origins
+	float Dx[N], Dy[N], Dz[N];		// ray directions
+	float rDx[N], rDy[N], rDz[N];	// reciprocal directions
+	float t[N], u[N], v[N];			// per-ray intersection results, as in Intersection
+	uint prim[N];
+};
+typedef RayPacket<8> RayPacket8;
+typedef RayPacket<16> RayPacket16;
+
+template <int M> class MBVH;
+template <int M> class QMBVH;
+
 class BVH
 {
+	template <int M> friend class MBVH;
+	template <int M> friend class QMBVH;
 public:
 	struct BVHNode
 	{
@@ -236,9 +294,9 @@ public:
 	~BVH()
 	{
 		ALIGNED_FREE( bvhNode );
-		delete triIdx;
-		delete fragment;
-		bvhNode = 0, triIdx = 0, fragment = 0;
+		delete[] triIdx;
+		delete[] fragment;
+		bvhNode = 0, triIdx = 0, fragment = 0, allocatedNodes = 0;
 	}
 	float SAHCost( const uint nodeIdx = 0 ) const
 	{
@@ -261,9 +319,51 @@ public:
 	}
 	void Build( const bvhvec4* vertices, const uint primCount );
 	void BuildAVX( const bvhvec4* vertices, const uint primCount );
+	void BuildMT( const bvhvec4* vertices, const uint primCount, uint threadCount = 0 /* 0: all cores */ );
+	// spatial split BVH (SBVH): slower to build, faster to trace for scenes with
+	// large or long, thin triangles. 'budget' limits the extra references to
+	// triangles that straddle a split plane, as a fraction of primCount.
+	void BuildHQ( const bvhvec4* vertices, const uint primCount, const float budget = BVH_SBVHBUDGET );
 	void Refit();
-	int Intersect( Ray& ray ) const;
+	// Lower the SAH cost of a built tree by moving subtrees to better places
+	// ('reinsertion'). Stops when a pass finds no improvement, after
+	// 'iterations' passes, or once 'maxSeconds' have elapsed.
+	void Optimize( const uint iterations = 25, const float maxSeconds = 1e30f, uint threadCount = 0 /* 0: all cores */ );
+	int Intersect( Ray& ray, const uint nodeIdx = 0 ) const;
+	// packet traversal; bit i of 'active' enables ray i. Requires BVH_USEAVX.
+	int Intersect8( RayPacket8& packet, const uint active = 0xff ) const;
+	int Intersect16( RayPacket16& packet, const uint active = 0xffff ) const;
+	// occlusion queries: true if anything is hit between the ray origin and
+	// ray.hit.t; cheaper than Intersect, which needs the nearest hit.
+	// The array version sets bit i of 'occluded' (count / 32 words, rounded
+	// up) for ray i and returns the number of occluded rays. The packet
+	// versions return the occluded rays as a mask.
+	bool IsOccluded( const Ray& ray, const uint nodeIdx = 0 ) const;
+	int IsOccluded( const Ray* rays, const uint count, uint* occluded ) const;
+	uint IsOccluded8( const RayPacket8& packet, const uint active = 0xff ) const;
+	uint IsOccluded16( const RayPacket16& packet, const uint active = 0xffff ) const;
 private:
+	template <int N> int IntersectPacket( RayPacket<N>& packet, const uint active ) const;
+	template <int N> uint OccludedPacket( const RayPacket<N>& packet, const uint active ) const;
+	bool OccludedTri( const Ray& ray, const uint triIdx ) const;
+	template <int N> int IntersectSingle( RayPacket<N>& packet, const uint lanes, const uint nodeIdx ) const;
+	void PrepareBuild( const bvhvec4* vertices, const uint primCount, const uint slots );
+	struct BVHBins
+	{
+		bvhvec3 bmin[3][BVHBINS], bmax[3][BVHBINS];
+		uint count[3][BVHBINS];
+	};
+	void BinNode( BVHBins& bins, const BVHNode& node, const uint first, const uint count ) const;
+	struct BVHSplit
+	{
+		float cost;				// SAH cost of the split; 1e30f if there is no valid split
+		uint axis, pos;			// split axis, and the last bin on the left side
+		bvhvec3 lmin, lmax, rmin, rmax; // child bounds
+	};
+	BVHSplit FindObjectSplit( const BVHNode& node, const bvhvec3& minDim, const BVHBins& bins ) const;
+	int ObjectSplitBin( const BVHNode& node, const uint axis, const uint fi ) const;
+	bool SplitNode( const uint nodeIdx, uint& nodePtr, const bvhvec3& minDim, const BVHBins& bins );
+	void Subdivide( uint nodeIdx, uint& nodePtr, const bvhvec3& minDim );
 	void IntersectTri( Ray& ray, const uint triIdx ) const;
 	static float IntersectAABB( const Ray& ray, const bvhvec3& aabbMin, const bvhvec3& aabbMax );
 	static float SA( const bvhvec3& aabbMin, const bvhvec3& aabbMax )
@@ -278,9 +378,75 @@ public:
 	uint* triIdx = 0;			// primitive index array
 	uint idxCount = 0;			// number of indices in triIdx. May exceed triCount * 3 for SBVH.
 	uint newNodePtr = 0;		// number of reserved nodes
+	uint allocatedNodes = 0;	// size of the node pool; triIdx and fragment have half as many slots
 	BVHNode* bvhNode = 0;		// BVH node pool. Root is always in node 0.
 };
 
+// Wide BVH, with M = 4 or 8 children per node. The child bounds are stored
+// as a structure of arrays, so that a single SSE (BVH4) or AVX (BVH8) slab
+// test covers all children of a node. A wide BVH is obtained by collapsing a
+// binary BVH; it uses the triangles and indices of that BVH, which must
+// therefore outlive it.
+template <int M> class MBVH
+{
+public:
+	struct ALIGNED( 64 ) MBVHNode
+	{
+		float xmin[M], xmax[M], ymin[M], ymax[M], zmin[M], zmax[M];
+		uint child[M];			// child node index, or first index in triIdx for a leaf; 0 for empty slots
+		uint triCount[M];		// > 0 for leaves; 0 for interior nodes and empty slots
+	};
+	MBVH() = default;
+	~MBVH()
+	{
+		ALIGNED_FREE( mbvhNode );
+		mbvhNode = 0;
+	}
+	void Convert( const BVH& original );
+	int Intersect( Ray& ray ) const;
+private:
+	void CollapseNode( const uint wideIdx, const uint binaryIdx );
+public:
+	const BVH* bvh = 0;			// source BVH; provides tris and triIdx
+	MBVHNode* mbvhNode = 0;		// wide node pool. Root is always in node 0.
+	uint nodeCount = 0;			// number of nodes in use
+};
+typedef MBVH<4> BVH4;
+typedef MBVH<8> BVH8;
+
+// Quantized wide BVH: the layout of MBVH, with the child bounds stored as
+// 8-bit offsets in a per-node frame, rounded outwards. A node takes 80 (M = 4)
+// or 128 (M = 8) bytes instead of 128 or 256; bounds are dequantized during
+// traversal. Like MBVH, it uses the triangles and indices of the source BVH.
+// Leaf sizes are stored in 16 bits: a leaf may hold at most 65535 triangles.
+template <int M> class QMBVH
+{
+public:
+	struct ALIGNED( 16 ) QMBVHNode
+	{
+		float ox, oy, oz;		// frame origin: the minimum of the child bounds
+		float sx, sy, sz;		// frame scale: a power of two; bounds are o + q * s
+		uint childMask;			// bit i is set if slot i is in use
+		unsigned char qxmin[M], qxmax[M], qymin[M], qymax[M], qzmin[M], qzmax[M];
+		uint child[M];			// child node index, or first index in triIdx for a leaf
+		unsigned short triCount[M]; // > 0 for leaves; 0 for interior nodes and empty slots
+	};
+	QMBVH() = default;
+	~QMBVH()
+	{
+		ALIGNED_FREE( qnode );
+		qnode = 0;
+	}
+	void Convert( const BVH& original );
+	int Intersect( Ray& ray ) const;
+public:
+	const BVH* bvh = 0;			// source BVH; provides tris and triIdx
+	QMBVHNode* qnode = 0;		// quantized node pool. Root is always in node 0.
+	uint nodeCount = 0;			// number of nodes in use
+};
+typedef QMBVH<4> QBVH4;
+typedef QMBVH<8> QBVH8;
+
 // ============================================================================
 //
 //        I M P L E M E N T A T I O N
@@ -296,21 +462,28 @@ public:
 // Faster code, using SSE/AVX, is available for x64 CPUs.
 // For GPU rendering the resulting BVH should be converted to a more optimal
 // format after construction.
-void BVH::Build( const bvhvec4* vertices, const uint primCount )
+// Prepare a (re)build: grow the buffers if they are too small for 'slots'
+// triangle references, and reset the node pool and counts. Any builder may
+// follow any other, with a different triangle count or vertex array.
+void BVH::PrepareBuild( const bvhvec4* vertices, const uint primCount, const uint slots )
 {
-	// reset node pool
-	newNodePtr = 2, triCount = primCount;
-	if (!bvhNode)
+	if (slots * 2 > allocatedNodes)
 	{
-		bvhNode = (BVHNode*)ALIGNED_MALLOC( triCount * 2 * sizeof( BVHNode ) );
+		ALIGNED_FREE( bvhNode );
+		delete[] triIdx;
+		delete[] fragment;
+		bvhNode = (BVHNode*)ALIGNED_MALLOC( slots * 2 * sizeof( BVHNode ) );
 		memset( &bvhNode[1], 0, 32 );	// node 1 remains unused, for cache line alignment.
-		triIdx = new uint[triCount];
-		tris = (bvhvec4*)vertices;		// note: we're not copying this data; don't delete.
-		fragment = new Fragment[triCount];
-		idxCount = primCount;
-		triCount = primCount;
+		triIdx = new uint[slots];
+		fragment = new Fragment[slots];
+		allocatedNodes = slots * 2;
 	}
-	else assert( triCount == primCount ); // don't change triangle count between builds.
+	tris = (bvhvec4*)vertices;		// note: we're not copying this data; don't delete.
+	triCount = idxCount = primCount, newNodePtr = 2;
+}
+void BVH::Build( const bvhvec4* vertices, const uint primCount )
+{
+	PrepareBuild( vertices, primCount, primCount );
 	// assign all triangles to the root node
 	BVHNode& root = bvhNode[0];
 	root.leftFirst = 0, root.triCount = triCount, root.aabbMin = bvhvec3( 1e30f ), root.aabbMax = bvhvec3( -1e30f );
@@ -323,85 +496,410 @@ void BVH::Build( const bvhvec4* vertices, const uint primCount )
 		root.aabbMax = tinybvh_max( root.aabbMax, fragment[i].bmax ), triIdx[i] = i;
 	}
 	// subdivide recursively
-	uint task[256], taskCount = 0, nodeIdx = 0;
-	bvhvec3 minDim = (root.aabbMax - root.aabbMin) * 1e-20f, bestLMin = 0, bestLMax = 0, bestRMin = 0, bestRMax = 0;
+	const bvhvec3 minDim = (root.aabbMax - root.aabbMin) * 1e-20f;
+	Subdivide( 0, newNodePtr, minDim );
+}
+
+// Binning and split evaluation for a single node, shared by Build and BuildMT.
+// BinNode bins the fragments in a range of the node's primitives; bins of
+// several ranges can be merged, since they only hold bounds and counts.
+void BVH::BinNode( BVHBins& bins, const BVHNode& node, const uint first, const uint count ) const
+{
+	for (uint a = 0; a < 3; a++) for (uint i = 0; i < BVHBINS; i++) bins.bmin[a][i] = 1e30f, bins.bmax[a][i] = -1e30f, bins.count[a][i] = 0;
+	const bvhvec3 rpd3 = bvhvec3( BVHBINS / (node.aabbMax - node.aabbMin) ), nmin3 = node.aabbMin;
+	for (uint i = 0; i < count; i++) // process all tris for x,y and z at once
+	{
+		const uint fi = triIdx[first + i];
+		bvhint3 bi = bvhint3( ((fragment[fi].bmin + fragment[fi].bmax) * 0.5f - nmin3) * rpd3 );
+		bi.x = clamp( bi.x, 0, BVHBINS - 1 ), bi.y = clamp( bi.y, 0, BVHBINS - 1 ), bi.z = clamp( bi.z, 0, BVHBINS - 1 );
+		bins.bmin[0][bi.x] = tinybvh_min( bins.bmin[0][bi.x], fragment[fi].bmin );
+		bins.bmax[0][bi.x] = tinybvh_max( bins.bmax[0][bi.x], fragment[fi].bmax ), bins.count[0][bi.x]++;
+		bins.bmin[1][bi.y] = tinybvh_min( bins.bmin[1][bi.y], fragment[fi].bmin );
+		bins.bmax[1][bi.y] = tinybvh_max( bins.bmax[1][bi.y], fragment[fi].bmax ), bins.count[1][bi.y]++;
+		bins.bmin[2][bi.z] = tinybvh_min( bins.bmin[2][bi.z], fragment[fi].bmin );
+		bins.bmax[2][bi.z] = tinybvh_max( bins.bmax[2][bi.z], fragment[fi].bmax ), bins.count[2][bi.z]++;
+	}
+}
+
+// FindObjectSplit finds the best split for a binned node. SplitNode uses it
+// to partition the primitives of node nodeIdx and creates the child nodes at
+// nodePtr. Returns false if the node should remain a leaf.
+BVH::BVHSplit BVH::FindObjectSplit( const BVHNode& node, const bvhvec3& minDim, const BVHBins& bins ) const
+{
+	BVHSplit best;
+	best.cost = 1e30f, best.axis = best.pos = 0;
+	best.lmin = best.lmax = best.rmin = best.rmax = 0;
+	// calculate per-split totals
+	for (int a = 0; a < 3; a++) if ((node.aabbMax.cell[a] - node.aabbMin.cell[a]) > minDim.cell[a])
+	{
+		bvhvec3 lBMin[BVHBINS - 1], rBMin[BVHBINS - 1], l1 = 1e30f, l2 = -1e30f;
+		bvhvec3 lBMax[BVHBINS - 1], rBMax[BVHBINS - 1], r1 = 1e30f, r2 = -1e30f;
+		float ANL[BVHBINS - 1], ANR[BVHBINS - 1];
+		for (uint lN = 0, rN = 0, i = 0; i < BVHBINS - 1; i++)
+		{
+			lBMin[i] = l1 = tinybvh_min( l1, bins.bmin[a][i] );
+			rBMin[BVHBINS - 2 - i] = r1 = tinybvh_min( r1, bins.bmin[a][BVHBINS - 1 - i] );
+			lBMax[i] = l2 = tinybvh_max( l2, bins.bmax[a][i] );
+			rBMax[BVHBINS - 2 - i] = r2 = tinybvh_max( r2, bins.bmax[a][BVHBINS - 1 - i] );
+			lN += bins.count[a][i], rN += bins.count[a][BVHBINS - 1 - i];
+			ANL[i] = lN == 0 ? 1e30f : ((l2 - l1).halfArea() * (float)lN);
+			ANR[BVHBINS - 2 - i] = rN == 0 ? 1e30f : ((r2 - r1).halfArea() * (float)rN);
+		}
+		// evaluate bin totals to find best position for object split
+		for (uint i = 0; i < BVHBINS - 1; i++)
+		{
+			const float C = ANL[i] + ANR[i];
+			if (C < best.cost)
+			{
+				best.cost = C, best.axis = a, best.pos = i;
+				best.lmin = lBMin[i], best.rmin = rBMin[i], best.lmax = lBMax[i], best.rmax = rBMax[i];
+			}
+		}
+	}
+	return best;
+}
+
+// Bin of the centroid of fragment fi along the split axis, as used by BinNode.
+int BVH::ObjectSplitBin( const BVHNode& node, const uint axis, const uint fi ) const
+{
+	const float rpd = BVHBINS / (node.aabbMax.cell[axis] - node.aabbMin.cell[axis]), nmin = node.aabbMin.cell[axis];
+	const int bi = (int)(((fragment[fi].bmin.cell[axis] + fragment[fi].bmax.cell[axis]) * 0.5f - nmin) * rpd);
+	return clamp( bi, 0, BVHBINS - 1 );
+}
+
+bool BVH::SplitNode( const uint nodeIdx, uint& nodePtr, const bvhvec3& minDim, const BVHBins& bins )
+{
+	BVHNode& node = bvhNode[nodeIdx];
+	const BVHSplit split = FindObjectSplit( node, minDim, bins );
+	if (split.cost >= node.CalculateNodeCost()) return false; // not splitting is better.
+	// in-place partition
+	uint j = node.leftFirst + node.triCount, src = node.leftFirst;
+	for (uint i = 0; i < node.triCount; i++)
+	{
+		if ((uint)ObjectSplitBin( node, split.axis, triIdx[src] ) <= split.pos) src++; else swap( triIdx[src], triIdx[--j] );
+	}
+	// create child nodes
+	uint leftCount = src - node.leftFirst, rightCount = node.triCount - leftCount;
+	if (leftCount == 0 || rightCount == 0) return false; // should not happen.
+	const int lci = nodePtr++, rci = nodePtr++;
+	bvhNode[lci].aabbMin = split.lmin, bvhNode[lci].aabbMax = split.lmax;
+	bvhNode[lci].leftFirst = node.leftFirst, bvhNode[lci].triCount = leftCount;
+	bvhNode[rci].aabbMin = split.rmin, bvhNode[rci].aabbMax = split.rmax;
+	bvhNode[rci].leftFirst = j, bvhNode[rci].triCount = rightCount;
+	node.leftFirst = lci, node.triCount = 0;
+	return true;
+}
+
+// Subdivide the subtree under nodeIdx; new nodes are taken from nodePtr.
+void BVH::Subdivide( uint nodeIdx, uint& nodePtr, const bvhvec3& minDim )
+{
+	uint task[256], taskCount = 0;
+	BVHBins bins;
 	while (1)
 	{
 		while (1)
 		{
-			BVHNode& node = bvhNode[nodeIdx];
-			// find optimal object split
-			bvhvec3 binMin[3][BVHBINS], binMax[3][BVHBINS];
-			for (uint a = 0; a < 3; a++) for (uint i = 0; i < BVHBINS; i++) binMin[a][i] = 1e30f, binMax[a][i] = -1e30f;
-			uint count[3][BVHBINS] = { 0 };
-			const bvhvec3 rpd3 = bvhvec3( BVHBINS / (node.aabbMax - node.aabbMin) ), nmin3 = node.aabbMin;
-			for (uint i = 0; i < node.triCount; i++) // process all tris for x,y and z at once
+			const BVHNode& node = bvhNode[nodeIdx];
+			BinNode( bins, node, node.leftFirst, node.triCount );
+			if (!SplitNode( nodeIdx, nodePtr, minDim, bins )) break;
+			// recurse
+			task[taskCount++] = node.leftFirst + 1, nodeIdx = node.leftFirst;
+		}
+		// fetch subdivision task from stack
+		if (taskCount == 0) break; else nodeIdx = task[--taskCount];
+	}
+}
+
+// Multi-threaded binned-SAH-builder, using std::thread. Yields the same tree
+// as Build, with a different node order. The top levels of the tree are
+// built one node at a time; the binning of large nodes is distributed over
+// all threads. Once nodes are small enough to balance the load, the remaining
+// subtrees are built as independent tasks, each with its own range of nodes.
+// Finally, the unused space between these ranges is removed.
+template <class F> static void tinybvh_parallel( const uint threadCount, F f )
+{
+	std::vector<std::thread> threads;
+	for (uint t = 1; t < threadCount; t++) threads.emplace_back( f, t );
+	f( 0 );
+	for (auto& t : threads) t.join();
+}
+void BVH::BuildMT( const bvhvec4* vertices, const uint primCount, uint threadCount )
+{
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+	PrepareBuild( vertices, primCount, primCount );
+	// initialize fragments and root node bounds, one slice of the input per thread
+	std::vector<bvhvec3> sliceMin( threadCount, bvhvec3( 1e30f ) ), sliceMax( threadCount, bvhvec3( -1e30f ) );
+	tinybvh_parallel( threadCount, [&]( const uint t ) {
+		for (uint last = (uint)((uint64_t)triCount * (t + 1) / threadCount), i = (uint)((uint64_t)triCount * t / threadCount); i < last; i++)
+		{
+			fragment[i].bmin = tinybvh_min( tinybvh_min( tris[i * 3], tris[i * 3 + 1] ), tris[i * 3 + 2] );
+			fragment[i].bmax = tinybvh_max( tinybvh_max( tris[i * 3], tris[i * 3 + 1] ), tris[i * 3 + 2] );
+			sliceMin[t] = tinybvh_min( sliceMin[t], fragment[i].bmin );
+			sliceMax[t] = tinybvh_max( sliceMax[t], fragment[i].bmax ), triIdx[i] = i;
+		}
+	} );
+	BVHNode& root = bvhNode[0];
+	root.leftFirst = 0, root.triCount = triCount, root.aabbMin = bvhvec3( 1e30f ), root.aabbMax = bvhvec3( -1e30f );
+	for (uint t = 0; t < threadCount; t++)
+		root.aabbMin = tinybvh_min( root.aabbMin, sliceMin[t] ), root.aabbMax = tinybvh_max( root.aabbMax, sliceMax[t] );
+	const bvhvec3 minDim = (root.aabbMax - root.aabbMin) * 1e-20f;
+	// top levels: split nodes until there are enough tasks to keep all threads busy
+	const uint taskSize = std::max( triCount / (threadCount * 8), 1024u );
+	std::vector<uint> pending( 1, 0 ), subtree;
+	std::vector<BVHBins> threadBins( threadCount );
+	BVHBins bins;
+	while (!pending.empty())
+	{
+		const uint nodeIdx = pending.back();
+		pending.pop_back();
+		const BVHNode& node = bvhNode[nodeIdx];
+		if (node.triCount <= taskSize || threadCount == 1) { subtree.push_back( nodeIdx ); continue; }
+		if (node.triCount < BVH_MTBINMIN) BinNode( bins, node, node.leftFirst, node.triCount ); else
+		{
+			// parallel binning: each thread bins a slice of the primitives, then the bins are merged
+			tinybvh_parallel( threadCount, [&]( const uint t ) {
+				const uint first = (uint)((uint64_t)node.triCount * t / threadCount);
+				const uint last = (uint)((uint64_t)node.triCount * (t + 1) / threadCount);
+				BinNode( threadBins[t], node, node.leftFirst + first, last - first );
+			} );
+			bins = threadBins[0];
+			for (uint t = 1; t < threadCount; t++) for (uint a = 0; a < 3; a++) for (uint i = 0; i < BVHBINS; i++)
 			{
-				const uint fi = triIdx[node.leftFirst + i];
-				bvhint3 bi = bvhint3( ((fragment[fi].bmin + fragment[fi].bmax) * 0.5f - nmin3) * rpd3 );
-				bi.x = clamp( bi.x, 0, BVHBINS - 1 ), bi.y = clamp( bi.y, 0, BVHBINS - 1 ), bi.z = clamp( bi.z, 0, BVHBINS - 1 );
-				binMin[0][bi.x] = tinybvh_min( binMin[0][bi.x], fragment[fi].bmin );
-				binMax[0][bi.x] = tinybvh_max( binMax[0][bi.x], fragment[fi].bmax ), count[0][bi.x]++;
-				binMin[1][bi.y] = tinybvh_min( binMin[1][bi.y], fragment[fi].bmin );
-				binMax[1][bi.y] = tinybvh_max( binMax[1][bi.y], fragment[fi].bmax ), count[1][bi.y]++;
-				binMin[2][bi.z] = tinybvh_min( binMin[2][bi.z], fragment[fi].bmin );
-				binMax[2][bi.z] = tinybvh_max( binMax[2][bi.z], fragment[fi].bmax ), count[2][bi.z]++;
+				bins.bmin[a][i] = tinybvh_min( bins.bmin[a][i], threadBins[t].bmin[a][i] );
+				bins.bmax[a][i] = tinybvh_max( bins.bmax[a][i], threadBins[t].bmax[a][i] );
+				bins.count[a][i] += threadBins[t].count[a][i];
 			}
-			// calculate per-split totals
-			float splitCost = 1e30f;
-			uint bestAxis = 0, bestPos = 0;
-			for (int a = 0; a < 3; a++) if ((node.aabbMax[a] - node.aabbMin[a]) > minDim[a])
+		}
+		if (SplitNode( nodeIdx, newNodePtr, minDim, bins ))
+			pending.push_back( node.leftFirst + 1 ), pending.push_back( node.leftFirst );
+	}
+	// reserve nodes for the subtrees: a subtree with N primitives needs at most
+	// 2 * (N - 1) nodes below its root. With the nodes used so far, this never
+	// exceeds the 2 * triCount nodes of the pool.
+	std::sort( subtree.begin(), subtree.end(), [&]( const uint a, const uint b ) { return bvhNode[a].triCount > bvhNode[b].triCount; } );
+	const uint subtreeCount = (uint)subtree.size();
+	std::vector<uint> base( subtreeCount ), used( subtreeCount );
+	for (uint nodePtr = newNodePtr, i = 0; i < subtreeCount; i++) base[i] = nodePtr, nodePtr += 2 * (bvhNode[subtree[i]].triCount - 1);
+	// build the subtrees, largest first
+	std::atomic<uint> nextTask( 0 );
+	tinybvh_parallel( threadCount, [&]( const uint ) {
+		for (uint i; (i = nextTask++) < subtreeCount;)
+		{
+			uint nodePtr = base[i];
+			Subdivide( subtree[i], nodePtr, minDim );
+			used[i] = nodePtr - base[i];
+		}
+	} );
+	// compact the node pool; nodes move down, so child indices decrease by the same amount
+	for (uint i = 0; i < subtreeCount; i++)
+	{
+		const uint delta = base[i] - newNodePtr;
+		if (delta > 0 && used[i] > 0)
+		{
+			memmove( bvhNode + newNodePtr, bvhNode + base[i], used[i] * sizeof( BVHNode ) );
+			for (uint j = 0; j < used[i]; j++) if (!bvhNode[newNodePtr + j].isLeaf()) bvhNode[newNodePtr + j].leftFirst -= delta;
+			bvhNode[subtree[i]].leftFirst -= delta; // the subtree root is not a leaf, since used[i] > 0
+		}
+		newNodePtr += used[i];
+	}
+}
+
+// Bounds of the part of the triangle of fragment f between planes lo and hi
+// along axis a, limited to the bounds of the fragment. Returns false if the
+// triangle does not overlap the slab.
+static bool tinybvh_clip( const bvhvec4* tris, const BVH::Fragment& f, const int a, const float lo, const float hi, bvhvec3& bmin, bvhvec3& bmax )
+{
+	const float plane[2] = { lo, hi };
+	bmin = bvhvec3( 1e30f ), bmax = bvhvec3( -1e30f );
+	for (uint i = 0; i < 3; i++)
+	{
+		// vertices inside the slab and intersections of the edges with the planes
+		const bvhvec3 v0 = tris[f.primIdx * 3 + i], v1 = tris[f.primIdx * 3 + (i + 1) % 3];
+		const float p0 = v0.cell[a], p1 = v1.cell[a];
+		if (p0 >= lo && p0 <= hi) bmin = tinybvh_min( bmin, v0 ), bmax = tinybvh_max( bmax, v0 );
+		for (uint j = 0; j < 2; j++) if ((p0 < plane[j] && p1 > plane[j]) || (p0 > plane[j] && p1 < plane[j]))
+		{
+			const bvhvec3 P = v0 + (v1 - v0) * ((plane[j] - p0) / (p1 - p0));
+			bmin = tinybvh_min( bmin, P ), bmax = tinybvh_max( bmax, P );
+		}
+	}
+	bmin = tinybvh_max( bmin, f.bmin ), bmax = tinybvh_min( bmax, f.bmax );
+	bmin.cell[a] = tinybvh_max( bmin.cell[a], lo ), bmax.cell[a] = tinybvh_min( bmax.cell[a], hi );
+	return bmin.x <= bmax.x && bmin.y <= bmax.y && bmin.z <= bmax.z;
+}
+
+// Spatial split BVH builder, after "Spatial Splits in Bounding Volume
+// Hierarchies", Stich et al., 2009. Each node considers the best binned
+// object split and, if its children overlap, a spatial split, which clips
+// the triangles that straddle the split plane, so that they are referenced
+// by both children. Each node owns a slice of triIdx with room for its
+// duplicates; a spatial split that would exceed it is not used. Finally,
+// the slices are compacted and triIdx is converted to primitive indices.
+// Note: Refit works on SBVHs, but uses the full triangle bounds.
+void BVH::BuildHQ( const bvhvec4* vertices, const uint primCount, const float budget )
+{
+	// allocate; the extra references also need fragments and nodes
+	const uint slack = primCount + (uint)(primCount * budget);
+	PrepareBuild( vertices, primCount, slack );
+	uint* idxB = new uint[slack];	// partition buffer
+	uint fragPtr = triCount;
+	// initialize fragments and root node bounds
+	BVHNode& root = bvhNode[0];
+	root.leftFirst = 0, root.triCount = triCount, root.aabbMin = bvhvec3( 1e30f ), root.aabbMax = bvhvec3( -1e30f );
+	for (uint i = 0; i < triCount; i++)
+	{
+		fragment[i].bmin = tinybvh_min( tinybvh_min( tris[i * 3], tris[i * 3 + 1] ), tris[i * 3 + 2] );
+		fragment[i].bmax = tinybvh_max( tinybvh_max( tris[i * 3], tris[i * 3 + 1] ), tris[i * 3 + 2] );
+		fragment[i].primIdx = i, fragment[i].clipped = 0;
+		root.aabbMin = tinybvh_min( root.aabbMin, fragment[i].bmin );
+		root.aabbMax = tinybvh_max( root.aabbMax, fragment[i].bmax ), triIdx[i] = i;
+	}
+	const bvhvec3 minDim = (root.aabbMax - root.aabbMin) * 1e-20f;
+	const float minOverlap = root.SurfaceArea() * BVH_SBVHALPHA;
+	// subdivide; a task is a node and the end of its slice
+	uint task[256][2], taskCount = 0, nodeIdx = 0, sliceEnd = slack;
+	BVHBins bins;
+	while (1)
+	{
+		while (1)
+		{
+			BVHNode& node = bvhNode[nodeIdx];
+			const uint first = node.leftFirst, room = sliceEnd - first;
+			// best object split
+			BinNode( bins, node, first, node.triCount );
+			const BVHSplit objectSplit = FindObjectSplit( node, minDim, bins );
+			// best spatial split, if the children of the object split overlap
+			const bvhvec3 omin = tinybvh_max( objectSplit.lmin, objectSplit.rmin ), omax = tinybvh_min( objectSplit.lmax, objectSplit.rmax );
+			bvhvec3 overlap = omax - omin;
+			float spatialCost = 1e30f;
+			uint spatialAxis = 0, spatialPos = 0;
+			bvhvec3 slmin, slmax, srmin, srmax;
+			uint spatialNL = 0, spatialNR = 0;
+			if (objectSplit.cost == 1e30f || (overlap.x > 0 && overlap.y > 0 && overlap.z > 0 && overlap.halfArea() > minOverlap))
 			{
-				bvhvec3 lBMin[BVHBINS - 1], rBMin[BVHBINS - 1], l1 = 1e30f, l2 = -1e30f;
-				bvhvec3 lBMax[BVHBINS - 1], rBMax[BVHBINS - 1], r1 = 1e30f, r2 = -1e30f;
-				float ANL[BVHBINS - 1], ANR[BVHBINS - 1];
-				for (uint lN = 0, rN = 0, i = 0; i < BVHBINS - 1; i++)
+				for (int a = 0; a < 3; a++) if ((node.aabbMax.cell[a] - node.aabbMin.cell[a]) > minDim.cell[a])
 				{
-					lBMin[i] = l1 = tinybvh_min( l1, binMin[a][i] );
-					rBMin[BVHBINS - 2 - i] = r1 = tinybvh_min( r1, binMin[a][BVHBINS - 1 - i] );
-					lBMax[i] = l2 = tinybvh_max( l2, binMax[a][i] );
-					rBMax[BVHBINS - 2 - i] = r2 = tinybvh_max( r2, binMax[a][BVHBINS - 1 - i] );
-					lN += count[a][i], rN += count[a][BVHBINS - 1 - i];
-					ANL[i] = lN == 0 ? 1e30f : ((l2 - l1).halfArea() * (float)lN);
-					ANR[BVHBINS - 2 - i] = rN == 0 ? 1e30f : ((r2 - r1).halfArea() * (float)rN);
+					bvhvec3 bmin[BVH_SBVHBINS], bmax[BVH_SBVHBINS];
+					uint entry[BVH_SBVHBINS] = { 0 }, exit[BVH_SBVHBINS] = { 0 };
+					for (uint i = 0; i < BVH_SBVHBINS; i++) bmin[i] = 1e30f, bmax[i] = -1e30f;
+					const float nmin = node.aabbMin.cell[a], extent = node.aabbMax.cell[a] - nmin;
+					const float rpd = BVH_SBVHBINS / extent, binWidth = extent / BVH_SBVHBINS;
+					for (uint i = 0; i < node.triCount; i++)
+					{
+						// clip the fragment against each bin that it overlaps
+						const Fragment& f = fragment[triIdx[first + i]];
+						const int b0 = clamp( (int)((f.bmin.cell[a] - nmin) * rpd), 0, BVH_SBVHBINS - 1 );
+						const int b1 = clamp( (int)((f.bmax.cell[a] - nmin) * rpd), b0, BVH_SBVHBINS - 1 );
+						for (int b = b0; b <= b1; b++)
+						{
+							bvhvec3 cmin = f.bmin, cmax = f.bmax;
+							if (b0 != b1) tinybvh_clip( tris, f, a, nmin + b * binWidth, nmin + (b + 1) * binWidth, cmin, cmax );
+							if (cmin.x > cmax.x) continue; // numerically empty
+							bmin[b] = tinybvh_min( bmin[b], cmin ), bmax[b] = tinybvh_max( bmax[b], cmax );
+						}
+						entry[b0]++, exit[b1]++;
+					}
+					// sweep: references that straddle a plane count on both sides
+					bvhvec3 lmin[BVH_SBVHBINS - 1], lmax[BVH_SBVHBINS - 1], l1 = 1e30f, l2 = -1e30f, r1 = 1e30f, r2 = -1e30f;
+					uint NL[BVH_SBVHBINS - 1];
+					for (uint n = 0, i = 0; i < BVH_SBVHBINS - 1; i++)
+					{
+						lmin[i] = l1 = tinybvh_min( l1, bmin[i] ), lmax[i] = l2 = tinybvh_max( l2, bmax[i] );
+						NL[i] = n += entry[i];
+					}
+					for (uint n = 0, i = BVH_SBVHBINS - 1; i > 0; i--)
+					{
+						r1 = tinybvh_min( r1, bmin[i] ), r2 = tinybvh_max( r2, bmax[i] ), n += exit[i];
+						if (NL[i - 1] == 0 || n == 0 || NL[i - 1] + n > room) continue; // empty side, or over budget
+						const float C = (lmax[i - 1] - lmin[i - 1]).halfArea() * NL[i - 1] + (r2 - r1).halfArea() * n;
+						if (C < spatialCost)
+						{
+							spatialCost = C, spatialAxis = a, spatialPos = i - 1, spatialNL = NL[i - 1], spatialNR = n;
+							slmin = lmin[i - 1], slmax = lmax[i - 1], srmin = r1, srmax = r2;
+						}
+					}
 				}
-				// evaluate bin totals to find best position for object split
-				for (uint i = 0; i < BVHBINS - 1; i++)
+			}
+			const bool spatial = spatialCost < objectSplit.cost;
+			if ((spatial ? spatialCost : objectSplit.cost) >= node.CalculateNodeCost()) break; // not splitting is better.
+			// partition into idxB: left from the start of the slice, right from the end
+			uint leftCount = 0, rightCount = 0;
+			if (!spatial) for (uint i = 0; i < node.triCount; i++)
+			{
+				const uint fi = triIdx[first + i];
+				if ((uint)ObjectSplitBin( node, objectSplit.axis, fi ) <= objectSplit.pos) idxB[first + leftCount++] = fi;
+				else idxB[sliceEnd - 1 - rightCount++] = fi;
+			}
+			else
+			{
+				const int a = spatialAxis;
+				const float nmin = node.aabbMin.cell[a], extent = node.aabbMax.cell[a] - nmin;
+				const float rpd = BVH_SBVHBINS / extent, pos = nmin + (spatialPos + 1) * (extent / BVH_SBVHBINS);
+				const float lA = (slmax - slmin).halfArea(), rA = (srmax - srmin).halfArea();
+				for (uint i = 0; i < node.triCount; i++)
 				{
-					const float C = ANL[i] + ANR[i];
-					if (C < splitCost)
+					const uint fi = triIdx[first + i];
+					Fragment& f = fragment[fi];
+					const int b0 = clamp( (int)((f.bmin.cell[a] - nmin) * rpd), 0, BVH_SBVHBINS - 1 );
+					const int b1 = clamp( (int)((f.bmax.cell[a] - nmin) * rpd), b0, BVH_SBVHBINS - 1 );
+					if (b1 <= (int)spatialPos) { idxB[first + leftCount++] = fi; continue; }
+					if (b0 > (int)spatialPos) { idxB[sliceEnd - 1 - rightCount++] = fi; continue; }
+					// straddling reference: keep it on one side if that is cheaper than
+					// duplicating it ('reference unsplitting')
+					const float C1 = (tinybvh_max( slmax, f.bmax ) - tinybvh_min( slmin, f.bmin )).halfArea() * spatialNL + rA * (spatialNR - 1);
+					const float C2 = lA * (spatialNL - 1) + (tinybvh_max( srmax, f.bmax ) - tinybvh_min( srmin, f.bmin )).halfArea() * spatialNR;
+					const float Csplit = lA * spatialNL + rA * spatialNR;
+					bvhvec3 lmin, lmax, rmin, rmax;
+					const bool left = tinybvh_clip( tris, f, a, f.bmin.cell[a], pos, lmin, lmax );
+					const bool right = tinybvh_clip( tris, f, a, pos, f.bmax.cell[a], rmin, rmax );
+					if ((C1 < Csplit && C1 <= C2) || !right) idxB[first + leftCount++] = fi;
+					else if (C2 < Csplit || !left) idxB[sliceEnd - 1 - rightCount++] = fi;
+					else
 					{
-						splitCost = C, bestAxis = a, bestPos = i;
-						bestLMin = lBMin[i], bestRMin = rBMin[i], bestLMax = lBMax[i], bestRMax = rBMax[i];
+						Fragment& copy = fragment[fragPtr];
+						copy = f, copy.bmin = rmin, copy.bmax = rmax, copy.clipped = 1;
+						f.bmin = lmin, f.bmax = lmax, f.clipped = 1;
+						idxB[first + leftCount++] = fi, idxB[sliceEnd - 1 - rightCount++] = fragPtr++;
 					}
 				}
 			}
-			if (splitCost >= node.CalculateNodeCost()) break; // not splitting is better.
-			// in-place partition
-			uint j = node.leftFirst + node.triCount, src = node.leftFirst;
-			const float rpd = rpd3.cell[bestAxis], nmin = nmin3.cell[bestAxis];
-			for (uint i = 0; i < node.triCount; i++)
+			if (leftCount == 0 || rightCount == 0) break; // should not happen.
+			// child slices; the unused room is divided in proportion to the reference counts
+			const uint rightFirst = first + leftCount + (uint)((uint64_t)(room - leftCount - rightCount) * leftCount / (leftCount + rightCount));
+			memcpy( triIdx + first, idxB + first, leftCount * sizeof( uint ) );
+			memcpy( triIdx + rightFirst, idxB + sliceEnd - rightCount, rightCount * sizeof( uint ) );
+			const uint lci = newNodePtr++, rci = newNodePtr++;
+			BVHNode& left = bvhNode[lci], & right = bvhNode[rci];
+			left.leftFirst = first, left.triCount = leftCount, right.leftFirst = rightFirst, right.triCount = rightCount;
+			for (BVHNode* child : { &left, &right })
 			{
-				const uint fi = triIdx[src];
-				int bi = (uint)(((fragment[fi].bmin[bestAxis] + fragment[fi].bmax[bestAxis]) * 0.5f - nmin) * rpd);
-				bi = clamp( bi, 0, BVHBINS - 1 );
-				if ((uint)bi <= bestPos) src++; else swap( triIdx[src], triIdx[--j] );
+				child->aabbMin = bvhvec3( 1e30f ), child->aabbMax = bvhvec3( -1e30f );
+				for (uint i = 0; i < child->triCount; i++)
+				{
+					const Fragment& f = fragment[triIdx[child->leftFirst + i]];
+					child->aabbMin = tinybvh_min( child->aabbMin, f.bmin ), child->aabbMax = tinybvh_max( child->aabbMax, f.bmax );
+				}
 			}
-			// create child nodes
-			uint leftCount = src - node.leftFirst, rightCount = node.triCount - leftCount;
-			if (leftCount == 0 || rightCount == 0) break; // should not happen.
-			const int lci = newNodePtr++, rci = newNodePtr++;
-			bvhNode[lci].aabbMin = bestLMin, bvhNode[lci].aabbMax = bestLMax;
-			bvhNode[lci].leftFirst = node.leftFirst, bvhNode[lci].triCount = leftCount;
-			bvhNode[rci].aabbMin = bestRMin, bvhNode[rci].aabbMax = bestRMax;
-			bvhNode[rci].leftFirst = j, bvhNode[rci].triCount = rightCount;
 			node.leftFirst = lci, node.triCount = 0;
 			// recurse
-			task[taskCount++] = rci, nodeIdx = lci;
+			task[taskCount][0] = rci, task[taskCount++][1] = sliceEnd;
+			nodeIdx = lci, sliceEnd = rightFirst;
 		}
 		// fetch subdivision task from stack
-		if (taskCount == 0) break; else nodeIdx = task[--taskCount];
+		if (taskCount == 0) break;
+		taskCount--, nodeIdx = task[taskCount][0], sliceEnd = task[taskCount][1];
 	}
+	// compact the leaf slices and replace fragment indices by primitive indices
+	idxCount = 0;
+	for (uint i = 0; i < newNodePtr; i++) if (bvhNode[i].isLeaf())
+	{
+		BVHNode& leaf = bvhNode[i];
+		for (uint j = 0; j < leaf.triCount; j++) idxB[idxCount + j] = fragment[triIdx[leaf.leftFirst + j]].primIdx;
+		leaf.leftFirst = idxCount, idxCount += leaf.triCount;
+	}
+	memcpy( triIdx, idxB, idxCount * sizeof( uint ) );
+	delete[] idxB;
 }
 
 #ifdef BVH_USEAVX
@@ -444,19 +942,7 @@ void BVH::BuildAVX( const bvhvec4* vertices, const uint primCount )
 	static const __m128 mask3 = _mm_cmpeq_ps( _mm_setr_ps( 0, 0, 0, 1 ), _mm_setzero_ps() );
 	static const __m128 binmul3 = _mm_set1_ps( BVHBINS * 0.49999f );
 	for (uint i = 0; i < 3 * BVHBINS; i++) binboxOrig[i] = max8; // binbox initialization template
-	// reset node pool
-	newNodePtr = 2;
-	if (!bvhNode)
-	{
-		triCount = primCount;
-		tris = (bvhvec4*)vertices;
-		triIdx = new uint[triCount];
-		bvhNode = (BVHNode*)MALLOC64( triCount * 2 * sizeof( BVHNode ) );
-		memset( &bvhNode[1], 0, 32 ); // avoid crash in refit.
-		fragment = new Fragment[triCount];
-		idxCount = triCount;
-	}
-	else assert( triCount == primCount ); // don't change triangle count between builds.
+	PrepareBuild( vertices, primCount, primCount );
 	struct FragSSE { __m128 bmin4, bmax4; };
 	FragSSE* frag4 = (FragSSE*)fragment;
 	__m256* frag8 = (__m256*)fragment;
@@ -598,14 +1084,155 @@ void BVH::Refit()
 	}
 }
 
+// Parallel reinsertion optimizer, after "Parallel Reinsertion for Bounding
+// Volume Hierarchy Optimization", Meister & Bittner, 2018. Each pass searches,
+// for every node, the position where it is cheapest to reinsert it, using a
+// branch-and-bound search over the current tree. The searches only read the
+// tree, so all threads run them at once. The moves are then applied in order
+// of decreasing gain; moves that involve a node that was already changed in
+// this pass are skipped and will be reconsidered in the next one. As all
+// leaves remain intact, only the interior cost changes: removing node X
+// removes its parent P and shrinks the ancestors of P; inserting X next to
+// node T adds a node with bounds T+X and grows the ancestors of T.
+struct tinybvh_move { float gain; uint node, target; };
+void BVH::Optimize( const uint iterations, const float maxSeconds, uint threadCount )
+{
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+	const auto start = std::chrono::high_resolution_clock::now();
+	auto elapsed = [&]() { return std::chrono::duration<float>( std::chrono::high_resolution_clock::now() - start ).count(); };
+	auto area = []( const bvhvec3& bmin, const bvhvec3& bmax ) { return SA( bmin, bmax ); };
+	std::vector<uint> parent( newNodePtr, 0 ), candidate;
+	std::vector<char> locked( newNodePtr );
+	std::vector<tinybvh_move> bestMove( newNodePtr );
+	for (uint pass = 0; pass < iterations && elapsed() < maxSeconds; pass++)
+	{
+		// parents and candidates: all nodes in the tree, except the root
+		candidate.clear();
+		for (size_t i = 0, nodeIdx = 0; ; nodeIdx = candidate[i++])
+		{
+			const BVHNode& node = bvhNode[nodeIdx];
+			if (!node.isLeaf())
+			{
+				parent[node.leftFirst] = parent[node.leftFirst + 1] = (uint)nodeIdx;
+				candidate.push_back( node.leftFirst ), candidate.push_back( node.leftFirst + 1 );
+			}
+			if (i == candidate.size()) break;
+		}
+		// find the best move for each candidate
+		const uint candidateCount = (uint)candidate.size();
+		std::atomic<uint> nextCandidate( 0 );
+		tinybvh_parallel( threadCount, [&]( const uint ) {
+			struct Shrunk { uint node; bvhvec3 bmin, bmax; };
+			std::vector<Shrunk> path;
+			std::vector<uint> onPath( newNodePtr, 0 );
+			std::vector<std::pair<float, uint>> heap; // (induced cost, node); min-heap
+			for (uint i; (i = nextCandidate++) < candidateCount;)
+			{
+				const uint X = candidate[i], P = parent[X];
+				const uint S = bvhNode[P].leftFirst == X ? X + 1 : X - 1;
+				const bvhvec3 xmin = bvhNode[X].aabbMin, xmax = bvhNode[X].aabbMax;
+				// removal: P disappears, and the ancestors of P shrink; the search
+				// below uses the shrunk bounds of these nodes
+				float removed = area( bvhNode[P].aabbMin, bvhNode[P].aabbMax );
+				bvhvec3 bmin = bvhNode[S].aabbMin, bmax = bvhNode[S].aabbMax;
+				path.clear();
+				for (uint child = P; child != 0;)
+				{
+					const uint node = parent[child];
+					const BVHNode& n = bvhNode[node];
+					const uint other = n.leftFirst == child ? child + 1 : child - 1;
+					bmin = tinybvh_min( bmin, bvhNode[other].aabbMin ), bmax = tinybvh_max( bmax, bvhNode[other].aabbMax );
+					removed += area( n.aabbMin, n.aabbMax ) - area( bmin, bmax ), child = node;
+					path.push_back( { node, bmin, bmax } ), onPath[node] = i + 1;
+				}
+				// insertion: best-first search; the induced cost of a node is the growth of its ancestors
+				const float xArea = area( xmin, xmax );
+				float bestCost = removed;
+				uint bestTarget = 0;
+				heap.clear();
+				heap.push_back( std::make_pair( 0.0f, 0u ) );
+				while (!heap.empty())
+				{
+					std::pop_heap( heap.begin(), heap.end(), std::greater<std::pair<float, uint>>() );
+					const float induced = heap.back().first;
+					const uint T = heap.back().second;
+					heap.pop_back();
+					if (induced + xArea >= bestCost) break; // no node left can do better
+					if (T == X) continue; // skip the subtree of X
+					if (T == P)
+					{
+						// P is removed; S takes its place
+						heap.push_back( std::make_pair( induced, S ) );
+						std::push_heap( heap.begin(), heap.end(), std::greater<std::pair<float, uint>>() );
+						continue;
+					}
+					const BVHNode& t = bvhNode[T];
+					bvhvec3 tmin = t.aabbMin, tmax = t.aabbMax;
+					if (onPath[T] == i + 1) for (const Shrunk& n : path) if (n.node == T) tmin = n.bmin, tmax = n.bmax;
+					const float direct = area( tinybvh_min( tmin, xmin ), tinybvh_max( tmax, xmax ) );
+					if (induced + direct < bestCost && T != S) bestCost = induced + direct, bestTarget = T;
+					if (t.isLeaf()) continue;
+					const float childInduced = induced + direct - area( tmin, tmax );
+					if (childInduced + xArea >= bestCost) continue;
+					heap.push_back( std::make_pair( childInduced, t.leftFirst ) );
+					std::push_heap( heap.begin(), heap.end(), std::greater<std::pair<float, uint>>() );
+					heap.push_back( std::make_pair( childInduced, t.leftFirst + 1 ) );
+					std::push_heap( heap.begin(), heap.end(), std::greater<std::pair<float, uint>>() );
+				}
+				bestMove[i].gain = removed - bestCost, bestMove[i].node = X, bestMove[i].target = bestTarget;
+			}
+		} );
+		// apply the moves, best first
+		std::vector<tinybvh_move> moves;
+		for (uint i = 0; i < candidateCount; i++) if (bestMove[i].gain > 0) moves.push_back( bestMove[i] );
+		if (moves.empty()) break;
+		std::sort( moves.begin(), moves.end(), []( const tinybvh_move& a, const tinybvh_move& b ) { return a.gain > b.gain; } );
+		memset( locked.data(), 0, newNodePtr );
+		uint applied = 0;
+		for (const tinybvh_move& move : moves)
+		{
+			const uint X = move.node, T = move.target, P = parent[X], c = bvhNode[P].leftFirst, S = c == X ? c + 1 : c;
+			if (locked[X] || locked[P] || locked[S] || locked[T]) continue;
+			bool valid = T != P && T != S;
+			for (uint node = T; node != 0 && valid; node = parent[node]) if (node == X) valid = false; // T in the subtree of X
+			if (!valid) continue;
+			locked[X] = locked[P] = locked[S] = locked[T] = 1, applied++;
+			// remove: S takes the place of P, which frees the node pair at c
+			const BVHNode nodeX = bvhNode[X];
+			bvhNode[P] = bvhNode[S];
+			if (!bvhNode[P].isLeaf()) parent[bvhNode[P].leftFirst] = parent[bvhNode[P].leftFirst + 1] = P;
+			// insert: T and X become the children of a new node in the place of T
+			bvhNode[c] = bvhNode[T], bvhNode[c + 1] = nodeX;
+			if (!bvhNode[c].isLeaf()) parent[bvhNode[c].leftFirst] = parent[bvhNode[c].leftFirst + 1] = c;
+			if (!nodeX.isLeaf()) parent[nodeX.leftFirst] = parent[nodeX.leftFirst + 1] = c + 1;
+			parent[c] = parent[c + 1] = T;
+			bvhNode[T].leftFirst = c, bvhNode[T].triCount = 0;
+			// refit the ancestors of both locations
+			for (const uint first : { T, P }) for (uint node = first; ; node = parent[node])
+			{
+				BVHNode& n = bvhNode[node];
+				if (!n.isLeaf())
+				{
+					n.aabbMin = tinybvh_min( bvhNode[n.leftFirst].aabbMin, bvhNode[n.leftFirst + 1].aabbMin );
+					n.aabbMax = tinybvh_max( bvhNode[n.leftFirst].aabbMax, bvhNode[n.leftFirst + 1].aabbMax );
+				}
+				if (node == 0) break;
+			}
+		}
+		if (applied == 0) break;
+	}
+}
+
 // Intersect a BVH with a ray.
 // This function returns the intersection details in Ray::hit. Additionally,
 // the number of steps through the BVH is returned. Visualize this to get a
-// visual impression of the structure of the BVH.
-int BVH::Intersect( Ray& ray ) const
+// visual impression of the structure of the BVH. Traversal starts at the
+// root, or at nodeIdx, e.g. for rays that leave a packet.
+int BVH::Intersect( Ray& ray, const uint nodeIdx ) const
 {
 	// traverse bvh
-	BVHNode* node = &bvhNode[0], * stack[64];
+	BVHNode* node = &bvhNode[nodeIdx], * stack[64];
 	uint stackPtr = 0, steps = 0;
 	while (1)
 	{
@@ -632,6 +1259,523 @@ int BVH::Intersect( Ray& ray ) const
 	return steps;
 }
 
+#ifdef BVH_USEAVX
+
+// Packet traversal. The packet descends the tree as a whole, with a mask of
+// the rays that are still active in the current subtree. A child is skipped
+// for the whole packet if interval arithmetic over the ray origins and
+// directions shows that no ray can hit it; otherwise the active rays are
+// tested, eight at a time, using AVX. Rays that end up in a subtree with
+// fewer than BVH_PACKETMINRAYS others continue as single rays.
+struct tinybvh_interval
+{
+	// per axis: range of the ray origins and reciprocal directions in a packet
+	float Omin[3], Omax[3], rDmin[3], rDmax[3];
+	bool valid; // false if direction signs differ within the packet on some axis
+};
+template <int N> static tinybvh_interval tinybvh_packet_interval( const RayPacket<N>& p, const uint active )
+{
+	tinybvh_interval I;
+	const float* O[3] = { p.Ox, p.Oy, p.Oz }, * rD[3] = { p.rDx, p.rDy, p.rDz };
+	I.valid = true;
+	for (int a = 0; a < 3; a++)
+	{
+		I.Omin[a] = I.rDmin[a] = 1e30f, I.Omax[a] = I.rDmax[a] = -1e30f;
+		for (int i = 0; i < N; i++) if (active & (1 << i))
+		{
+			I.Omin[a] = min( I.Omin[a], O[a][i] ), I.Omax[a] = max( I.Omax[a], O[a][i] );
+			I.rDmin[a] = min( I.rDmin[a], rD[a][i] ), I.rDmax[a] = max( I.rDmax[a], rD[a][i] );
+		}
+		if (I.rDmin[a] < 0 && I.rDmax[a] > 0) I.valid = false;
+	}
+	return I;
+}
+static inline bool tinybvh_interval_miss( const tinybvh_interval& I, const BVH::BVHNode& node )
+{
+	// the latest possible entry over the axes must not exceed the earliest possible exit
+	float tnear = 0, tfar = 1e30f;
+	for (int a = 0; a < 3; a++)
+	{
+		const bool positive = I.rDmin[a] > 0;
+		const float enter = positive ? node.aabbMin.cell[a] : node.aabbMax.cell[a];
+		const float leave = positive ? node.aabbMax.cell[a] : node.aabbMin.cell[a];
+		const float e0 = enter - I.Omax[a], e1 = enter - I.Omin[a], l0 = leave - I.Omax[a], l1 = leave - I.Omin[a];
+		tnear = max( tnear, min( min( e0 * I.rDmin[a], e0 * I.rDmax[a] ), min( e1 * I.rDmin[a], e1 * I.rDmax[a] ) ) );
+		tfar = min( tfar, max( max( l0 * I.rDmin[a], l0 * I.rDmax[a] ), max( l1 * I.rDmin[a], l1 * I.rDmax[a] ) ) );
+	}
+	return tnear > tfar;
+}
+static inline __m256 tinybvh_lanemask( const uint bits )
+{
+	ALIGNED( 32 ) int m[8];
+	for (int i = 0; i < 8; i++) m[i] = (bits >> i) & 1 ? -1 : 0;
+	return _mm256_load_ps( (float*)m );
+}
+static inline int tinybvh_bitcount( uint v ) { int c = 0; for (; v; v &= v - 1) c++; return c; }
+// slab test of a node for the active rays; returns the rays that hit it, and the entry distances in 'dist'
+template <int N> static uint tinybvh_packet_aabb( const RayPacket<N>& p, const uint active, const BVH::BVHNode& node, float* dist )
+{
+	const __m256 bminx = _mm256_set1_ps( node.aabbMin.x ), bminy = _mm256_set1_ps( node.aabbMin.y ), bminz = _mm256_set1_ps( node.aabbMin.z );
+	const __m256 bmaxx = _mm256_set1_ps( node.aabbMax.x ), bmaxy = _mm256_set1_ps( node.aabbMax.y ), bmaxz = _mm256_set1_ps( node.aabbMax.z );
+	uint mask = 0;
+	for (int g = 0; g < N; g += 8) if ((active >> g) & 255)
+	{
+		const __m256 Ox = _mm256_load_ps( p.Ox + g ), Oy = _mm256_load_ps( p.Oy + g ), Oz = _mm256_load_ps( p.Oz + g );
+		const __m256 rDx = _mm256_load_ps( p.rDx + g ), rDy = _mm256_load_ps( p.rDy + g ), rDz = _mm256_load_ps( p.rDz + g );
+		const __m256 tx1 = _mm256_mul_ps( _mm256_sub_ps( bminx, Ox ), rDx ), tx2 = _mm256_mul_ps( _mm256_sub_ps( bmaxx, Ox ), rDx );
+		const __m256 ty1 = _mm256_mul_ps( _mm256_sub_ps( bminy, Oy ), rDy ), ty2 = _mm256_mul_ps( _mm256_sub_ps( bmaxy, Oy ), rDy );
+		const __m256 tz1 = _mm256_mul_ps( _mm256_sub_ps( bminz, Oz ), rDz ), tz2 = _mm256_mul_ps( _mm256_sub_ps( bmaxz, Oz ), rDz );
+		const __m256 tmin = _mm256_max_ps( _mm256_max_ps( _mm256_min_ps( tx1, tx2 ), _mm256_min_ps( ty1, ty2 ) ), _mm256_min_ps( tz1, tz2 ) );
+		const __m256 tmax = _mm256_min_ps( _mm256_min_ps( _mm256_max_ps( tx1, tx2 ), _mm256_max_ps( ty1, ty2 ) ), _mm256_max_ps( tz1, tz2 ) );
+		const __m256 hit = _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( tmax, tmin, _CMP_GE_OQ ),
+			_mm256_cmp_ps( tmin, _mm256_load_ps( p.t + g ), _CMP_LT_OQ ) ), _mm256_cmp_ps( tmax, _mm256_setzero_ps(), _CMP_GE_OQ ) );
+		_mm256_store_ps( dist + g, tmin );
+		mask |= (uint)_mm256_movemask_ps( hit ) << g;
+	}
+	return mask & active;
+}
+// Moeller-Trumbore for the active rays, as in BVH::IntersectTri. Returns the
+// rays that hit the triangle within their current t; hits are stored in
+// 'result', unless it is null (occlusion queries).
+template <int N> static uint tinybvh_packet_tri( const RayPacket<N>& p, const uint active, const bvhvec4* tris, const uint idx, RayPacket<N>* result )
+{
+	uint hits = 0;
+	const bvhvec4 v0 = tris[idx * 3], e1 = tris[idx * 3 + 1] - v0, e2 = tris[idx * 3 + 2] - v0;
+	const __m256 e1x = _mm256_set1_ps( e1.x ), e1y = _mm256_set1_ps( e1.y ), e1z = _mm256_set1_ps( e1.z );
+	const __m256 e2x = _mm256_set1_ps( e2.x ), e2y = _mm256_set1_ps( e2.y ), e2z = _mm256_set1_ps( e2.z );
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps( 1 ), signMask = _mm256_set1_ps( -0.0f );
+	for (int g = 0; g < N; g += 8) if ((active >> g) & 255)
+	{
+		const __m256 Dx = _mm256_load_ps( p.Dx + g ), Dy = _mm256_load_ps( p.Dy + g ), Dz = _mm256_load_ps( p.Dz + g );
+		const __m256 hx = _mm256_sub_ps( _mm256_mul_ps( Dy, e2z ), _mm256_mul_ps( Dz, e2y ) );
+		const __m256 hy = _mm256_sub_ps( _mm256_mul_ps( Dz, e2x ), _mm256_mul_ps( Dx, e2z ) );
+		const __m256 hz = _mm256_sub_ps( _mm256_mul_ps( Dx, e2y ), _mm256_mul_ps( Dy, e2x ) );
+		const __m256 a = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( e1x, hx ), _mm256_mul_ps( e1y, hy ) ), _mm256_mul_ps( e1z, hz ) );
+		const __m256 f = _mm256_div_ps( one, a );
+		const __m256 sx = _mm256_sub_ps( _mm256_load_ps( p.Ox + g ), _mm256_set1_ps( v0.x ) );
+		const __m256 sy = _mm256_sub_ps( _mm256_load_ps( p.Oy + g ), _mm256_set1_ps( v0.y ) );
+		const __m256 sz = _mm256_sub_ps( _mm256_load_ps( p.Oz + g ), _mm256_set1_ps( v0.z ) );
+		const __m256 u = _mm256_mul_ps( f, _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( sx, hx ), _mm256_mul_ps( sy, hy ) ), _mm256_mul_ps( sz, hz ) ) );
+		const __m256 qx = _mm256_sub_ps( _mm256_mul_ps( sy, e1z ), _mm256_mul_ps( sz, e1y ) );
+		const __m256 qy = _mm256_sub_ps( _mm256_mul_ps( sz, e1x ), _mm256_mul_ps( sx, e1z ) );
+		const __m256 qz = _mm256_sub_ps( _mm256_mul_ps( sx, e1y ), _mm256_mul_ps( sy, e1x ) );
+		const __m256 v = _mm256_mul_ps( f, _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( Dx, qx ), _mm256_mul_ps( Dy, qy ) ), _mm256_mul_ps( Dz, qz ) ) );
+		const __m256 t = _mm256_mul_ps( f, _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( e2x, qx ), _mm256_mul_ps( e2y, qy ) ), _mm256_mul_ps( e2z, qz ) ) );
+		const __m256 tcur = _mm256_load_ps( p.t + g );
+		__m256 valid = _mm256_and_ps( tinybvh_lanemask( active >> g ), _mm256_cmp_ps( _mm256_andnot_ps( signMask, a ), _mm256_set1_ps( 0.0000001f ), _CMP_GE_OQ ) );
+		valid = _mm256_and_ps( valid, _mm256_and_ps( _mm256_cmp_ps( u, zero, _CMP_GE_OQ ), _mm256_cmp_ps( u, one, _CMP_LE_OQ ) ) );
+		valid = _mm256_and_ps( valid, _mm256_and_ps( _mm256_cmp_ps( v, zero, _CMP_GE_OQ ), _mm256_cmp_ps( _mm256_add_ps( u, v ), one, _CMP_LE_OQ ) ) );
+		valid = _mm256_and_ps( valid, _mm256_and_ps( _mm256_cmp_ps( t, zero, _CMP_GT_OQ ), _mm256_cmp_ps( t, tcur, _CMP_LT_OQ ) ) );
+		const uint laneHits = (uint)_mm256_movemask_ps( valid );
+		if (laneHits == 0) continue;
+		hits |= laneHits << g;
+		if (!result) continue;
+		_mm256_store_ps( result->t + g, _mm256_blendv_ps( tcur, t, valid ) );
+		_mm256_store_ps( result->u + g, _mm256_blendv_ps( _mm256_load_ps( result->u + g ), u, valid ) );
+		_mm256_store_ps( result->v + g, _mm256_blendv_ps( _mm256_load_ps( result->v + g ), v, valid ) );
+		const __m256 prim = _mm256_castsi256_ps( _mm256_set1_epi32( (int)idx ) );
+		_mm256_store_ps( (float*)result->prim + g, _mm256_blendv_ps( _mm256_load_ps( (float*)result->prim + g ), prim, valid ) );
+	}
+	return hits;
+}
+template <int N> int BVH::IntersectSingle( RayPacket<N>& p, const uint lanes, const uint nodeIdx ) const
+{
+	int steps = 0;
+	for (int i = 0; i < N; i++) if (lanes & (1 << i))
+	{
+		Ray ray = p.Get( i );
+		steps += Intersect( ray, nodeIdx );
+		p.t[i] = ray.hit.t, p.u[i] = ray.hit.u, p.v[i] = ray.hit.v, p.prim[i] = ray.hit.prim;
+	}
+	return steps;
+}
+template <int N> int BVH::IntersectPacket( RayPacket<N>& p, const uint active ) const
+{
+	if (tinybvh_bitcount( active ) < BVH_PACKETMINRAYS) return IntersectSingle( p, active, 0 );
+	const tinybvh_interval I = tinybvh_packet_interval( p, active );
+	struct { uint node, mask; } stack[64];
+	ALIGNED( 64 ) float dist1[N], dist2[N];
+	uint stackPtr = 0, steps = 0, nodeIdx = 0, mask = active;
+	while (1)
+	{
+		steps++;
+		const BVHNode& node = bvhNode[nodeIdx];
+		if (node.isLeaf())
+		{
+			for (uint i = 0; i < node.triCount; i++) tinybvh_packet_tri( p, mask, tris, triIdx[node.leftFirst + i], &p );
+			if (stackPtr == 0) break; else nodeIdx = stack[--stackPtr].node, mask = stack[stackPtr].mask;
+			continue;
+		}
+		const uint c1 = node.leftFirst, c2 = node.leftFirst + 1;
+		uint m1 = 0, m2 = 0;
+		if (!I.valid || !tinybvh_interval_miss( I, bvhNode[c1] )) m1 = tinybvh_packet_aabb( p, mask, bvhNode[c1], dist1 );
+		if (!I.valid || !tinybvh_interval_miss( I, bvhNode[c2] )) m2 = tinybvh_packet_aabb( p, mask, bvhNode[c2], dist2 );
+		// divergent rays continue on their own
+		if (m1 && tinybvh_bitcount( m1 ) < BVH_PACKETMINRAYS) steps += IntersectSingle( p, m1, c1 ), m1 = 0;
+		if (m2 && tinybvh_bitcount( m2 ) < BVH_PACKETMINRAYS) steps += IntersectSingle( p, m2, c2 ), m2 = 0;
+		if (m1 && m2)
+		{
+			// visit the child that is nearer for most rays first
+			uint nearer1 = 0;
+			for (int g = 0; g < N; g += 8)
+				nearer1 |= (uint)_mm256_movemask_ps( _mm256_cmp_ps( _mm256_load_ps( dist1 + g ), _mm256_load_ps( dist2 + g ), _CMP_LT_OQ ) ) << g;
+			const uint both = m1 & m2;
+			if (tinybvh_bitcount( nearer1 & both ) * 2 >= tinybvh_bitcount( both ))
+				stack[stackPtr].node = c2, stack[stackPtr++].mask = m2, nodeIdx = c1, mask = m1;
+			else
+				stack[stackPtr].node = c1, stack[stackPtr++].mask = m1, nodeIdx = c2, mask = m2;
+		}
+		else if (m1) nodeIdx = c1, mask = m1;
+		else if (m2) nodeIdx = c2, mask = m2;
+		else if (stackPtr == 0) break; else nodeIdx = stack[--stackPtr].node, mask = stack[stackPtr].mask;
+	}
+	return steps;
+}
+int BVH::Intersect8( RayPacket8& packet, const uint active ) const { return IntersectPacket( packet, active & 0xff ); }
+int BVH::Intersect16( RayPacket16& packet, const uint active ) const { return IntersectPacket( packet, active & 0xffff ); }
+
+// Packet occlusion: as IntersectPacket, but rays leave the packet as soon as
+// they are occluded, and traversal ends when all rays are occluded. Child
+// order as in IsOccluded.
+template <int N> uint BVH::OccludedPacket( const RayPacket<N>& p, const uint active ) const
+{
+	// single-ray occlusion for the rays in 'lanes', starting at a node
+	auto single = [&]( const uint lanes, const uint start ) {
+		uint result = 0;
+		for (int i = 0; i < N; i++) if ((lanes & (1 << i)) && IsOccluded( p.Get( i ), start )) result |= 1 << i;
+		return result;
+	};
+	if (tinybvh_bitcount( active ) < BVH_PACKETMINRAYS) return single( active, 0 );
+	uint occluded = 0;
+	const tinybvh_interval I = tinybvh_packet_interval( p, active );
+	struct { uint node, mask; } stack[64];
+	ALIGNED( 64 ) float dist[N];
+	uint stackPtr = 0, nodeIdx = 0, mask = active;
+	while (1)
+	{
+		mask &= ~occluded;
+		if (mask)
+		{
+			const BVHNode& node = bvhNode[nodeIdx];
+			if (node.isLeaf())
+			{
+				for (uint i = 0; i < node.triCount && (mask & ~occluded); i++)
+					occluded |= tinybvh_packet_tri( p, mask & ~occluded, tris, triIdx[node.leftFirst + i], (RayPacket<N>*)0 );
+				if (occluded == active) break;
+			}
+			else
+			{
+				uint c1 = node.leftFirst, c2 = node.leftFirst + 1, m1 = 0, m2 = 0;
+				if (!I.valid || !tinybvh_interval_miss( I, bvhNode[c1] )) m1 = tinybvh_packet_aabb( p, mask, bvhNode[c1], dist );
+				if (!I.valid || !tinybvh_interval_miss( I, bvhNode[c2] )) m2 = tinybvh_packet_aabb( p, mask, bvhNode[c2], dist );
+				// divergent rays continue on their own
+				if (m1 && tinybvh_bitcount( m1 ) < BVH_PACKETMINRAYS) occluded |= single( m1, c1 ), m1 = 0;
+				if (m2 && tinybvh_bitcount( m2 ) < BVH_PACKETMINRAYS) occluded |= single( m2 & ~occluded, c2 ), m2 = 0;
+				m2 &= ~occluded;
+				if (m1 && m2)
+				{
+					if (bvhNode[c2].SurfaceArea() > bvhNode[c1].SurfaceArea()) swap( c1, c2 ), swap( m1, m2 );
+					stack[stackPtr].node = c2, stack[stackPtr++].mask = m2, nodeIdx = c1, mask = m1;
+					continue;
+				}
+				if (m1 | m2) { nodeIdx = m1 ? c1 : c2, mask = m1 | m2; continue; }
+			}
+		}
+		if (stackPtr == 0) break; else nodeIdx = stack[--stackPtr].node, mask = stack[stackPtr].mask;
+	}
+	return occluded;
+}
+uint BVH::IsOccluded8( const RayPacket8& packet, const uint active ) const { return OccludedPacket( packet, active & 0xff ); }
+uint BVH::IsOccluded16( const RayPacket16& packet, const uint active ) const { return OccludedPacket( packet, active & 0xffff ); }
+
+#endif
+
+// Wide BVH construction: each wide node takes the two children of a binary
+// node, then repeatedly replaces the interior child with the largest surface
+// area by its own two children, until there are M children. Unused slots
+// hold a box at 1e30 and have child 0 and triCount 0; the root is never a
+// child, so traversal recognizes them by that and skips them. (The box alone
+// does not suffice: a ray with a long direction vector reaches it before
+// its hit.t.)
+template <int M> void MBVH<M>::Convert( const BVH& original )
+{
+	bvh = &original;
+	ALIGNED_FREE( mbvhNode );
+	// every wide node absorbs at least one interior binary node
+	mbvhNode = (MBVHNode*)ALIGNED_MALLOC( (original.newNodePtr / 2 + 1) * sizeof( MBVHNode ) );
+	nodeCount = 1;
+	CollapseNode( 0, 0 );
+}
+template <int M> void MBVH<M>::CollapseNode( const uint wideIdx, const uint binaryIdx )
+{
+	const BVH::BVHNode* node = bvh->bvhNode;
+	uint child[M], childCount = 1;
+	child[0] = binaryIdx; // a leaf root yields a root with a single leaf child
+	if (!node[binaryIdx].isLeaf()) child[0] = node[binaryIdx].leftFirst, child[1] = node[binaryIdx].leftFirst + 1, childCount = 2;
+	while (childCount < M)
+	{
+		int best = -1;
+		float bestArea = -1;
+		for (uint i = 0; i < childCount; i++) if (!node[child[i]].isLeaf())
+		{
+			const float area = node[child[i]].SurfaceArea();
+			if (area > bestArea) best = i, bestArea = area;
+		}
+		if (best == -1) break; // all children are leaves
+		const uint open = child[best];
+		child[best] = node[open].leftFirst, child[childCount++] = node[open].leftFirst + 1;
+	}
+	MBVHNode& wide = mbvhNode[wideIdx];
+	for (uint i = 0; i < M; i++)
+	{
+		if (i >= childCount)
+		{
+			wide.xmin[i] = wide.xmax[i] = wide.ymin[i] = wide.ymax[i] = wide.zmin[i] = wide.zmax[i] = 1e30f;
+			wide.child[i] = wide.triCount[i] = 0;
+			continue;
+		}
+		const BVH::BVHNode& c = node[child[i]];
+		wide.xmin[i] = c.aabbMin.x, wide.ymin[i] = c.aabbMin.y, wide.zmin[i] = c.aabbMin.z;
+		wide.xmax[i] = c.aabbMax.x, wide.ymax[i] = c.aabbMax.y, wide.zmax[i] = c.aabbMax.z;
+		if (c.isLeaf()) wide.child[i] = c.leftFirst, wide.triCount[i] = c.triCount;
+		else wide.child[i] = nodeCount++, wide.triCount[i] = 0;
+	}
+	for (uint i = 0; i < childCount; i++) if (!node[child[i]].isLeaf()) CollapseNode( wide.child[i], child[i] );
+}
+
+// Slab test of all children of a wide node. Returns a mask of the children
+// that the ray intersects, and the entry distances of the children in 'dist'.
+template <int M> static inline uint tinybvh_slab( const typename MBVH<M>::MBVHNode& n, const Ray& ray, float* dist )
+{
+	uint mask = 0;
+	for (int i = 0; i < M; i++)
+	{
+		const float tx1 = (n.xmin[i] - ray.O.x) * ray.rD.x, tx2 = (n.xmax[i] - ray.O.x) * ray.rD.x;
+		const float ty1 = (n.ymin[i] - ray.O.y) * ray.rD.y, ty2 = (n.ymax[i] - ray.O.y) * ray.rD.y;
+		const float tz1 = (n.zmin[i] - ray.O.z) * ray.rD.z, tz2 = (n.zmax[i] - ray.O.z) * ray.rD.z;
+		const float tmin = max( max( min( tx1, tx2 ), min( ty1, ty2 ) ), min( tz1, tz2 ) );
+		const float tmax = min( min( max( tx1, tx2 ), max( ty1, ty2 ) ), max( tz1, tz2 ) );
+		if (tmax >= tmin && tmin < ray.hit.t && tmax >= 0) mask |= 1 << i;
+		dist[i] = tmin;
+	}
+	return mask;
+}
+template <> inline uint tinybvh_slab<4>( const MBVH<4>::MBVHNode& n, const Ray& ray, float* dist )
+{
+	const __m128 Ox = _mm_set1_ps( ray.O.x ), Oy = _mm_set1_ps( ray.O.y ), Oz = _mm_set1_ps( ray.O.z );
+	const __m128 rDx = _mm_set1_ps( ray.rD.x ), rDy = _mm_set1_ps( ray.rD.y ), rDz = _mm_set1_ps( ray.rD.z );
+	const __m128 tx1 = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( n.xmin ), Ox ), rDx ), tx2 = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( n.xmax ), Ox ), rDx );
+	const __m128 ty1 = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( n.ymin ), Oy ), rDy ), ty2 = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( n.ymax ), Oy ), rDy );
+	const __m128 tz1 = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( n.zmin ), Oz ), rDz ), tz2 = _mm_mul_ps( _mm_sub_ps( _mm_load_ps( n.zmax ), Oz ), rDz );
+	const __m128 tmin = _mm_max_ps( _mm_max_ps( _mm_min_ps( tx1, tx2 ), _mm_min_ps( ty1, ty2 ) ), _mm_min_ps( tz1, tz2 ) );
+	const __m128 tmax = _mm_min_ps( _mm_min_ps( _mm_max_ps( tx1, tx2 ), _mm_max_ps( ty1, ty2 ) ), _mm_max_ps( tz1, tz2 ) );
+	const __m128 hit = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( tmax, tmin ), _mm_cmplt_ps( tmin, _mm_set1_ps( ray.hit.t ) ) ), _mm_cmpge_ps( tmax, _mm_setzero_ps() ) );
+	_mm_storeu_ps( dist, tmin );
+	return (uint)_mm_movemask_ps( hit );
+}
+#ifdef BVH_USEAVX
+template <> inline uint tinybvh_slab<8>( const MBVH<8>::MBVHNode& n, const Ray& ray, float* dist )
+{
+	const __m256 Ox = _mm256_set1_ps( ray.O.x ), Oy = _mm256_set1_ps( ray.O.y ), Oz = _mm256_set1_ps( ray.O.z );
+	const __m256 rDx = _mm256_set1_ps( ray.rD.x ), rDy = _mm256_set1_ps( ray.rD.y ), rDz = _mm256_set1_ps( ray.rD.z );
+	const __m256 tx1 = _mm256_mul_ps( _mm256_sub_ps( _mm256_load_ps( n.xmin ), Ox ), rDx ), tx2 = _mm256_mul_ps( _mm256_sub_ps( _mm256_load_ps( n.xmax ), Ox ), rDx );
+	const __m256 ty1 = _mm256_mul_ps( _mm256_sub_ps( _mm256_load_ps( n.ymin ), Oy ), rDy ), ty2 = _mm256_mul_ps( _mm256_sub_ps( _mm256_load_ps( n.ymax ), Oy ), rDy );
+	const __m256 tz1 = _mm256_mul_ps( _mm256_sub_ps( _mm256_load_ps( n.zmin ), Oz ), rDz ), tz2 = _mm256_mul_ps( _mm256_sub_ps( _mm256_load_ps( n.zmax ), Oz ), rDz );
+	const __m256 tmin = _mm256_max_ps( _mm256_max_ps( _mm256_min_ps( tx1, tx2 ), _mm256_min_ps( ty1, ty2 ) ), _mm256_min_ps( tz1, tz2 ) );
+	const __m256 tmax = _mm256_min_ps( _mm256_min_ps( _mm256_max_ps( tx1, tx2 ), _mm256_max_ps( ty1, ty2 ) ), _mm256_max_ps( tz1, tz2 ) );
+	const __m256 hit = _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( tmax, tmin, _CMP_GE_OQ ),
+		_mm256_cmp_ps( tmin, _mm256_set1_ps( ray.hit.t ), _CMP_LT_OQ ) ), _mm256_cmp_ps( tmax, _mm256_setzero_ps(), _CMP_GE_OQ ) );
+	_mm256_storeu_ps( dist, tmin );
+	return (uint)_mm256_movemask_ps( hit );
+}
+#endif
+
+// Intersect a wide BVH with a ray. The children that the ray intersects are
+// pushed far to near, so the nearest child is processed first; entries that
+// are further away than the nearest hit found so far are skipped when they
+// are popped. Returns the number of wide nodes visited.
+template <int M> int MBVH<M>::Intersect( Ray& ray ) const
+{
+	struct Entry { uint child, triCount; float dist; } stack[64 * M];
+	ALIGNED( 64 ) float dist[M];
+	uint stackPtr = 0, steps = 0, nodeIdx = 0;
+	while (1)
+	{
+		steps++;
+		const MBVHNode& node = mbvhNode[nodeIdx];
+		uint mask = tinybvh_slab<M>( node, ray, dist );
+		// sort the intersected children by distance, nearest last
+		Entry hit[M];
+		int hitCount = 0;
+		for (; mask; mask &= mask - 1)
+		{
+			int i = 0;
+			while (!(mask & (1 << i))) i++;
+			if (node.child[i] == 0 && node.triCount[i] == 0) continue; // unused slot
+			Entry e = { node.child[i], node.triCount[i], dist[i] }; // insertion sort
+			int j = hitCount++;
+			for (; j > 0 && hit[j - 1].dist < e.dist; j--) hit[j] = hit[j - 1];
+			hit[j] = e;
+		}
+		for (int i = 0; i < hitCount; i++) stack[stackPtr++] = hit[i];
+		// fetch the next node; leaves are intersected on the way
+		while (1)
+		{
+			if (stackPtr == 0) return steps;
+			const Entry& e = stack[--stackPtr];
+			if (e.dist >= ray.hit.t) continue;
+			if (e.triCount == 0) { nodeIdx = e.child; break; }
+			for (uint i = 0; i < e.triCount; i++) bvh->IntersectTri( ray, bvh->triIdx[e.child + i] );
+		}
+	}
+}
+
+template class MBVH<4>;
+template class MBVH<8>;
+
+// Quantized wide BVH construction: the tree is collapsed as for MBVH, after
+// which the child bounds of each node are quantized. The scale per axis is
+// the smallest power of two for which 255 steps cover the node; quantized
+// bounds are adjusted until, dequantized, they enclose the original bounds.
+template <int M> void QMBVH<M>::Convert( const BVH& original )
+{
+	MBVH<M> wide;
+	wide.Convert( original );
+	for (uint n = 0; n < wide.nodeCount; n++) for (uint i = 0; i < M; i++) if (wide.mbvhNode[n].triCount[i] > 65535)
+		FatalError( "QMBVH: leaf with %u triangles; at most 65535 are supported.", wide.mbvhNode[n].triCount[i] );
+	bvh = &original;
+	ALIGNED_FREE( qnode );
+	qnode = (QMBVHNode*)ALIGNED_MALLOC( wide.nodeCount * sizeof( QMBVHNode ) );
+	nodeCount = wide.nodeCount;
+	for (uint n = 0; n < nodeCount; n++)
+	{
+		const typename MBVH<M>::MBVHNode& w = wide.mbvhNode[n];
+		QMBVHNode& q = qnode[n];
+		const float* bmin[3] = { w.xmin, w.ymin, w.zmin }, * bmax[3] = { w.xmax, w.ymax, w.zmax };
+		unsigned char* qmin[3] = { q.qxmin, q.qymin, q.qzmin }, * qmax[3] = { q.qxmax, q.qymax, q.qzmax };
+		float* origin[3] = { &q.ox, &q.oy, &q.oz }, * scale[3] = { &q.sx, &q.sy, &q.sz };
+		q.childMask = 0;
+		for (uint i = 0; i < M; i++) if (w.child[i] != 0 || w.triCount[i] != 0) q.childMask |= 1 << i;
+		for (int a = 0; a < 3; a++)
+		{
+			float lo = 1e30f, hi = -1e30f;
+			for (uint i = 0; i < M; i++) if (q.childMask & (1 << i)) lo = tinybvh_min( lo, bmin[a][i] ), hi = tinybvh_max( hi, bmax[a][i] );
+			float s = hi > lo ? exp2f( ceilf( log2f( (hi - lo) / 255 ) ) ) : 1;
+			while (lo + 255 * s < hi) s *= 2;
+			*origin[a] = lo, * scale[a] = s;
+			for (uint i = 0; i < M; i++)
+			{
+				if (!(q.childMask & (1 << i))) { qmin[a][i] = qmax[a][i] = 0; continue; }
+				int qlo = clamp( (int)floorf( (bmin[a][i] - lo) / s ), 0, 255 ), qhi = clamp( (int)ceilf( (bmax[a][i] - lo) / s ), 0, 255 );
+				while (qlo > 0 && lo + qlo * s > bmin[a][i]) qlo--;
+				while (qhi < 255 && lo + qhi * s < bmax[a][i]) qhi++;
+				qmin[a][i] = (unsigned char)qlo, qmax[a][i] = (unsigned char)qhi;
+			}
+		}
+		for (uint i = 0; i < M; i++) q.child[i] = w.child[i], q.triCount[i] = (unsigned short)w.triCount[i];
+	}
+}
+
+// Slab test of all children of a quantized node; as tinybvh_slab, with the
+// bounds dequantized first.
+template <int M> static inline uint tinybvh_qslab( const typename QMBVH<M>::QMBVHNode& n, const Ray& ray, float* dist )
+{
+	uint mask = 0;
+	for (int i = 0; i < M; i++)
+	{
+		const float tx1 = (n.ox + n.qxmin[i] * n.sx - ray.O.x) * ray.rD.x, tx2 = (n.ox + n.qxmax[i] * n.sx - ray.O.x) * ray.rD.x;
+		const float ty1 = (n.oy + n.qymin[i] * n.sy - ray.O.y) * ray.rD.y, ty2 = (n.oy + n.qymax[i] * n.sy - ray.O.y) * ray.rD.y;
+		const float tz1 = (n.oz + n.qzmin[i] * n.sz - ray.O.z) * ray.rD.z, tz2 = (n.oz + n.qzmax[i] * n.sz - ray.O.z) * ray.rD.z;
+		const float tmin = max( max( min( tx1, tx2 ), min( ty1, ty2 ) ), min( tz1, tz2 ) );
+		const float tmax = min( min( max( tx1, tx2 ), max( ty1, ty2 ) ), max( tz1, tz2 ) );
+		if (tmax >= tmin && tmin < ray.hit.t && tmax >= 0) mask |= 1 << i;
+		dist[i] = tmin;
+	}
+	return mask & n.childMask;
+}
+static inline __m128 tinybvh_dequant4( const unsigned char* q, const float o, const float s )
+{
+	// four bytes to four floats, then o + q * s
+	const __m128i b = _mm_cvtsi32_si128( *(const int*)q ), z = _mm_setzero_si128();
+	const __m128 f = _mm_cvtepi32_ps( _mm_unpacklo_epi16( _mm_unpacklo_epi8( b, z ), z ) );
+	return _mm_add_ps( _mm_set1_ps( o ), _mm_mul_ps( f, _mm_set1_ps( s ) ) );
+}
+template <> inline uint tinybvh_qslab<4>( const QMBVH<4>::QMBVHNode& n, const Ray& ray, float* dist )
+{
+	const __m128 Ox = _mm_set1_ps( ray.O.x ), Oy = _mm_set1_ps( ray.O.y ), Oz = _mm_set1_ps( ray.O.z );
+	const __m128 rDx = _mm_set1_ps( ray.rD.x ), rDy = _mm_set1_ps( ray.rD.y ), rDz = _mm_set1_ps( ray.rD.z );
+	const __m128 tx1 = _mm_mul_ps( _mm_sub_ps( tinybvh_dequant4( n.qxmin, n.ox, n.sx ), Ox ), rDx ), tx2 = _mm_mul_ps( _mm_sub_ps( tinybvh_dequant4( n.qxmax, n.ox, n.sx ), Ox ), rDx );
+	const __m128 ty1 = _mm_mul_ps( _mm_sub_ps( tinybvh_dequant4( n.qymin, n.oy, n.sy ), Oy ), rDy ), ty2 = _mm_mul_ps( _mm_sub_ps( tinybvh_dequant4( n.qymax, n.oy, n.sy ), Oy ), rDy );
+	const __m128 tz1 = _mm_mul_ps( _mm_sub_ps( tinybvh_dequant4( n.qzmin, n.oz, n.sz ), Oz ), rDz ), tz2 = _mm_mul_ps( _mm_sub_ps( tinybvh_dequant4( n.qzmax, n.oz, n.sz ), Oz ), rDz );
+	const __m128 tmin = _mm_max_ps( _mm_max_ps( _mm_min_ps( tx1, tx2 ), _mm_min_ps( ty1, ty2 ) ), _mm_min_ps( tz1, tz2 ) );
+	const __m128 tmax = _mm_min_ps( _mm_min_ps( _mm_max_ps( tx1, tx2 ), _mm_max_ps( ty1, ty2 ) ), _mm_max_ps( tz1, tz2 ) );
+	const __m128 hit = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( tmax, tmin ), _mm_cmplt_ps( tmin, _mm_set1_ps( ray.hit.t ) ) ), _mm_cmpge_ps( tmax, _mm_setzero_ps() ) );
+	_mm_storeu_ps( dist, tmin );
+	return (uint)_mm_movemask_ps( hit ) & n.childMask;
+}
+#ifdef BVH_USEAVX
+static inline __m256 tinybvh_dequant8( const unsigned char* q, const float o, const float s )
+{
+	// eight bytes to eight floats, then o + q * s
+	const __m128i z = _mm_setzero_si128(), w = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*)q ), z );
+	const __m256i i = _mm256_insertf128_si256( _mm256_castsi128_si256( _mm_unpacklo_epi16( w, z ) ), _mm_unpackhi_epi16( w, z ), 1 );
+	return _mm256_add_ps( _mm256_set1_ps( o ), _mm256_mul_ps( _mm256_cvtepi32_ps( i ), _mm256_set1_ps( s ) ) );
+}
+template <> inline uint tinybvh_qslab<8>( const QMBVH<8>::QMBVHNode& n, const Ray& ray, float* dist )
+{
+	const __m256 Ox = _mm256_set1_ps( ray.O.x ), Oy = _mm256_set1_ps( ray.O.y ), Oz = _mm256_set1_ps( ray.O.z );
+	const __m256 rDx = _mm256_set1_ps( ray.rD.x ), rDy = _mm256_set1_ps( ray.rD.y ), rDz = _mm256_set1_ps( ray.rD.z );
+	const __m256 tx1 = _mm256_mul_ps( _mm256_sub_ps( tinybvh_dequant8( n.qxmin, n.ox, n.sx ), Ox ), rDx ), tx2 = _mm256_mul_ps( _mm256_sub_ps( tinybvh_dequant8( n.qxmax, n.ox, n.sx ), Ox ), rDx );
+	const __m256 ty1 = _mm256_mul_ps( _mm256_sub_ps( tinybvh_dequant8( n.qymin, n.oy, n.sy ), Oy ), rDy ), ty2 = _mm256_mul_ps( _mm256_sub_ps( tinybvh_dequant8( n.qymax, n.oy, n.sy ), Oy ), rDy );
+	const __m256 tz1 = _mm256_mul_ps( _mm256_sub_ps( tinybvh_dequant8( n.qzmin, n.oz, n.sz ), Oz ), rDz ), tz2 = _mm256_mul_ps( _mm256_sub_ps( tinybvh_dequant8( n.qzmax, n.oz, n.sz ), Oz ), rDz );
+	const __m256 tmin = _mm256_max_ps( _mm256_max_ps( _mm256_min_ps( tx1, tx2 ), _mm256_min_ps( ty1, ty2 ) ), _mm256_min_ps( tz1, tz2 ) );
+	const __m256 tmax = _mm256_min_ps( _mm256_min_ps( _mm256_max_ps( tx1, tx2 ), _mm256_max_ps( ty1, ty2 ) ), _mm256_max_ps( tz1, tz2 ) );
+	const __m256 hit = _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( tmax, tmin, _CMP_GE_OQ ),
+		_mm256_cmp_ps( tmin, _mm256_set1_ps( ray.hit.t ), _CMP_LT_OQ ) ), _mm256_cmp_ps( tmax, _mm256_setzero_ps(), _CMP_GE_OQ ) );
+	_mm256_storeu_ps( dist, tmin );
+	return (uint)_mm256_movemask_ps( hit ) & n.childMask;
+}
+#endif
+
+// Intersect a quantized wide BVH with a ray; as MBVH::Intersect.
+template <int M> int QMBVH<M>::Intersect( Ray& ray ) const
+{
+	struct Entry { uint child, triCount; float dist; } stack[64 * M];
+	ALIGNED( 64 ) float dist[M];
+	uint stackPtr = 0, steps = 0, nodeIdx = 0;
+	while (1)
+	{
+		steps++;
+		const QMBVHNode& node = qnode[nodeIdx];
+		uint mask = tinybvh_qslab<M>( node, ray, dist );
+		// sort the intersected children by distance, nearest last
+		Entry hit[M];
+		int hitCount = 0;
+		for (; mask; mask &= mask - 1)
+		{
+			int i = 0;
+			while (!(mask & (1 << i))) i++;
+			Entry e = { node.child[i], node.triCount[i], dist[i] }; // insertion sort
+			int j = hitCount++;
+			for (; j > 0 && hit[j - 1].dist < e.dist; j--) hit[j] = hit[j - 1];
+			hit[j] = e;
+		}
+		for (int i = 0; i < hitCount; i++) stack[stackPtr++] = hit[i];
+		// fetch the next node; leaves are intersected on the way
+		while (1)
+		{
+			if (stackPtr == 0) return steps;
+			const Entry& e = stack[--stackPtr];
+			if (e.dist >= ray.hit.t) continue;
+			if (e.triCount == 0) { nodeIdx = e.child; break; }
+			for (uint i = 0; i < e.triCount; i++) bvh->IntersectTri( ray, bvh->triIdx[e.child + i] );
+		}
+	}
+}
+
+template class QMBVH<4>;
+template class QMBVH<8>;
+
 // IntersectTri
 void BVH::IntersectTri( Ray& ray, const uint idx ) const
 {
@@ -653,6 +1797,63 @@ void BVH::IntersectTri( Ray& ray, const uint idx ) const
 	if (t > 0 && t < ray.hit.t) ray.hit.t = t, ray.hit.u = u, ray.hit.v = v, ray.hit.prim = idx;
 }
 
+// Occlusion queries. Traversal stops at the first hit. Any hit will do, so
+// children are not sorted by distance; instead, the child with the largest
+// surface area is visited first, as it is the most likely to contain an
+// occluder.
+bool BVH::IsOccluded( const Ray& ray, const uint nodeIdx ) const
+{
+	const BVHNode* node = &bvhNode[nodeIdx], * stack[64];
+	uint stackPtr = 0;
+	while (1)
+	{
+		if (node->isLeaf())
+		{
+			for (uint i = 0; i < node->triCount; i++) if (OccludedTri( ray, triIdx[node->leftFirst + i] )) return true;
+			if (stackPtr == 0) break; else node = stack[--stackPtr];
+			continue;
+		}
+		const BVHNode* child1 = &bvhNode[node->leftFirst], * child2 = &bvhNode[node->leftFirst + 1];
+		const bool hit1 = child1->Intersect( ray ) != 1e30f, hit2 = child2->Intersect( ray ) != 1e30f;
+		if (hit1 && hit2)
+		{
+			if (child2->SurfaceArea() > child1->SurfaceArea()) swap( child1, child2 );
+			stack[stackPtr++] = child2, node = child1;
+		}
+		else if (hit1) node = child1;
+		else if (hit2) node = child2;
+		else if (stackPtr == 0) break; else node = stack[--stackPtr];
+	}
+	return false;
+}
+int BVH::IsOccluded( const Ray* rays, const uint count, uint* occluded ) const
+{
+	memset( occluded, 0, ((count + 31) >> 5) * sizeof( uint ) );
+	int occludedCount = 0;
+	for (uint i = 0; i < count; i++) if (IsOccluded( rays[i] )) occluded[i >> 5] |= 1u << (i & 31), occludedCount++;
+	return occludedCount;
+}
+
+// OccludedTri: as IntersectTri, without storing the hit
+bool BVH::OccludedTri( const Ray& ray, const uint idx ) const
+{
+	const uint vertIdx = idx * 3;
+	const bvhvec3 edge1 = tris[vertIdx + 1] - tris[vertIdx];
+	const bvhvec3 edge2 = tris[vertIdx + 2] - tris[vertIdx];
+	const bvhvec3 h = cross( ray.D, edge2 );
+	const float a = dot( edge1, h );
+	if (fabs( a ) < 0.0000001f) return false; // ray parallel to triangle
+	const float f = 1 / a;
+	const bvhvec3 s = ray.O - bvhvec3( tris[vertIdx] );
+	const float u = f * dot( s, h );
+	if (u < 0 || u > 1) return false;
+	const bvhvec3 q = cross( s, edge1 );
+	const float v = f * dot( ray.D, q );
+	if (v < 0 || u + v > 1) return false;
+	const float t = f * dot( edge2, q );
+	return t > 0 && t < ray.hit.t;
+}
+
 // IntersectAABB
 float BVH::IntersectAABB( const Ray& ray, const bvhvec3& aabbMin, const bvhvec3& aabbMax )
 {
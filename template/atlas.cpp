@@ -0,0 +1,280 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the texture atlas defined in atlas.h.
+// Packing uses the skyline bottom-left heuristic: each page keeps a list of
+// horizontal segments describing the top edge of the occupied area, and each
+// image is placed where its top edge ends up lowest.
+
+#include "precomp.h"
+
+using namespace Tmpl8;
+
+// constructor
+Atlas::Atlas( const int size ) : pageSize( size )
+{
+}
+
+// destructor
+Atlas::~Atlas()
+{
+	Clear();
+}
+
+// free all pages and pending images
+void Atlas::Clear()
+{
+	for (Surface* page : pages) delete page;
+	for (Surface* image : pending) delete image;
+	pages.clear();
+	pending.clear();
+	skyline.clear();
+	entries.clear();
+}
+
+// add an image file to the atlas; frames are stored side by side in the file
+int Atlas::Add( const char* file, const int frameCount )
+{
+	Surface* image = new Surface( file );
+	FATALERROR_IF( image->pixels == 0, "Atlas: could not load %s", file );
+	FATALERROR_IF( frameCount < 1 || frameCount > image->width, "Atlas: invalid frame count %i for %s", frameCount, file );
+	AtlasEntry entry;
+	entry.name = file;
+	entry.frameWidth = image->width / frameCount;
+	entry.frameHeight = image->height;
+	entry.frameCount = frameCount;
+	entries.push_back( entry );
+	pending.push_back( image );
+	return (int)entries.size() - 1;
+}
+
+// add a copy of an existing surface to the atlas
+int Atlas::Add( const char* name, const Surface* surface, const int frameCount )
+{
+	FATALERROR_IF( frameCount < 1 || frameCount > surface->width, "Atlas: invalid frame count %i for %s", frameCount, name );
+	Surface* image = new Surface( surface->width, surface->height );
+	memcpy( image->pixels, surface->pixels, surface->width * surface->height * sizeof( uint ) );
+	AtlasEntry entry;
+	entry.name = name;
+	entry.frameWidth = surface->width / frameCount;
+	entry.frameHeight = surface->height;
+	entry.frameCount = frameCount;
+	entries.push_back( entry );
+	pending.push_back( image );
+	return (int)entries.size() - 1;
+}
+
+// find the lowest position for a w * h rectangle on a page
+bool Atlas::FindPosition( const int page, const int w, const int h, int& bestX, int& bestY, int& bestSegment ) const
+{
+	const vector<SkylineSegment>& s = skyline[page];
+	int bestTop = INT_MAX, bestWidth = INT_MAX;
+	for (int i = 0; i < (int)s.size(); i++)
+	{
+		const int x = s[i].x;
+		if (x + w > pageSize) break;
+		// the rectangle rests on the highest segment it spans
+		int y = 0;
+		for (int j = i, left = w; left > 0; j++)
+		{
+			y = max( y, s[j].y );
+			left -= s[j].width;
+		}
+		if (y + h > pageSize) continue;
+		if (y + h < bestTop || (y + h == bestTop && s[i].width < bestWidth))
+		{
+			bestTop = y + h, bestWidth = s[i].width;
+			bestX = x, bestY = y, bestSegment = i;
+		}
+	}
+	return bestTop != INT_MAX;
+}
+
+// update the skyline after placing a rectangle
+void Atlas::AddSkylineLevel( const int page, const int segment, const int x, const int y, const int w, const int h )
+{
+	vector<SkylineSegment>& s = skyline[page];
+	s.insert( s.begin() + segment, { x, y + h, w } );
+	// remove or shorten the segments now covered by the new one
+	for (int i = segment + 1; i < (int)s.size(); i++)
+	{
+		const int end = s[i - 1].x + s[i - 1].width;
+		if (s[i].x >= end) break;
+		const int shrink = end - s[i].x;
+		s[i].x += shrink, s[i].width -= shrink;
+		if (s[i].width > 0) break;
+		s.erase( s.begin() + i ), i--;
+	}
+	// merge neighbours at the same height
+	for (int i = 0; i < (int)s.size() - 1; i++) if (s[i].y == s[i + 1].y)
+	{
+		s[i].width += s[i + 1].width;
+		s.erase( s.begin() + i + 1 ), i--;
+	}
+}
+
+// pack all images added since the last call
+void Atlas::Pack()
+{
+	// process the tallest images first; this gives the densest packing
+	vector<int> order;
+	for (int i = 0; i < (int)entries.size(); i++) if (entries[i].page == -1) order.push_back( i );
+	const int firstPending = (int)entries.size() - (int)pending.size();
+	for (int idx : order)
+	{
+		AtlasEntry& e = entries[idx];
+		FATALERROR_IF( e.frameWidth > pageSize || e.frameHeight > pageSize, "Atlas: %s does not fit on a page", e.name.c_str() );
+		e.framesPerRow = min( e.frameCount, pageSize / e.frameWidth );
+	}
+	sort( order.begin(), order.end(), [this]( const int a, const int b ) {
+		const AtlasEntry& ea = entries[a], & eb = entries[b];
+		const int ha = ((ea.frameCount + ea.framesPerRow - 1) / ea.framesPerRow) * ea.frameHeight;
+		const int hb = ((eb.frameCount + eb.framesPerRow - 1) / eb.framesPerRow) * eb.frameHeight;
+		return ha != hb ? ha > hb : ea.frameWidth * ea.framesPerRow > eb.frameWidth * eb.framesPerRow;
+	} );
+	for (int idx : order)
+	{
+		AtlasEntry& e = entries[idx];
+		const int rows = (e.frameCount + e.framesPerRow - 1) / e.framesPerRow;
+		const int w = e.framesPerRow * e.frameWidth, h = rows * e.frameHeight;
+		FATALERROR_IF( h > pageSize, "Atlas: %s does not fit on a page", e.name.c_str() );
+		// find a page with room for the image; open a new page if there is none
+		int x = 0, y = 0, segment = 0, page = 0;
+		while (page < (int)pages.size() && !FindPosition( page, w, h, x, y, segment )) page++;
+		if (page == (int)pages.size())
+		{
+			Surface* newPage = new Surface( pageSize, pageSize );
+			newPage->Clear( 0 );
+			pages.push_back( newPage );
+			skyline.push_back( { { 0, 0, pageSize } } );
+			FindPosition( page, w, h, x, y, segment );
+		}
+		AddSkylineLevel( page, segment, x, y, w, h );
+		e.page = page, e.x = x, e.y = y;
+		// copy the frames to their place in the grid
+		const Surface* src = pending[idx - firstPending];
+		Surface* dst = pages[page];
+		for (int f = 0; f < e.frameCount; f++)
+		{
+			const int dx = x + (f % e.framesPerRow) * e.frameWidth, dy = y + (f / e.framesPerRow) * e.frameHeight;
+			for (int line = 0; line < e.frameHeight; line++)
+			{
+				const uint* srcLine = src->pixels + line * src->width + f * e.frameWidth;
+				memcpy( dst->pixels + (dy + line) * pageSize + dx, srcLine, e.frameWidth * sizeof( uint ) );
+			}
+		}
+	}
+	for (Surface* image : pending) delete image;
+	pending.clear();
+}
+
+// binary cache helpers: entries are stored field by field, so the file format
+// does not depend on the layout of AtlasEntry.
+static bool ReadInt( FILE* f, int& value ) { return fread( &value, 4, 1, f ) == 1; }
+static bool ValidEntry( const AtlasEntry& e, const int pageSize, const int pageCount )
+{
+	if (e.page < 0 || e.page >= pageCount || e.x < 0 || e.y < 0) return false;
+	if (e.frameWidth < 1 || e.frameWidth > pageSize || e.frameHeight < 1 || e.frameHeight > pageSize) return false;
+	if (e.frameCount < 1 || e.framesPerRow < 1 || e.framesPerRow > e.frameCount) return false;
+	const int64_t rows = (e.frameCount + e.framesPerRow - 1) / e.framesPerRow;
+	return e.x + (int64_t)e.framesPerRow * e.frameWidth <= pageSize && e.y + rows * e.frameHeight <= pageSize;
+}
+
+// load a previously saved atlas; returns false if the file does not exist, has
+// the wrong version, is truncated or corrupt, or if any of the source images
+// has been modified. On failure the atlas is left unchanged.
+bool Atlas::Load( const char* file )
+{
+	FILE* f = fopen( file, "rb" );
+	if (!f) return false;
+	int version = 0, size = 0, pageCount = 0, entryCount = 0;
+	bool ok = ReadInt( f, version ) && version == ATLASFILEVERSION;
+	ok = ok && ReadInt( f, size ) && ReadInt( f, pageCount ) && ReadInt( f, entryCount );
+	ok = ok && size > 0 && size <= 16384 && pageCount >= 0 && entryCount >= 0;
+	vector<AtlasEntry> loadedEntries;
+	for (int i = 0; ok && i < entryCount; i++)
+	{
+		AtlasEntry e;
+		int length = 0;
+		ok = ReadInt( f, length ) && length >= 0 && length <= 4096;
+		if (ok) e.name.resize( length ), ok = fread( e.name.data(), 1, length, f ) == (size_t)length;
+		ok = ok && ReadInt( f, e.page ) && ReadInt( f, e.x ) && ReadInt( f, e.y );
+		ok = ok && ReadInt( f, e.frameWidth ) && ReadInt( f, e.frameHeight );
+		ok = ok && ReadInt( f, e.frameCount ) && ReadInt( f, e.framesPerRow );
+		ok = ok && ValidEntry( e, size, pageCount );
+		// a changed source image means the cache must be rebuilt
+		if (ok && FileExists( e.name.c_str() ) && FileIsNewer( e.name.c_str(), file )) ok = false;
+		loadedEntries.push_back( e );
+	}
+	vector<Surface*> loadedPages;
+	for (int i = 0; ok && i < pageCount; i++)
+	{
+		Surface* page = new Surface( size, size );
+		loadedPages.push_back( page );
+		ok = fread( page->pixels, 4, (size_t)size * size, f ) == (size_t)size * size;
+	}
+	fclose( f );
+	if (!ok)
+	{
+		for (Surface* page : loadedPages) delete page;
+		return false;
+	}
+	Clear();
+	pageSize = size;
+	entries = std::move( loadedEntries );
+	pages = std::move( loadedPages );
+	for (int i = 0; i < pageCount; i++) skyline.push_back( { { 0, pageSize, pageSize } } ); // loaded pages are considered full
+	return true;
+}
+
+// save the packed atlas to a binary file
+void Atlas::Save( const char* file ) const
+{
+	for (const AtlasEntry& e : entries)
+	{
+		FATALERROR_IF( e.page == -1, "Atlas: %s has not been packed; call Pack before Save", e.name.c_str() );
+		FATALERROR_IF( e.name.size() > 4096, "Atlas: name too long (%s)", e.name.c_str() );
+	}
+	FILE* f = fopen( file, "wb" );
+	FATALERROR_IF( !f, "Atlas: could not write %s", file );
+	const int version = ATLASFILEVERSION, pageCount = (int)pages.size(), entryCount = (int)entries.size();
+	fwrite( &version, 4, 1, f );
+	fwrite( &pageSize, 4, 1, f );
+	fwrite( &pageCount, 4, 1, f );
+	fwrite( &entryCount, 4, 1, f );
+	for (const AtlasEntry& e : entries)
+	{
+		const int length = (int)e.name.size();
+		const int fields[7] = { e.page, e.x, e.y, e.frameWidth, e.frameHeight, e.frameCount, e.framesPerRow };
+		fwrite( &length, 4, 1, f );
+		fwrite( e.name.data(), 1, length, f );
+		fwrite( fields, 4, 7, f );
+	}
+	for (const Surface* page : pages) fwrite( page->pixels, 4, (size_t)pageSize * pageSize, f );
+	const bool failed = ferror( f ) != 0;
+	fclose( f );
+	FATALERROR_IF( failed, "Atlas: error writing %s", file );
+}
+
+// find an entry by name; returns -1 if it does not exist
+int Atlas::Find( const char* name ) const
+{
+	for (int i = 0; i < (int)entries.size(); i++) if (entries[i].name == name) return i;
+	return -1;
+}
+
+// create a sprite that references a packed image
+Sprite* Atlas::CreateSprite( const char* name )
+{
+	const int idx = Find( name );
+	FATALERROR_IF( idx == -1, "Atlas: no entry for %s", name );
+	return CreateSprite( idx );
+}
+
+Sprite* Atlas::CreateSprite( const int idx )
+{
+	const AtlasEntry& e = entries[idx];
+	FATALERROR_IF( e.page == -1, "Atlas: %s has not been packed", e.name.c_str() );
+	return new Sprite( pages[e.page], e.x, e.y, e.frameWidth, e.frameHeight, e.frameCount, e.framesPerRow );
+}
\ No newline at end of file
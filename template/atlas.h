@@ -0,0 +1,72 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: a texture atlas, which packs many small surfaces into a few
+// large pages. Sprites created from the atlas reference a sub-rectangle of a
+// page, so sprite data is stored in a handful of large allocations instead of
+// one allocation per sprite.
+// Typical use:
+//   Atlas atlas;
+//   if (!atlas.Load( "assets/atlas.bin" ))
+//   {
+//       atlas.Add( "assets/ball.png" );
+//       atlas.Add( "assets/player.png", 8 );
+//       atlas.Pack();
+//       atlas.Save( "assets/atlas.bin" );
+//   }
+//   Sprite* ball = atlas.CreateSprite( "assets/ball.png" );
+
+#pragma once
+
+#define ATLASFILEVERSION	0x10000001
+
+namespace Tmpl8
+{
+
+// location of a packed image in the atlas
+struct AtlasEntry
+{
+	string name;					// file name or user supplied name; used for lookups
+	int page = -1;					// page index, or -1 if the entry has not been packed yet
+	int x = 0, y = 0;				// top-left corner of the first frame on the page
+	int frameWidth = 0, frameHeight = 0;
+	int frameCount = 1;				// number of animation frames
+	int framesPerRow = 1;			// frames are stored in a grid on the page
+};
+
+// atlas builder and container
+class Atlas
+{
+public:
+	// constructor / destructor
+	Atlas( const int pageSize = 2048 );
+	~Atlas();
+	// building the atlas
+	int Add( const char* file, const int frameCount = 1 );
+	int Add( const char* name, const Surface* surface, const int frameCount = 1 );
+	void Pack();
+	// binary cache
+	bool Load( const char* file );
+	void Save( const char* file ) const;
+	// using the atlas
+	int Find( const char* name ) const;
+	Sprite* CreateSprite( const char* name );
+	Sprite* CreateSprite( const int idx );
+	Surface* GetPage( const int idx ) { return pages[idx]; }
+	int PageCount() const { return (int)pages.size(); }
+	const AtlasEntry& GetEntry( const int idx ) const { return entries[idx]; }
+private:
+	struct SkylineSegment { int x, y, width; };
+	bool FindPosition( const int page, const int w, const int h, int& bestX, int& bestY, int& bestSegment ) const;
+	void AddSkylineLevel( const int page, const int segment, const int x, const int y, const int w, const int h );
+	void Clear();
+	// data members
+	int pageSize;
+	vector<AtlasEntry> entries;
+	vector<Surface*> pending;		// source images for entries that still need to be packed
+	vector<Surface*> pages;
+	vector<vector<SkylineSegment>> skyline;
+};
+
+} // namespace Tmpl8
\ No newline at end of file
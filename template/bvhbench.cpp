@@ -0,0 +1,195 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: the BVH benchmark declared in bvhbench.h.
+
+#include "precomp.h"
+#include "tiny_bvh.h"
+using namespace tinybvh;
+#include "bvhbench.h"
+
+// rays from random points on a sphere around the mesh, aimed at random points in its bounds
+static void GenerateRays( const BVH& bvh, Ray* rays, const int n )
+{
+	PCG32 rng( 1234 );
+	const bvhvec3 bmin = bvh.bvhNode[0].aabbMin, bmax = bvh.bvhNode[0].aabbMax;
+	const float3 lo = make_float3( bmin.x, bmin.y, bmin.z ), hi = make_float3( bmax.x, bmax.y, bmax.z );
+	const float3 center = (lo + hi) * 0.5f;
+	const float radius = length( hi - lo );
+	for (int i = 0; i < n; i++)
+	{
+		const float z = rng.NextFloat( -1, 1 ), a = rng.NextFloat( 0, TWOPI ), r = sqrtf( 1 - z * z );
+		const float3 O = center + radius * make_float3( r * cosf( a ), r * sinf( a ), z );
+		const float3 T = lo + (hi - lo) * make_float3( rng.NextFloat(), rng.NextFloat(), rng.NextFloat() );
+		const float3 D = normalize( T - O );
+		rays[i] = Ray( bvhvec3( O.x, O.y, O.z ), bvhvec3( D.x, D.y, D.z ) );
+	}
+}
+
+// primary rays for a width x height image, from a camera outside the mesh, looking at its center.
+// Rays are stored per 4x4 pixel tile; the first eight rays of a tile form a 4x2 tile.
+static void GenerateCameraRays( const BVH& bvh, Ray* rays, const int width, const int height )
+{
+	const bvhvec3 bmin = bvh.bvhNode[0].aabbMin, bmax = bvh.bvhNode[0].aabbMax;
+	const float3 lo = make_float3( bmin.x, bmin.y, bmin.z ), hi = make_float3( bmax.x, bmax.y, bmax.z );
+	const float3 target = (lo + hi) * 0.5f, eye = target + (hi - lo) * make_float3( 0.3f, 0.4f, -1.0f );
+	const float3 ahead = normalize( target - eye ), right = normalize( cross( make_float3( 0, 1, 0 ), ahead ) ), up = cross( ahead, right );
+	for (int i = 0, ty = 0; ty < height; ty += 4) for (int tx = 0; tx < width; tx += 4) for (int y = ty; y < ty + 4; y++) for (int x = tx; x < tx + 4; x++, i++)
+	{
+		const float3 D = normalize( ahead + right * ((x + 0.5f) / width - 0.5f) + up * (0.5f - (y + 0.5f) / height) );
+		rays[i] = Ray( bvhvec3( eye.x, eye.y, eye.z ), bvhvec3( D.x, D.y, D.z ) );
+	}
+}
+
+// shadow rays from the primary hit points to a point light above the mesh; returns the number of rays
+static int GenerateShadowRays( const BVH& bvh, const Ray* primary, const float* distances, const int n, Ray* rays )
+{
+	const bvhvec3 bmin = bvh.bvhNode[0].aabbMin, bmax = bvh.bvhNode[0].aabbMax;
+	const bvhvec3 light = (bmin + bmax) * 0.5f + (bmax - bmin) * bvhvec3( -0.4f, 1.0f, -0.2f );
+	int count = 0;
+	for (int i = 0; i < n; i++) if (distances[i] < 1e30f)
+	{
+		// start slightly in front of the surface and stop slightly before the light
+		const bvhvec3 O = primary[i].O + primary[i].D * (distances[i] * 0.999f);
+		const bvhvec3 L = light - O;
+		const float dist = sqrtf( L.x * L.x + L.y * L.y + L.z * L.z );
+		rays[count++] = Ray( O, L * (1 / dist), dist * 0.999f );
+	}
+	return count;
+}
+
+// trace all rays with 'trace', which returns the number of visited nodes; reference holds the expected distances
+template <class F> static void Trace( const char* name, F trace, const Ray* rays, const float* reference, const int n )
+{
+	int64_t steps = 0;
+	int errors = 0;
+	Timer t;
+	for (int i = 0; i < n; i++)
+	{
+		Ray ray = rays[i];
+		steps += trace( ray );
+		if (reference && ray.hit.t != reference[i]) errors++;
+	}
+	const float elapsed = t.elapsed();
+	printf( "%-24s %8.2f Mrays/s %8.2f nodes/ray %8i errors\n", name, n / (elapsed * 1e6f), (float)steps / n, errors );
+}
+
+// trace all rays in packets of N; rays are grouped in tiles by GenerateCameraRays
+template <int N> static void TracePackets( const char* name, const BVH& bvh, const Ray* rays, const float* reference, const int n )
+{
+	int64_t steps = 0;
+	int errors = 0;
+	RayPacket<N> packet;
+	Timer t;
+	for (int i = 0; i < n; i += 16) for (int j = 0; j < 16; j += N)
+	{
+		for (int k = 0; k < N; k++) packet.Set( k, rays[i + j + k] );
+		if constexpr (N == 8) steps += bvh.Intersect8( packet ); else steps += bvh.Intersect16( packet );
+		for (int k = 0; k < N; k++) if (packet.t[k] != reference[i + j + k]) errors++;
+	}
+	const float elapsed = t.elapsed();
+	printf( "%-24s %8.2f Mrays/s %8.2f nodes/ray %8i errors\n", name, n / (elapsed * 1e6f), (float)steps / n, errors );
+}
+
+// occlusion queries; 'occluded' returns a bitmask for the 'count' rays starting at ray i
+template <class F> static void Occlude( const char* name, F occluded, const int count, const bool* reference, const int n )
+{
+	int errors = 0, blocked = 0;
+	Timer t;
+	for (int i = 0; i < n; i += count)
+	{
+		const uint mask = occluded( i );
+		for (int k = 0; k < count; k++)
+		{
+			const bool hit = ((mask >> k) & 1) != 0;
+			if (hit != reference[i + k]) errors++;
+			if (hit) blocked++;
+		}
+	}
+	const float elapsed = t.elapsed();
+	printf( "%-24s %8.2f Mrays/s %7.1f%% occluded %8i errors\n", name, n / (elapsed * 1e6f), blocked * 100.0f / n, errors );
+}
+
+void BVHBenchmark( const float4* vertices, const int triCount, const int rayCount )
+{
+	// construction
+	BVH bvh;
+	Timer t;
+	bvh.BuildMT( (const bvhvec4*)vertices, triCount );
+	printf( "BVH: %i triangles, %i nodes, SAH cost %.2f, built in %.1fms\n", triCount, bvh.NodeCount(), bvh.SAHCost(), t.elapsed() * 1000 );
+	BVH4 bvh4;
+	BVH8 bvh8;
+	t.reset(), bvh4.Convert( bvh );
+	printf( "BVH4: %i nodes (%i bytes), converted in %.1fms\n", bvh4.nodeCount, bvh4.nodeCount * (int)sizeof( BVH4::MBVHNode ), t.elapsed() * 1000 );
+	t.reset(), bvh8.Convert( bvh );
+	printf( "BVH8: %i nodes (%i bytes), converted in %.1fms\n", bvh8.nodeCount, bvh8.nodeCount * (int)sizeof( BVH8::MBVHNode ), t.elapsed() * 1000 );
+	QBVH4 qbvh4;
+	QBVH8 qbvh8;
+	t.reset(), qbvh4.Convert( bvh );
+	printf( "QBVH4: %i nodes (%i bytes), converted in %.1fms\n", qbvh4.nodeCount, qbvh4.nodeCount * (int)sizeof( QBVH4::QMBVHNode ), t.elapsed() * 1000 );
+	t.reset(), qbvh8.Convert( bvh );
+	printf( "QBVH8: %i nodes (%i bytes), converted in %.1fms\n", qbvh8.nodeCount, qbvh8.nodeCount * (int)sizeof( QBVH8::QMBVHNode ), t.elapsed() * 1000 );
+	// traversal
+	Ray* rays = (Ray*)MALLOC64( rayCount * sizeof( Ray ) );
+	float* reference = (float*)MALLOC64( rayCount * sizeof( float ) );
+	GenerateRays( bvh, rays, rayCount );
+	for (int i = 0; i < rayCount; i++)
+	{
+		Ray ray = rays[i];
+		bvh.Intersect( ray );
+		reference[i] = ray.hit.t;
+	}
+	Trace( "BVH::Intersect", [&]( Ray& ray ) { return bvh.Intersect( ray ); }, rays, reference, rayCount );
+	Trace( "BVH4::Intersect", [&]( Ray& ray ) { return bvh4.Intersect( ray ); }, rays, reference, rayCount );
+	Trace( "BVH8::Intersect", [&]( Ray& ray ) { return bvh8.Intersect( ray ); }, rays, reference, rayCount );
+	Trace( "QBVH4::Intersect", [&]( Ray& ray ) { return qbvh4.Intersect( ray ); }, rays, reference, rayCount );
+	Trace( "QBVH8::Intersect", [&]( Ray& ray ) { return qbvh8.Intersect( ray ); }, rays, reference, rayCount );
+	// spatial splits: same rays, SBVH versus binned SAH
+	BVH sbvh;
+	t.reset(), sbvh.BuildHQ( (const bvhvec4*)vertices, triCount );
+	printf( "SBVH: %i references (+%.1f%%), %i nodes, SAH cost %.2f, built in %.1fms\n", sbvh.idxCount,
+		(sbvh.idxCount - triCount) * 100.0f / triCount, sbvh.NodeCount(), sbvh.SAHCost(), t.elapsed() * 1000 );
+	Trace( "SBVH::Intersect", [&]( Ray& ray ) { return sbvh.Intersect( ray ); }, rays, reference, rayCount );
+	// reinsertion: same rays, optimized versus plain binned SAH
+	BVH optimized;
+	optimized.BuildMT( (const bvhvec4*)vertices, triCount );
+	t.reset(), optimized.Optimize( 25, 5.0f );
+	printf( "optimized BVH: SAH cost %.2f (was %.2f), optimized in %.1fms\n", optimized.SAHCost(), bvh.SAHCost(), t.elapsed() * 1000 );
+	Trace( "optimized BVH::Intersect", [&]( Ray& ray ) { return optimized.Intersect( ray ); }, rays, reference, rayCount );
+	FREE64( rays ), FREE64( reference );
+	// coherent rays: single rays versus packets
+	const int size = 1024, pixels = size * size;
+	rays = (Ray*)MALLOC64( pixels * sizeof( Ray ) );
+	reference = (float*)MALLOC64( pixels * sizeof( float ) );
+	GenerateCameraRays( bvh, rays, size, size );
+	for (int i = 0; i < pixels; i++)
+	{
+		Ray ray = rays[i];
+		bvh.Intersect( ray );
+		reference[i] = ray.hit.t;
+	}
+	printf( "primary rays, %ix%i:\n", size, size );
+	Trace( "BVH::Intersect", [&]( Ray& ray ) { return bvh.Intersect( ray ); }, rays, reference, pixels );
+	TracePackets<8>( "BVH::Intersect8", bvh, rays, reference, pixels );
+	TracePackets<16>( "BVH::Intersect16", bvh, rays, reference, pixels );
+	// shadow rays: any-hit queries versus closest hit
+	Ray* shadowRays = (Ray*)MALLOC64( pixels * sizeof( Ray ) );
+	const int shadowCount = GenerateShadowRays( bvh, rays, reference, pixels, shadowRays ) & ~15;
+	bool* occluded = new bool[shadowCount];
+	for (int i = 0; i < shadowCount; i++) occluded[i] = bvh.IsOccluded( shadowRays[i] );
+	printf( "shadow rays, %i:\n", shadowCount );
+	Occlude( "BVH::Intersect", [&]( int i ) {
+		Ray ray = shadowRays[i];
+		bvh.Intersect( ray );
+		return ray.hit.t < shadowRays[i].hit.t ? 1u : 0u;
+	}, 1, occluded, shadowCount );
+	Occlude( "BVH::IsOccluded", [&]( int i ) { return bvh.IsOccluded( shadowRays[i] ) ? 1u : 0u; }, 1, occluded, shadowCount );
+	RayPacket16 packet;
+	Occlude( "BVH::IsOccluded16", [&]( int i ) {
+		for (int k = 0; k < 16; k++) packet.Set( k, shadowRays[i + k] );
+		return bvh.IsOccluded16( packet );
+	}, 16, occluded, shadowCount );
+	delete[] occluded;
+	FREE64( rays ), FREE64( reference ), FREE64( shadowRays );
+}
@@ -0,0 +1,19 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: a benchmark for the BVH layouts of tiny_bvh. A BVH is built
+// over a triangle soup (three vertices per triangle, as in Mesh::vertices),
+// after which the same rays are traced through each layout, including the
+// quantized wide layouts. For each layout, the node memory, the ray
+// throughput and the average number of visited nodes are reported, and hits
+// are verified against BVH::Intersect; a spatial split BVH (BVH::BuildHQ)
+// and a BVH improved with BVH::Optimize are traced with the same rays for
+// comparison. Coherent primary rays are traced as single rays and as 8- and
+// 16-ray packets, after which shadow rays from the primary hit points compare
+// any-hit occlusion queries against closest-hit traversal. Typical use:
+//   BVHBenchmark( mesh->vertices.data(), (int)mesh->vertices.size() / 3 );
+
+#pragma once
+
+void BVHBenchmark( const float4* vertices, const int triCount, const int rayCount = 1 << 20 );
@@ -0,0 +1,172 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the frame capture service defined in
+// capture.h. The ring is a single-producer, single-consumer queue: the main
+// thread only advances 'head', the worker only advances 'tail'. The mutex is
+// used only to sleep and wake up, never to access the frames.
+
+#include "precomp.h"
+#include "capture.h"
+
+// constructor
+FrameCapture::FrameCapture( const int w, const int h, const char* dir, const int slotCount, const int p, const int f ) :
+	maxWidth( w ), maxHeight( h ), policy( p ), format( f ), directory( dir )
+{
+	slots.resize( max( 2, slotCount ) );
+	for (Slot& slot : slots) slot.pixels = (uint*)MALLOC64( w * h * sizeof( uint ) );
+	worker = thread( &FrameCapture::Worker, this );
+}
+
+// destructor: write the remaining frames, then stop the worker
+FrameCapture::~FrameCapture()
+{
+	Flush();
+	{
+		lock_guard<mutex> lock( signalMutex );
+		quit = true;
+	}
+	frameReady.notify_one();
+	worker.join();
+	for (Slot& slot : slots) FREE64( slot.pixels );
+}
+
+// snapshot the screen; returns false if the frame was dropped
+bool FrameCapture::Capture( const Surface* screen )
+{
+	const uint h = head.load( memory_order_relaxed );
+	const int frame = frameCounter++;
+	if (h - tail.load( memory_order_acquire ) == slots.size())
+	{
+		if (policy == DROP)
+		{
+			dropped++;
+			return false;
+		}
+		unique_lock<mutex> lock( signalMutex );
+		slotFree.wait( lock, [&] { return h - tail.load( memory_order_acquire ) < slots.size(); } );
+	}
+	Slot& slot = slots[h % slots.size()];
+	slot.width = min( screen->width, maxWidth );
+	slot.height = min( screen->height, maxHeight );
+	slot.frame = frame;
+	for (int y = 0; y < slot.height; y++)
+		memcpy( slot.pixels + y * slot.width, screen->pixels + y * screen->width, slot.width * sizeof( uint ) );
+	{
+		// publish under the lock, so the worker cannot miss the notification
+		lock_guard<mutex> lock( signalMutex );
+		head.store( h + 1, memory_order_release );
+	}
+	frameReady.notify_one();
+	return true;
+}
+
+// wait until all captured frames have been written
+void FrameCapture::Flush()
+{
+	const uint h = head.load( memory_order_relaxed );
+	unique_lock<mutex> lock( signalMutex );
+	slotFree.wait( lock, [&] { return tail.load( memory_order_acquire ) == h; } );
+}
+
+// worker thread: compress and write frames until the capture service is destroyed
+void FrameCapture::Worker()
+{
+	while (1)
+	{
+		const uint t = tail.load( memory_order_relaxed );
+		if (t == head.load( memory_order_acquire ))
+		{
+			// sleep until a frame is captured or the service shuts down; pending frames are written first
+			unique_lock<mutex> lock( signalMutex );
+			frameReady.wait( lock, [&] { return quit || head.load( memory_order_acquire ) != t; } );
+			if (head.load( memory_order_acquire ) == t) return;
+			continue;
+		}
+		if (Write( slots[t % slots.size()] )) written.fetch_add( 1, memory_order_release );
+		else failed.fetch_add( 1, memory_order_release );
+		{
+			lock_guard<mutex> lock( signalMutex );
+			tail.store( t + 1, memory_order_release );
+		}
+		slotFree.notify_all();
+	}
+}
+
+// write a single frame; returns false if the file could not be created or
+// written, or if compression failed. A partially written file is removed.
+bool FrameCapture::Write( const Slot& slot )
+{
+	char fileName[1024];
+	snprintf( fileName, sizeof( fileName ), "%s/frame_%05i.%s", directory.c_str(), slot.frame, format == PNG ? "png" : "zfb" );
+	FILE* f = fopen( fileName, "wb" );
+	if (!f) return false; // not fatal; we are not on the main thread
+	bool ok = true;
+	if (format == PNG) ok = WritePNG( f, slot ); else
+	{
+		const uLong rawSize = slot.width * slot.height * sizeof( uint );
+		uLongf size = compressBound( rawSize );
+		compressed.resize( size );
+		ok = compress2( compressed.data(), &size, (const Bytef*)slot.pixels, rawSize, compressionLevel ) == Z_OK;
+		if (ok)
+		{
+			const uint header[4] = { CAPTUREFILEVERSION, (uint)slot.width, (uint)slot.height, (uint)size };
+			fwrite( header, 4, 4, f );
+			fwrite( compressed.data(), 1, size, f );
+		}
+	}
+	ok = ok && !ferror( f );
+	ok = (fclose( f ) == 0) && ok;
+	if (!ok) remove( fileName );
+	return ok;
+}
+
+// PNG helpers: big-endian integers and crc-protected chunks
+static void WriteBE( FILE* f, const uint v )
+{
+	const unsigned char b[4] = { (unsigned char)(v >> 24), (unsigned char)(v >> 16), (unsigned char)(v >> 8), (unsigned char)v };
+	fwrite( b, 1, 4, f );
+}
+static void WriteChunk( FILE* f, const char* type, const unsigned char* data, const uint size )
+{
+	WriteBE( f, size );
+	fwrite( type, 1, 4, f );
+	if (size) fwrite( data, 1, size, f );
+	uLong crc = crc32( 0, (const Bytef*)type, 4 );
+	if (size) crc = crc32( crc, data, size );
+	WriteBE( f, (uint)crc );
+}
+
+// write a frame as an 8-bit RGB PNG file; alpha is not stored. Returns false
+// if compression failed, in which case nothing is written.
+bool FrameCapture::WritePNG( FILE* f, const Slot& slot )
+{
+	// scanlines: a filter byte (0: none), followed by the pixels in RGB order
+	const int w = slot.width, h = slot.height, lineSize = w * 3 + 1;
+	vector<unsigned char>& raw = lines;
+	raw.resize( lineSize * h );
+	for (int y = 0; y < h; y++)
+	{
+		unsigned char* line = raw.data() + y * lineSize;
+		const uint* src = slot.pixels + y * w;
+		line[0] = 0;
+		for (int x = 0; x < w; x++)
+			line[1 + x * 3] = (unsigned char)(src[x] >> 16), line[2 + x * 3] = (unsigned char)(src[x] >> 8), line[3 + x * 3] = (unsigned char)src[x];
+	}
+	uLongf size = compressBound( (uLong)raw.size() );
+	compressed.resize( size );
+	if (compress2( compressed.data(), &size, raw.data(), (uLong)raw.size(), compressionLevel ) != Z_OK) return false;
+	// file: signature, header, image data, end
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	fwrite( signature, 1, 8, f );
+	unsigned char ihdr[13] = {
+		(unsigned char)(w >> 24), (unsigned char)(w >> 16), (unsigned char)(w >> 8), (unsigned char)w,
+		(unsigned char)(h >> 24), (unsigned char)(h >> 16), (unsigned char)(h >> 8), (unsigned char)h,
+		8 /* bit depth */, 2 /* color type: RGB */, 0, 0, 0
+	};
+	WriteChunk( f, "IHDR", ihdr, 13 );
+	WriteChunk( f, "IDAT", compressed.data(), (uint)size );
+	WriteChunk( f, "IEND", 0, 0 );
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: frame capture to disk. Capture copies the screen into a
+// preallocated ring of frame buffers; a worker thread compresses the frames
+// using zlib and writes them to disk. When the ring is full, the frame is
+// either dropped (DROP, the default: Capture never waits) or Capture waits
+// for a free slot (STALL: no frames are lost, but Tick may be delayed).
+// Typical use:
+//   FrameCapture* capture = new FrameCapture( SCRWIDTH, SCRHEIGHT, "capture" );
+//   ...
+//   capture->Capture( screen ); // at the end of Tick
+// Frames are written as capture/frame_00000.png and so on. Written counts the
+// frames that reached the disk; frames that could not be written (e.g. a
+// missing directory or a full disk) are counted by Failed instead.
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define CAPTUREFILEVERSION	0x10000001
+
+namespace Tmpl8
+{
+
+class FrameCapture
+{
+public:
+	enum { DROP = 0, STALL = 1 };		// policy when all slots are in use
+	enum { PNG = 0, DEFLATE = 1 };		// file format; DEFLATE: header + zlib stream of 32-bit pixels
+	// constructor / destructor
+	FrameCapture( const int width, const int height, const char* directory = ".",
+		const int slotCount = 8, const int policy = DROP, const int format = PNG );
+	~FrameCapture();
+	// methods
+	bool Capture( const Surface* screen );
+	void Flush();
+	int Written() const { return written.load( memory_order_acquire ); }
+	int Dropped() const { return dropped; }
+	int Failed() const { return failed.load( memory_order_acquire ); }	// captured, but could not be written
+	// settings
+	int compressionLevel = 1;			// zlib level; 1 is fastest, 9 gives the smallest files
+private:
+	struct Slot { uint* pixels = 0; int width = 0, height = 0, frame = 0; };
+	void Worker();
+	bool Write( const Slot& slot );
+	bool WritePNG( FILE* f, const Slot& slot );
+	// data members
+	int maxWidth, maxHeight, policy, format;
+	string directory;
+	vector<Slot> slots;
+	atomic<uint> head = 0;				// frames captured; written by the main thread only
+	atomic<uint> tail = 0;				// frames written; written by the worker only
+	atomic<int> written = 0, failed = 0;
+	int dropped = 0, frameCounter = 0;
+	bool quit = false;
+	mutex signalMutex;
+	condition_variable frameReady, slotFree;
+	thread worker;
+	vector<unsigned char> lines, compressed;	// encoding buffers; worker only
+};
+
+} // namespace Tmpl8
\ No newline at end of file
@@ -0,0 +1,179 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the frustum culling defined in cull.h.
+// Plane extraction: Gribb & Hartmann, 'Fast Extraction of Viewing Frustum
+// Planes from the World-View-Projection Matrix', 2001.
+
+#include "precomp.h"
+#include "tiny_bvh.h"
+using namespace tinybvh;
+#include "scene.h"
+#include "cull.h"
+
+using namespace Tmpl8;
+
+// Frustum
+Frustum::Frustum( const mat4& M, const bool zeroToOneDepth )
+{
+	// rows of the matrix; a plane is a combination of the w row and one other row
+	float4 r[4];
+	for (int i = 0; i < 4; i++) r[i] = make_float4( M[i * 4 + 0], M[i * 4 + 1], M[i * 4 + 2], M[i * 4 + 3] );
+	const float4 planes[6] = {
+		r[3] + r[0], r[3] - r[0],	// left, right
+		r[3] + r[1], r[3] - r[1],	// bottom, top
+		zeroToOneDepth ? r[2] : r[3] + r[2], r[3] - r[2] // near, far
+	};
+	SetPlanes( planes, 6 );
+}
+
+void Frustum::SetPlanes( const float4* planes, const int count )
+{
+	FATALERROR_IF( count > CULLMAXPLANES, "Frustum::SetPlanes: at most %i planes are supported.", CULLMAXPLANES );
+	for (int i = 0; i < count; i++)
+	{
+		const float l = length( make_float3( planes[i] ) );
+		plane[i] = l > 0 ? planes[i] * (1 / l) : planes[i];
+	}
+	planeCount = count;
+}
+
+int Frustum::Classify( const aabb& box, uint& planeMask ) const
+{
+	int result = CULL_INSIDE;
+	for (int i = 0; i < planeCount; i++) if (planeMask & (1 << i))
+	{
+		// the corner furthest along the plane normal decides if the box is outside,
+		// the nearest corner decides if it is completely inside
+		const float4& P = plane[i];
+		const float dFar = P.x * (P.x >= 0 ? box.bmax[0] : box.bmin[0]) + P.y * (P.y >= 0 ? box.bmax[1] : box.bmin[1]) + P.z * (P.z >= 0 ? box.bmax[2] : box.bmin[2]) + P.w;
+		if (dFar < 0) return CULL_OUTSIDE;
+		const float dNear = P.x * (P.x >= 0 ? box.bmin[0] : box.bmax[0]) + P.y * (P.y >= 0 ? box.bmin[1] : box.bmax[1]) + P.z * (P.z >= 0 ? box.bmin[2] : box.bmax[2]) + P.w;
+		if (dNear >= 0) planeMask &= ~(1 << i); else result = CULL_INTERSECTS;
+	}
+	return result;
+}
+
+bool Frustum::Visible( const aabb& box ) const
+{
+	uint mask = AllPlanes();
+	return Classify( box, mask ) != CULL_OUTSIDE;
+}
+
+bool Frustum::Visible( const float3& center, const float radius ) const
+{
+	for (int i = 0; i < planeCount; i++) if (dot( make_float3( plane[i] ), center ) + plane[i].w < -radius) return false;
+	return true;
+}
+
+// batch culling; N objects per iteration, gathered from the AoS input
+static int CountBits( uint v ) { int c = 0; for (; v; v &= v - 1) c++; return c; }
+
+template <class T> static int CullAABBsN( const Frustum& f, const aabb* boxes, const int first, const int n, uint* visible, int& done )
+{
+	const int N = T::lanes;
+	const uint all = (1u << N) - 1;
+	int count = 0, i = first;
+	for (; i + N <= n; i += N)
+	{
+		// aabb is 8 floats: bmin[4], bmax[4]
+		const float* b = boxes[i].bmin;
+		const T x0 = T::Gather( b + 0, 8 ), y0 = T::Gather( b + 1, 8 ), z0 = T::Gather( b + 2, 8 );
+		const T x1 = T::Gather( b + 4, 8 ), y1 = T::Gather( b + 5, 8 ), z1 = T::Gather( b + 6, 8 );
+		uint outside = 0;
+		for (int p = 0; p < f.planeCount; p++)
+		{
+			// the plane is the same for all lanes, so the furthest corner is selected once
+			const float4& P = f.plane[p];
+			const T d = madd( T( P.x ), P.x >= 0 ? x1 : x0, madd( T( P.y ), P.y >= 0 ? y1 : y0, madd( T( P.z ), P.z >= 0 ? z1 : z0, T( P.w ) ) ) );
+			outside |= bits( d < T( 0 ) );
+		}
+		const uint in = ~outside & all;
+		visible[i >> 5] |= in << (i & 31), count += CountBits( in );
+	}
+	done = i;
+	return count;
+}
+
+template <class T> static int CullSpheresN( const Frustum& f, const float4* spheres, const int first, const int n, uint* visible, int& done )
+{
+	const int N = T::lanes;
+	const uint all = (1u << N) - 1;
+	int count = 0, i = first;
+	for (; i + N <= n; i += N)
+	{
+		const float* s = &spheres[i].x;
+		const T x = T::Gather( s + 0, 4 ), y = T::Gather( s + 1, 4 ), z = T::Gather( s + 2, 4 ), r = T::Gather( s + 3, 4 );
+		uint outside = 0;
+		for (int p = 0; p < f.planeCount; p++)
+		{
+			const float4& P = f.plane[p];
+			const T d = madd( T( P.x ), x, madd( T( P.y ), y, madd( T( P.z ), z, T( P.w ) ) ) );
+			outside |= bits( d < -r );
+		}
+		const uint in = ~outside & all;
+		visible[i >> 5] |= in << (i & 31), count += CountBits( in );
+	}
+	done = i;
+	return count;
+}
+
+int Tmpl8::CullAABBs( const Frustum& frustum, const aabb* boxes, const int n, uint* visible )
+{
+	memset( visible, 0, ((n + 31) >> 5) * sizeof( uint ) );
+	int count = 0, i = 0;
+#ifdef SIMD_F32X16
+	if (CPUCaps::HW_AVX512F) count += CullAABBsN<f32x16>( frustum, boxes, i, n, visible, i );
+#endif
+#ifdef SIMD_F32X8
+	if (CPUCaps::HW_AVX2 && CPUCaps::HW_FMA3) count += CullAABBsN<f32x8>( frustum, boxes, i, n, visible, i );
+#endif
+	count += CullAABBsN<f32x4>( frustum, boxes, i, n, visible, i );
+	for (; i < n; i++) if (frustum.Visible( boxes[i] )) visible[i >> 5] |= 1u << (i & 31), count++;
+	return count;
+}
+
+int Tmpl8::CullSpheres( const Frustum& frustum, const float4* spheres, const int n, uint* visible )
+{
+	memset( visible, 0, ((n + 31) >> 5) * sizeof( uint ) );
+	int count = 0, i = 0;
+#ifdef SIMD_F32X16
+	if (CPUCaps::HW_AVX512F) count += CullSpheresN<f32x16>( frustum, spheres, i, n, visible, i );
+#endif
+#ifdef SIMD_F32X8
+	if (CPUCaps::HW_AVX2 && CPUCaps::HW_FMA3) count += CullSpheresN<f32x8>( frustum, spheres, i, n, visible, i );
+#endif
+	count += CullSpheresN<f32x4>( frustum, spheres, i, n, visible, i );
+	for (; i < n; i++) if (frustum.Visible( make_float3( spheres[i] ), spheres[i].w )) visible[i >> 5] |= 1u << (i & 31), count++;
+	return count;
+}
+
+// scene culling
+int Tmpl8::CullMeshes( const Frustum& frustum, uint* visible )
+{
+	const int n = (int)Scene::meshPool.size();
+	vector<aabb> bounds( n ); // local: CullMeshes may be called for several views in parallel
+	for (int i = 0; i < n; i++) bounds[i] = Scene::meshPool[i]->worldBounds;
+	return CullAABBs( frustum, bounds.data(), n, visible );
+}
+
+static void CullNode( const Frustum& frustum, const int nodeIdx, uint planeMask, vector<int>& visibleNodes )
+{
+	const Node* node = Scene::nodePool[nodeIdx];
+	// test the subtree; planes that it is fully inside of are not tested again below this node
+	if (planeMask) if (frustum.Classify( node->subtreeBounds, planeMask ) == CULL_OUTSIDE) return;
+	if (node->meshID > -1)
+	{
+		uint meshMask = planeMask;
+		if (!meshMask || frustum.Classify( Scene::meshPool[node->meshID]->worldBounds, meshMask ) != CULL_OUTSIDE)
+			visibleNodes.push_back( nodeIdx );
+	}
+	for (const int child : node->childIdx) CullNode( frustum, child, planeMask, visibleNodes );
+}
+
+void Tmpl8::CullSceneGraph( const Frustum& frustum, vector<int>& visibleNodes )
+{
+	visibleNodes.clear();
+	for (const int nodeIdx : Scene::rootNodes) CullNode( frustum, nodeIdx, frustum.AllPlanes(), visibleNodes );
+}
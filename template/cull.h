@@ -0,0 +1,63 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: view frustum culling. A Frustum is a set of up to eight
+// planes; it is typically extracted from a view-projection matrix. Objects
+// are tested in batches: CullAABBs and CullSpheres write one bit per object
+// to a visibility mask and test 4, 8 or 16 objects at once (SSE, AVX2,
+// AVX-512). For scenes, CullMeshes tests the world bounds of all meshes,
+// and CullSceneGraph walks the scene graph, skipping subtrees that are
+// completely outside and skipping plane tests for subtrees that are
+// completely inside. Typical use:
+//   Frustum frustum( projection * view );
+//   vector<uint> visible( (count + 31) / 32 );
+//   CullAABBs( frustum, boxes, count, visible.data() );
+//   for (int i = 0; i < count; i++) if (IsVisible( visible.data(), i )) ...
+// Tests are conservative: a box that is outside the frustum but crosses the
+// planes of two sides near a corner is reported as visible.
+
+#pragma once
+
+#define CULLMAXPLANES	8
+
+namespace Tmpl8
+{
+
+enum { CULL_OUTSIDE = 0, CULL_INTERSECTS, CULL_INSIDE };
+
+class Frustum
+{
+public:
+	Frustum() = default;
+	// planes from a view-projection matrix (M * p, as in TransformPosition). Use
+	// zeroToOneDepth for projections that map depth to [0..1] instead of [-1..1].
+	Frustum( const mat4& viewProjection, const bool zeroToOneDepth = false );
+	// custom planes (nx, ny, nz, d), with normals pointing inwards; planes are normalized
+	void SetPlanes( const float4* planes, const int count );
+	// single objects
+	bool Visible( const aabb& box ) const;
+	bool Visible( const float3& center, const float radius ) const;
+	// classify a box against the planes in planeMask; planes that the box is
+	// completely inside of are removed from the mask, so that the contents
+	// of the box can skip them
+	int Classify( const aabb& box, uint& planeMask ) const;
+	uint AllPlanes() const { return (1u << planeCount) - 1; }
+	// data members
+	float4 plane[CULLMAXPLANES];		// p is inside when dot( plane.xyz, p ) + plane.w >= 0 for all planes
+	int planeCount = 0;
+};
+
+// batch culling; 'visible' receives (n + 31) / 32 words, bit i is set when
+// object i intersects the frustum. Returns the number of visible objects.
+int CullAABBs( const Frustum& frustum, const aabb* boxes, const int n, uint* visible );
+int CullSpheres( const Frustum& frustum, const float4* spheres /* center, radius */, const int n, uint* visible );
+inline bool IsVisible( const uint* visible, const int i ) { return ((visible[i >> 5] >> (i & 31)) & 1) != 0; }
+
+// scene culling, based on Mesh::worldBounds and Node::subtreeBounds as
+// calculated by Scene::UpdateSceneGraph. CullMeshes uses mesh IDs as bit
+// indices; CullSceneGraph returns the IDs of visible nodes that have a mesh.
+int CullMeshes( const Frustum& frustum, uint* visible );
+void CullSceneGraph( const Frustum& frustum, vector<int>& visibleNodes );
+
+} // namespace Tmpl8
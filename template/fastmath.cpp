@@ -0,0 +1,118 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: the error and throughput harness for fastmath.h. Errors are
+// measured against the double precision C runtime, throughput is reported in
+// millions of values per second for the float C runtime, the scalar
+// approximation and the 4, 8 and 16-lane versions.
+
+#include "precomp.h"
+#include "fastmath.h"
+
+// inputs: uniform in [lo..hi], or log-uniform (for log, rsqrt etc.)
+struct FMRange { float lo, hi; bool logScale; };
+
+static void FillInputs( float* dst, const int n, const FMRange& r, PCG32& rng )
+{
+	for (int i = 0; i < n; i++)
+		dst[i] = r.logScale ? exp2f( rng.NextFloat( r.lo, r.hi ) ) : rng.NextFloat( r.lo, r.hi );
+}
+
+template <class T, class F> static float LaneThroughput( F f, const float* x, const float* y, float* out, const int n )
+{
+	Timer t;
+	for (int i = 0; i < n; i += T::lanes) T( f( T::LoadU( x + i ), T::LoadU( y + i ) ) ).StoreU( out + i );
+	return n / (t.elapsed() * 1e6f);
+}
+
+template <class T, class F> static float LaneError( F f, const float* x, const float* y, const double* ref, const int n, const bool relative )
+{
+	ALIGN( 64 ) float r[16];
+	float maxErr = 0;
+	for (int i = 0; i < n; i += T::lanes)
+	{
+		T( f( T::LoadU( x + i ), T::LoadU( y + i ) ) ).StoreU( r );
+		for (int j = 0; j < T::lanes; j++)
+		{
+			const double e = fabs( r[j] - ref[i + j] ) / (relative ? fmax( fabs( ref[i + j] ), 1e-30 ) : 1.0);
+			maxErr = max( maxErr, (float)e );
+		}
+	}
+	return maxErr;
+}
+
+// test one function; 'f' is a generic lambda, so it is instantiated for float and each lane type
+template <class F, class L, class D> static void Test( const char* name, F f, L libm, D exact,
+	const FMRange& rx, const FMRange& ry, const bool relative, const int n, float* x, float* y, float* out, double* ref )
+{
+	PCG32 rng( 1234 );
+	FillInputs( x, n, rx, rng ), FillInputs( y, n, ry, rng );
+	for (int i = 0; i < n; i++) ref[i] = exact( (double)x[i], (double)y[i] );
+	// errors: scalar and 4-lane; wider paths use the same polynomials
+	float err = 0;
+	for (int i = 0; i < n; i++)
+	{
+		const double e = fabs( f( x[i], y[i] ) - ref[i] ) / (relative ? fmax( fabs( ref[i] ), 1e-30 ) : 1.0);
+		err = max( err, (float)e );
+	}
+	err = max( err, LaneError<f32x4>( f, x, y, ref, n, relative ) );
+	// throughput
+	Timer t;
+	for (int i = 0; i < n; i++) out[i] = libm( x[i], y[i] );
+	const float tLibm = n / (t.elapsed() * 1e6f);
+	t.reset();
+	for (int i = 0; i < n; i++) out[i] = f( x[i], y[i] );
+	const float tScalar = n / (t.elapsed() * 1e6f);
+	const float tX4 = LaneThroughput<f32x4>( f, x, y, out, n );
+	float tX8 = 0, tX16 = 0;
+#ifdef SIMD_F32X8
+	if (CPUCaps::HW_AVX2 && CPUCaps::HW_FMA3) tX8 = LaneThroughput<f32x8>( f, x, y, out, n );
+#endif
+#ifdef SIMD_F32X16
+	if (CPUCaps::HW_AVX512F) tX16 = LaneThroughput<f32x16>( f, x, y, out, n );
+#endif
+	printf( "%-26s %s %9.2e %8.0f %8.0f %8.0f %8.0f %8.0f\n", name, relative ? "rel" : "abs", err, tLibm, tScalar, tX4, tX8, tX16 );
+}
+
+void FastMathBenchmark( const int count )
+{
+	const int n = (count + 15) & ~15;
+	float* x = (float*)MALLOC64( n * sizeof( float ) ), * y = (float*)MALLOC64( n * sizeof( float ) );
+	float* out = (float*)MALLOC64( n * sizeof( float ) );
+	double* ref = (double*)MALLOC64( n * sizeof( double ) );
+	const FMRange angle = { -8192, 8192, false }, unit = { 0, 1, false }, any = { -10, 10, false }, none = { 0, 0, false };
+	const FMRange positive = { -126, 127, true }, base = { -10, 3.3f, true }, exponent = { -4, 4, false };
+	printf( "function                   err    max    C (Mv/s)   scalar       x4       x8      x16\n" );
+#define TEST( name, expr, cexpr, dexpr, rx, ry, rel ) \
+	Test( name, []( auto x, auto y ) { (void)y; return expr; }, []( float x, float y ) { (void)y; return cexpr; }, \
+		[]( double x, double y ) { (void)y; return dexpr; }, rx, ry, rel, n, x, y, out, ref )
+	TEST( "FastSin", FastSin( x ), sinf( x ), sin( x ), angle, none, false );
+	TEST( "FastSin<FM_FAST>", FastSin<FM_FAST>( x ), sinf( x ), sin( x ), angle, none, false );
+	TEST( "FastCos", FastCos( x ), cosf( x ), cos( x ), angle, none, false );
+	TEST( "FastCos<FM_FAST>", FastCos<FM_FAST>( x ), cosf( x ), cos( x ), angle, none, false );
+	TEST( "FastExp2", FastExp2( x ), exp2f( x ), exp2( x ), (FMRange{ -126, 127, false }), none, true );
+	TEST( "FastExp2<FM_FAST>", FastExp2<FM_FAST>( x ), exp2f( x ), exp2( x ), (FMRange{ -126, 127, false }), none, true );
+	TEST( "FastExp", FastExp( x ), expf( x ), exp( x ), (FMRange{ -87, 88, false }), none, true );
+	TEST( "FastExp<FM_FAST>", FastExp<FM_FAST>( x ), expf( x ), exp( x ), (FMRange{ -87, 88, false }), none, true );
+	TEST( "FastLog", FastLog( x ), logf( x ), log( x ), positive, none, false );
+	TEST( "FastLog<FM_FAST>", FastLog<FM_FAST>( x ), logf( x ), log( x ), positive, none, false );
+	TEST( "FastPow", FastPow( x, y ), powf( x, y ), pow( x, y ), base, exponent, true );
+	TEST( "FastPow<FM_FAST>", FastPow<FM_FAST>( x, y ), powf( x, y ), pow( x, y ), base, exponent, true );
+	TEST( "FastRsqrt", FastRsqrt( x ), 1 / sqrtf( x ), 1 / sqrt( x ), positive, none, true );
+	TEST( "FastRsqrt<FM_FAST>", FastRsqrt<FM_FAST>( x ), 1 / sqrtf( x ), 1 / sqrt( x ), positive, none, true );
+	TEST( "FastRcp", FastRcp( x ), 1 / x, 1 / x, (FMRange{ -125, 125, true }), none, true );
+	TEST( "FastRcp<FM_FAST>", FastRcp<FM_FAST>( x ), 1 / x, 1 / x, (FMRange{ -125, 125, true }), none, true );
+	TEST( "FastAtan2", FastAtan2( y, x ), atan2f( y, x ), atan2( y, x ), any, any, false );
+	TEST( "FastAtan2<FM_FAST>", FastAtan2<FM_FAST>( y, x ), atan2f( y, x ), atan2( y, x ), any, any, false );
+	TEST( "FastSRGBToLinear", FastSRGBToLinear( x ), x <= 0.04045f ? x / 12.92f : powf( (x + 0.055f) / 1.055f, 2.4f ),
+		x <= 0.04045 ? x / 12.92 : pow( (x + 0.055) / 1.055, 2.4 ), unit, none, false );
+	TEST( "FastSRGBToLinear<FM_FAST>", FastSRGBToLinear<FM_FAST>( x ), x <= 0.04045f ? x / 12.92f : powf( (x + 0.055f) / 1.055f, 2.4f ),
+		x <= 0.04045 ? x / 12.92 : pow( (x + 0.055) / 1.055, 2.4 ), unit, none, false );
+	TEST( "FastLinearToSRGB", FastLinearToSRGB( x ), x <= 0.0031308f ? x * 12.92f : 1.055f * powf( x, 1 / 2.4f ) - 0.055f,
+		x <= 0.0031308 ? x * 12.92 : 1.055 * pow( x, 1 / 2.4 ) - 0.055, unit, none, false );
+	TEST( "FastLinearToSRGB<FM_FAST>", FastLinearToSRGB<FM_FAST>( x ), x <= 0.0031308f ? x * 12.92f : 1.055f * powf( x, 1 / 2.4f ) - 0.055f,
+		x <= 0.0031308 ? x * 12.92 : 1.055 * pow( x, 1 / 2.4 ) - 0.055, unit, none, false );
+#undef TEST
+	FREE64( x ), FREE64( y ), FREE64( out ), FREE64( ref );
+}
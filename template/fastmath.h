@@ -0,0 +1,188 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: polynomial approximations of common math functions, for hot
+// loops where sinf, expf, powf etc. dominate the cost. Every function is a
+// template that accepts a float or one of the lane types in tmpl8simd.h, so
+// the same code runs on 1, 4, 8 or 16 values:
+//   const float s = FastSin( a );
+//   const f32x8 c = FastCos( f32x8::LoadU( angles ) );
+// The first template argument selects the accuracy: FM_ACCURATE (default)
+// or FM_FAST, e.g. FastExp<FM_FAST>( x ). Maximum errors, measured over the
+// ranges listed, for FM_ACCURATE / FM_FAST:
+//   FastSin, FastCos, FastSinCos  |x| < 8192       abs 2.5e-7 / 9.5e-6
+//   FastExp2                      [-126..127]      rel 2.4e-7 / 7.5e-5
+//   FastExp                       [-87..88]        rel 4.0e-6 / 7.9e-5
+//   FastLog                       [2^-126..2^128)  abs 6.8e-6 / 1.6e-4
+//   FastLog2                      [2^-126..2^128)  abs 3.9e-6 / 2.2e-4
+//   FastPow                       x in [2^-10..10],
+//                                 y in [-4..4]     rel 3.0e-6 / 6.6e-4
+//   FastRsqrt, FastRcp            [2^-125..2^125]  rel 2.5e-7 / 3.3e-4
+//   FastAtan2                     [-10..10]^2      abs 4.2e-7 / 1.9e-4
+//   FastSRGBToLinear,
+//   FastLinearToSRGB              [0..1]           abs 3.7e-7 / 1.6e-4
+// These are the largest errors of an exhaustive sweep over every float in
+// range (FastPow and FastAtan2: a dense 2D sample), for the scalar version
+// without FMA and the 8-lane version with FMA. FastRsqrt and FastRcp refine
+// the estimate instructions of the CPU, so other CPUs may differ slightly.
+// The error of FastExp and FastLog is dominated by the float rounding of
+// x * log2( e ) and e * log( 2 ) for large arguments; near 0 it is smaller.
+// FastLog and FastPow expect positive, normalized inputs; FastExp clamps its
+// input to the normalized range. FastAtan2( -0, x < 0 ) returns +pi rather
+// than -pi. FastMathBenchmark() compares throughput against the C runtime and
+// reports errors for a random sample, which may stay below these maxima.
+
+#pragma once
+
+enum { FM_FAST = 0, FM_ACCURATE };
+
+// scalar counterparts of the lane type helpers, so the templates accept float
+inline float select( const bool m, const float a, const float b ) { return m ? a : b; }
+inline float madd( const float a, const float b, const float c ) { return a * b + c; }
+inline float rsqrtest( const float a ) { return _mm_cvtss_f32( _mm_rsqrt_ss( _mm_set_ss( a ) ) ); }
+inline float rcpest( const float a ) { return _mm_cvtss_f32( _mm_rcp_ss( _mm_set_ss( a ) ) ); }
+inline float pow2i( const float n ) { const int i = ((int)n + 127) << 23; float r; memcpy( &r, &i, 4 ); return r; } // 2^n, n integer
+inline float splitexp( const float x, float& e ) // returns mantissa in [1..2), e receives the exponent
+{
+	int i;
+	memcpy( &i, &x, 4 );
+	e = (float)((i >> 23) - 127), i = (i & 0x7fffff) | 0x3f800000;
+	float m;
+	memcpy( &m, &i, 4 );
+	return m;
+}
+
+// bit manipulation for the lane types
+inline f32x4 rsqrtest( const f32x4& a ) { return _mm_rsqrt_ps( a.v ); }
+inline f32x4 rcpest( const f32x4& a ) { return _mm_rcp_ps( a.v ); }
+inline f32x4 pow2i( const f32x4& n ) { return _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( _mm_cvttps_epi32( n.v ), _mm_set1_epi32( 127 ) ), 23 ) ); }
+inline f32x4 splitexp( const f32x4& x, f32x4& e )
+{
+	const __m128i i = _mm_castps_si128( x.v );
+	e = _mm_cvtepi32_ps( _mm_sub_epi32( _mm_srli_epi32( i, 23 ), _mm_set1_epi32( 127 ) ) );
+	return _mm_castsi128_ps( _mm_or_si128( _mm_and_si128( i, _mm_set1_epi32( 0x7fffff ) ), _mm_set1_epi32( 0x3f800000 ) ) );
+}
+#ifdef SIMD_F32X8
+inline f32x8 rsqrtest( const f32x8& a ) { return _mm256_rsqrt_ps( a.v ); }
+inline f32x8 rcpest( const f32x8& a ) { return _mm256_rcp_ps( a.v ); }
+inline f32x8 pow2i( const f32x8& n ) { return _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_add_epi32( _mm256_cvttps_epi32( n.v ), _mm256_set1_epi32( 127 ) ), 23 ) ); }
+inline f32x8 splitexp( const f32x8& x, f32x8& e )
+{
+	const __m256i i = _mm256_castps_si256( x.v );
+	e = _mm256_cvtepi32_ps( _mm256_sub_epi32( _mm256_srli_epi32( i, 23 ), _mm256_set1_epi32( 127 ) ) );
+	return _mm256_castsi256_ps( _mm256_or_si256( _mm256_and_si256( i, _mm256_set1_epi32( 0x7fffff ) ), _mm256_set1_epi32( 0x3f800000 ) ) );
+}
+#endif
+#ifdef SIMD_F32X16
+// rsqrt14 / rcp14 are more precise than their SSE / AVX counterparts, which
+// is why FM_FAST is more accurate on AVX-512 for these two
+inline f32x16 rsqrtest( const f32x16& a ) { return _mm512_rsqrt14_ps( a.v ); }
+inline f32x16 rcpest( const f32x16& a ) { return _mm512_rcp14_ps( a.v ); }
+inline f32x16 pow2i( const f32x16& n ) { return _mm512_castsi512_ps( _mm512_slli_epi32( _mm512_add_epi32( _mm512_cvttps_epi32( n.v ), _mm512_set1_epi32( 127 ) ), 23 ) ); }
+inline f32x16 splitexp( const f32x16& x, f32x16& e )
+{
+	const __m512i i = _mm512_castps_si512( x.v );
+	e = _mm512_cvtepi32_ps( _mm512_sub_epi32( _mm512_srli_epi32( i, 23 ), _mm512_set1_epi32( 127 ) ) );
+	return _mm512_castsi512_ps( _mm512_or_si512( _mm512_and_si512( i, _mm512_set1_epi32( 0x7fffff ) ), _mm512_set1_epi32( 0x3f800000 ) ) );
+}
+#endif
+
+// sine and cosine: x = r + k * pi with |r| <= pi / 2, so sin( x ) = +/-sin( r )
+template <int A = FM_ACCURATE, class T> inline void FastSinCos( const T& x, T& s, T& c )
+{
+	const T k = floorf( madd( x, T( 0.318309886f ), T( 0.5f ) ) );
+	// subtract k * pi in two steps; 3.140625 has few mantissa bits, so k * 3.140625 is exact
+	const T r = madd( k, T( -9.67653589793e-4f ), madd( k, T( -3.140625f ), x ) ), r2 = r * r;
+	T ps, pc;
+	if constexpr (A == FM_ACCURATE)
+	{
+		ps = madd( madd( madd( madd( madd( T( -2.3889859e-8f ), r2, T( 2.7525562e-6f ) ), r2, T( -1.9840874e-4f ) ), r2, T( 8.3333310e-3f ) ), r2, T( -0.16666667f ) ), r2, T( 1 ) );
+		pc = madd( madd( madd( madd( madd( T( -2.6051615e-7f ), r2, T( 2.4760495e-5f ) ), r2, T( -1.3888378e-3f ) ), r2, T( 4.1666638e-2f ) ), r2, T( -0.5f ) ), r2, T( 1 ) );
+	}
+	else
+	{
+		ps = madd( madd( madd( T( -1.8524670e-4f ), r2, T( 8.3139502e-3f ) ), r2, T( -0.16665852f ) ), r2, T( 1 ) );
+		pc = madd( madd( madd( T( -1.2712436e-3f ), r2, T( 4.1493919e-2f ) ), r2, T( -0.49992746f ) ), r2, T( 1 ) );
+	}
+	// odd k flips the sign of both
+	const T h = k * T( 0.5f ), sign = select( h != floorf( h ), T( -1 ), T( 1 ) );
+	s = ps * r * sign, c = pc * sign;
+}
+template <int A = FM_ACCURATE, class T> inline T FastSin( const T& x ) { T s, c; FastSinCos<A>( x, s, c ); return s; }
+template <int A = FM_ACCURATE, class T> inline T FastCos( const T& x ) { T s, c; FastSinCos<A>( x, s, c ); return c; }
+
+// exponentials: 2^x = 2^n * 2^f, with n = round( x ) and f in [-0.5..0.5]
+template <int A = FM_ACCURATE, class T> inline T FastExp2( const T& x )
+{
+	const T t = clamp( x, T( -126 ), T( 127 ) ), n = floorf( t + T( 0.5f ) ), f = t - n;
+	T p;
+	if constexpr (A == FM_ACCURATE)
+		p = madd( madd( madd( madd( madd( T( 1.3276462e-3f ), f, T( 9.6755425e-3f ) ), f, T( 5.5507133e-2f ) ), f, T( 0.24022120f ) ), f, T( 0.69314697f ) ), f, T( 1.0000001f ) );
+	else
+		p = madd( madd( madd( T( 5.5171579e-2f ), f, T( 0.24261119f ) ), f, T( 0.69326101f ) ), f, T( 0.99992807f ) );
+	return p * pow2i( n );
+}
+template <int A = FM_ACCURATE, class T> inline T FastExp( const T& x ) { return FastExp2<A>( x * T( 1.44269504f ) ); }
+
+// logarithms: x = 2^e * m, with m in [sqrt( 1 / 2 )..sqrt( 2 )], log( 1 + y ) = y * P( y )
+template <int A = FM_ACCURATE, class T> inline T FastLog2( const T& x )
+{
+	T e, m = splitexp( x, e );
+	const auto big = m > T( 1.41421356f );
+	m = select( big, m * T( 0.5f ), m ), e = select( big, e + T( 1 ), e );
+	const T y = m - T( 1 );
+	T p;
+	if constexpr (A == FM_ACCURATE)
+		p = madd( madd( madd( madd( madd( madd( madd( madd( T( 8.9597128e-2f ), y, T( -0.14482128f ) ), y, T( 0.14917423f ) ), y,
+			T( -0.16543749f ) ), y, T( 0.19958414f ) ), y, T( -0.25002946f ) ), y, T( 0.33334161f ) ), y, T( -0.49999978f ) ), y, T( 0.99999998f ) );
+	else
+		p = madd( madd( madd( T( -0.23268126f ), y, T( 0.35540081f ) ), y, T( -0.50159254f ) ), y, T( 0.99967488f ) );
+	return madd( y * p, T( 1.44269504f ), e );
+}
+template <int A = FM_ACCURATE, class T> inline T FastLog( const T& x ) { return FastLog2<A>( x ) * T( 0.693147181f ); }
+template <int A = FM_ACCURATE, class T> inline T FastPow( const T& x, const T& y ) { return FastExp2<A>( y * FastLog2<A>( x ) ); }
+
+// reciprocal (square root): hardware estimate, refined with a Newton-Raphson step
+template <int A = FM_ACCURATE, class T> inline T FastRsqrt( const T& x )
+{
+	const T y = rsqrtest( x );
+	if constexpr (A == FM_FAST) return y; else return y * madd( T( -0.5f ) * x, y * y, T( 1.5f ) );
+}
+template <int A = FM_ACCURATE, class T> inline T FastRcp( const T& x )
+{
+	const T y = rcpest( x );
+	if constexpr (A == FM_FAST) return y; else return y * madd( -x, y, T( 2 ) );
+}
+
+// atan2: atan( a ) for a = min / max in [0..1], then mirrored to the correct octant
+template <int A = FM_ACCURATE, class T> inline T FastAtan2( const T& y, const T& x )
+{
+	const T ax = fabs( x ), ay = fabs( y ), mx = fmaxf( ax, ay );
+	const T a = fminf( ax, ay ) / select( mx == T( 0 ), T( 1 ), mx ), t = a * a;
+	T p;
+	if constexpr (A == FM_ACCURATE)
+		p = madd( madd( madd( madd( madd( madd( madd( T( -4.7804442e-3f ), t, T( 2.4557124e-2f ) ), t, T( -5.9904778e-2f ) ), t,
+			T( 9.9427687e-2f ) ), t, T( -0.14029426f ) ), t, T( 0.19971377f ) ), t, T( -0.33332094f ) ), t, T( 0.99999991f ) );
+	else
+		p = madd( madd( madd( T( -4.5054403e-2f ), t, T( 0.15666958f ) ), t, T( -0.32621695f ) ), t, T( 0.99981049f ) );
+	T r = a * p;
+	r = select( ay > ax, T( 1.57079633f ) - r, r );
+	r = select( x < T( 0 ), T( 3.14159265f ) - r, r );
+	return select( y < T( 0 ), -r, r );
+}
+
+// sRGB transfer functions, see IEC 61966-2-1
+template <int A = FM_ACCURATE, class T> inline T FastSRGBToLinear( const T& c )
+{
+	const T p = FastPow<A>( madd( c, T( 1 / 1.055f ), T( 0.055f / 1.055f ) ), T( 2.4f ) );
+	return select( c <= T( 0.04045f ), c * T( 1 / 12.92f ), p );
+}
+template <int A = FM_ACCURATE, class T> inline T FastLinearToSRGB( const T& c )
+{
+	const T p = madd( FastPow<A>( c, T( 1 / 2.4f ) ), T( 1.055f ), T( -0.055f ) );
+	return select( c <= T( 0.0031308f ), c * T( 12.92f ), p );
+}
+
+// error and throughput of the above, compared to the C runtime; prints a table
+void FastMathBenchmark( const int n = 1 << 20 );
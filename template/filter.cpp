@@ -0,0 +1,302 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the post-processing filters defined in
+// filter.h. Internally, all filters operate on float4 pixels: one __m128 per
+// pixel, so the four channels are always processed together. Temporary images
+// are allocated per call, so filters may run concurrently on different surfaces.
+
+#include "precomp.h"
+
+using namespace Tmpl8;
+
+// conversion between 32-bit pixels and float4, without scaling (0..255)
+static void Unpack( const uint* src, float4* dst, const int count )
+{
+#pragma omp parallel for schedule( static )
+	for (int i = 0; i < count; i++)
+	{
+		const __m128i c4 = _mm_cvtepu8_epi32( _mm_cvtsi32_si128( (int)src[i] ) );
+		_mm_store_ps( &dst[i].x, _mm_cvtepi32_ps( c4 ) );
+	}
+}
+static void Pack( const float4* src, uint* dst, const int count )
+{
+#pragma omp parallel for schedule( static )
+	for (int i = 0; i < count; i++)
+	{
+		const __m128i c4 = _mm_cvtps_epi32( _mm_load_ps( &src[i].x ) );
+		const __m128i c8 = _mm_packus_epi32( c4, c4 );
+		dst[i] = (uint)_mm_cvtsi128_si32( _mm_packus_epi16( c8, c8 ) );
+	}
+}
+
+// horizontal running-sum box filter, in-place
+static void BoxBlurH( float4* pixels, const int w, const int h, const int r )
+{
+	const __m128 scale4 = _mm_set1_ps( 1.0f / (float)(2 * r + 1) );
+#pragma omp parallel
+	{
+		__m128* line = (__m128*)MALLOC64( w * sizeof( __m128 ) );
+	#pragma omp for schedule( static )
+		for (int y = 0; y < h; y++)
+		{
+			__m128* row = (__m128*)(pixels + y * w);
+			memcpy( line, row, w * sizeof( __m128 ) );
+			// initial window; pixels outside the image are clamped to the edge
+			__m128 sum = _mm_setzero_ps();
+			for (int i = -r; i <= r; i++) sum = _mm_add_ps( sum, line[clamp( i, 0, w - 1 )] );
+			for (int x = 0; x < w; x++)
+			{
+				row[x] = _mm_mul_ps( sum, scale4 );
+				const __m128 in = line[min( x + r + 1, w - 1 )], out = line[max( x - r, 0 )];
+				sum = _mm_add_ps( sum, _mm_sub_ps( in, out ) );
+			}
+		}
+		FREE64( line );
+	}
+}
+
+// vertical running-sum box filter. Columns are processed in strips of 64
+// pixels, so each step of the running sum reads a contiguous row segment.
+static void BoxBlurV( const float4* src, float4* dst, const int w, const int h, const int r )
+{
+	const __m128 scale4 = _mm_set1_ps( 1.0f / (float)(2 * r + 1) );
+	const int strips = (w + 63) / 64;
+#pragma omp parallel for schedule( dynamic )
+	for (int s = 0; s < strips; s++)
+	{
+		const int x0 = s * 64, n = min( w - x0, 64 );
+		__m128 sum[64];
+		for (int x = 0; x < n; x++) sum[x] = _mm_setzero_ps();
+		for (int i = -r; i <= r; i++)
+		{
+			const __m128* row = (const __m128*)(src + clamp( i, 0, h - 1 ) * w + x0);
+			for (int x = 0; x < n; x++) sum[x] = _mm_add_ps( sum[x], row[x] );
+		}
+		for (int y = 0; y < h; y++)
+		{
+			__m128* out = (__m128*)(dst + y * w + x0);
+			const __m128* in = (const __m128*)(src + min( y + r + 1, h - 1 ) * w + x0);
+			const __m128* old = (const __m128*)(src + max( y - r, 0 ) * w + x0);
+			for (int x = 0; x < n; x++)
+			{
+				out[x] = _mm_mul_ps( sum[x], scale4 );
+				sum[x] = _mm_add_ps( sum[x], _mm_sub_ps( in[x], old[x] ) );
+			}
+		}
+	}
+}
+
+// box blur on float4 data; src and dst may be the same buffer
+static void BoxBlur( const float4* src, float4* dst, const int w, const int h, const int radius, const int passes )
+{
+	if (radius < 1 || passes < 1)
+	{
+		if (src != dst) memcpy( dst, src, w * h * sizeof( float4 ) );
+		return;
+	}
+	float4* tmp = (float4*)MALLOC64( w * h * sizeof( float4 ) );
+	for (int i = 0; i < passes; i++)
+	{
+		memcpy( tmp, i == 0 ? src : dst, w * h * sizeof( float4 ) );
+		BoxBlurH( tmp, w, h, radius );
+		BoxBlurV( tmp, dst, w, h, radius );
+	}
+	FREE64( tmp );
+}
+
+// gaussian blur on float4 data; src and dst may be the same buffer
+static void GaussianBlur( const float4* src, float4* dst, const int w, const int h, const float sigma )
+{
+	const int r = min( 63, (int)ceilf( sigma * 3 ) );
+	if (r < 1)
+	{
+		if (src != dst) memcpy( dst, src, w * h * sizeof( float4 ) );
+		return;
+	}
+	// normalized kernel weights; only one half is stored
+	__m128 weight[64];
+	float wsum = 0, wf[64];
+	for (int i = 0; i <= r; i++) wf[i] = expf( -(float)(i * i) / (2 * sigma * sigma) ), wsum += i ? 2 * wf[i] : wf[i];
+	for (int i = 0; i <= r; i++) weight[i] = _mm_set1_ps( wf[i] / wsum );
+	// horizontal pass: src to a temporary image, via a padded line buffer
+	float4* tmp = (float4*)MALLOC64( w * h * sizeof( float4 ) );
+#pragma omp parallel
+	{
+		__m128* line = (__m128*)MALLOC64( (w + 2 * r) * sizeof( __m128 ) );
+	#pragma omp for schedule( static )
+		for (int y = 0; y < h; y++)
+		{
+			const __m128* row = (const __m128*)(src + y * w);
+			for (int x = -r; x < w + r; x++) line[x + r] = row[clamp( x, 0, w - 1 )];
+			__m128* out = (__m128*)(tmp + y * w);
+			for (int x = 0; x < w; x++)
+			{
+				const __m128* c = line + x + r;
+				__m128 sum = _mm_mul_ps( c[0], weight[0] );
+				for (int i = 1; i <= r; i++) sum = _mm_add_ps( sum, _mm_mul_ps( _mm_add_ps( c[-i], c[i] ), weight[i] ) );
+				out[x] = sum;
+			}
+		}
+		FREE64( line );
+	}
+	// vertical pass: temporary image to dst, one output row at a time
+#pragma omp parallel for schedule( static )
+	for (int y = 0; y < h; y++)
+	{
+		__m128* out = (__m128*)(dst + y * w);
+		const __m128* row = (const __m128*)(tmp + y * w);
+		for (int x = 0; x < w; x++) out[x] = _mm_mul_ps( row[x], weight[0] );
+		for (int i = 1; i <= r; i++)
+		{
+			const __m128* above = (const __m128*)(tmp + max( y - i, 0 ) * w);
+			const __m128* below = (const __m128*)(tmp + min( y + i, h - 1 ) * w);
+			for (int x = 0; x < w; x++) out[x] = _mm_add_ps( out[x], _mm_mul_ps( _mm_add_ps( above[x], below[x] ), weight[i] ) );
+		}
+	}
+	FREE64( tmp );
+}
+
+// public interface: blurs
+void Tmpl8::BoxBlur( const Surface* src, Surface* dst, const int radius, const int passes )
+{
+	FATALERROR_IF( src->width != dst->width || src->height != dst->height, "BoxBlur: surface size mismatch." );
+	const int w = src->width, h = src->height;
+	float4* buffer = (float4*)MALLOC64( w * h * sizeof( float4 ) );
+	Unpack( src->pixels, buffer, w * h );
+	::BoxBlur( buffer, buffer, w, h, radius, passes );
+	Pack( buffer, dst->pixels, w * h );
+	FREE64( buffer );
+}
+void Tmpl8::BoxBlur( const FloatSurface* src, FloatSurface* dst, const int radius, const int passes )
+{
+	FATALERROR_IF( src->width != dst->width || src->height != dst->height, "BoxBlur: surface size mismatch." );
+	::BoxBlur( src->pixels, dst->pixels, src->width, src->height, radius, passes );
+}
+void Tmpl8::GaussianBlur( const Surface* src, Surface* dst, const float sigma )
+{
+	FATALERROR_IF( src->width != dst->width || src->height != dst->height, "GaussianBlur: surface size mismatch." );
+	const int w = src->width, h = src->height;
+	float4* buffer = (float4*)MALLOC64( w * h * sizeof( float4 ) );
+	Unpack( src->pixels, buffer, w * h );
+	::GaussianBlur( buffer, buffer, w, h, sigma );
+	Pack( buffer, dst->pixels, w * h );
+	FREE64( buffer );
+}
+void Tmpl8::GaussianBlur( const FloatSurface* src, FloatSurface* dst, const float sigma )
+{
+	FATALERROR_IF( src->width != dst->width || src->height != dst->height, "GaussianBlur: surface size mismatch." );
+	::GaussianBlur( src->pixels, dst->pixels, src->width, src->height, sigma );
+}
+
+// public interface: bright pass and resampling
+void Tmpl8::Threshold( const FloatSurface* src, FloatSurface* dst, const float threshold )
+{
+	const __m128 t4 = _mm_set1_ps( threshold ), zero4 = _mm_setzero_ps();
+	const __m128 rgbMask = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) ); // alpha is cleared
+	const int s = min( src->width * src->height, dst->width * dst->height );
+#pragma omp parallel for schedule( static )
+	for (int i = 0; i < s; i++)
+	{
+		const __m128 c = _mm_max_ps( _mm_sub_ps( _mm_load_ps( &src->pixels[i].x ), t4 ), zero4 );
+		_mm_store_ps( &dst->pixels[i].x, _mm_and_ps( c, rgbMask ) );
+	}
+}
+void Tmpl8::Downsample( const FloatSurface* src, FloatSurface* dst )
+{
+	const int w = min( dst->width, src->width / 2 ), h = min( dst->height, src->height / 2 );
+	const __m128 quarter4 = _mm_set1_ps( 0.25f );
+#pragma omp parallel for schedule( static )
+	for (int y = 0; y < h; y++)
+	{
+		const __m128* row0 = (const __m128*)(src->pixels + y * 2 * src->width);
+		const __m128* row1 = row0 + src->width;
+		__m128* out = (__m128*)(dst->pixels + y * dst->width);
+		for (int x = 0; x < w; x++)
+		{
+			const __m128 a = _mm_add_ps( row0[x * 2], row0[x * 2 + 1] );
+			const __m128 b = _mm_add_ps( row1[x * 2], row1[x * 2 + 1] );
+			out[x] = _mm_mul_ps( _mm_add_ps( a, b ), quarter4 );
+		}
+	}
+}
+void Tmpl8::UpsampleAdd( const FloatSurface* src, FloatSurface* dst, const float scale )
+{
+	const int sw = src->width, sh = src->height, dw = dst->width, dh = dst->height;
+	// horizontal source positions and weights are the same for every row
+	vector<int> x0( dw ), x1( dw );
+	vector<float> fx( dw );
+	const float ratioX = (float)sw / (float)dw, ratioY = (float)sh / (float)dh;
+	for (int x = 0; x < dw; x++)
+	{
+		const float u = max( 0.0f, (x + 0.5f) * ratioX - 0.5f );
+		x0[x] = min( (int)u, sw - 1 ), x1[x] = min( x0[x] + 1, sw - 1 ), fx[x] = u - (float)(int)u;
+	}
+	const __m128 scale4 = _mm_set1_ps( scale );
+#pragma omp parallel for schedule( static )
+	for (int y = 0; y < dh; y++)
+	{
+		const float v = max( 0.0f, (y + 0.5f) * ratioY - 0.5f );
+		const int y0 = min( (int)v, sh - 1 ), y1 = min( y0 + 1, sh - 1 );
+		const __m128 fy1 = _mm_set1_ps( v - (float)(int)v ), fy0 = _mm_sub_ps( _mm_set1_ps( 1 ), fy1 );
+		const __m128* row0 = (const __m128*)(src->pixels + y0 * sw);
+		const __m128* row1 = (const __m128*)(src->pixels + y1 * sw);
+		__m128* out = (__m128*)(dst->pixels + y * dw);
+		for (int x = 0; x < dw; x++)
+		{
+			const __m128 fx1 = _mm_set1_ps( fx[x] ), fx0 = _mm_sub_ps( _mm_set1_ps( 1 ), fx1 );
+			const __m128 top = _mm_add_ps( _mm_mul_ps( row0[x0[x]], fx0 ), _mm_mul_ps( row0[x1[x]], fx1 ) );
+			const __m128 bottom = _mm_add_ps( _mm_mul_ps( row1[x0[x]], fx0 ), _mm_mul_ps( row1[x1[x]], fx1 ) );
+			const __m128 c = _mm_add_ps( _mm_mul_ps( top, fy0 ), _mm_mul_ps( bottom, fy1 ) );
+			out[x] = _mm_add_ps( out[x], _mm_mul_ps( c, scale4 ) );
+		}
+	}
+}
+
+// Bloom class implementation
+Bloom::Bloom( const int width, const int height, const int levels )
+{
+	int w = width / 2, h = height / 2;
+	while (levelCount < min( levels, 16 ) && w >= 8 && h >= 8)
+	{
+		level[levelCount++] = new FloatSurface( w, h );
+		w /= 2, h /= 2;
+	}
+	full = new FloatSurface( width, height );
+}
+
+Bloom::~Bloom()
+{
+	for (int i = 0; i < levelCount; i++) delete level[i];
+	delete full;
+}
+
+void Bloom::Apply( Surface* target )
+{
+	FATALERROR_IF( target->width != full->width || target->height != full->height, "Bloom: target size mismatch." );
+	full->CopyFrom( target );
+	ApplyChain( full );
+	full->CopyTo( target );
+}
+
+void Bloom::Apply( FloatSurface* target )
+{
+	FATALERROR_IF( target->width != full->width || target->height != full->height, "Bloom: target size mismatch." );
+	ApplyChain( target );
+}
+
+void Bloom::ApplyChain( FloatSurface* target )
+{
+	if (levelCount == 0) return;
+	// bright pass at half resolution
+	Downsample( target, level[0] );
+	Threshold( level[0], level[0], threshold );
+	// downsample and blur; the blur gets wider in screen space at each level
+	for (int i = 1; i < levelCount; i++) Downsample( level[i - 1], level[i] );
+	for (int i = 0; i < levelCount; i++) GaussianBlur( level[i], level[i], sigma );
+	// combine, from the smallest level up
+	for (int i = levelCount - 1; i > 0; i--) UpsampleAdd( level[i], level[i - 1] );
+	UpsampleAdd( level[0], target, intensity );
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: post-processing filters for Surface and FloatSurface.
+// All filters are separable and run in two passes (horizontal, vertical),
+// using SSE for the four color channels of a pixel and OpenMP to spread
+// rows / columns over the available cores. The cost of these filters is
+// fixed per pixel: it does not depend on the number of lights or sprites
+// that produced the image.
+
+#pragma once
+
+namespace Tmpl8
+{
+
+// box blur: a running sum is used, so the cost per pixel does not depend
+// on the radius. Three passes closely approximate a gaussian blur.
+// Source and destination may be the same surface.
+void BoxBlur( const Surface* src, Surface* dst, const int radius, const int passes = 1 );
+void BoxBlur( const FloatSurface* src, FloatSurface* dst, const int radius, const int passes = 1 );
+
+// gaussian blur: separable convolution with a kernel of radius 3 * sigma.
+// Use BoxBlur with 3 passes for very large sigma.
+void GaussianBlur( const Surface* src, Surface* dst, const float sigma );
+void GaussianBlur( const FloatSurface* src, FloatSurface* dst, const float sigma );
+
+// bright pass: keep only the part of each channel that exceeds the threshold.
+void Threshold( const FloatSurface* src, FloatSurface* dst, const float threshold );
+
+// resampling: Downsample halves the resolution using a 2x2 box filter;
+// UpsampleAdd adds a bilinearly upscaled copy of src to dst, scaled by 'scale'.
+void Downsample( const FloatSurface* src, FloatSurface* dst );
+void UpsampleAdd( const FloatSurface* src, FloatSurface* dst, const float scale = 1.0f );
+
+// bloom: threshold, followed by a downsample-blur-upsample chain, added to the
+// original image. Buffers for the chain are allocated once, in the constructor.
+class Bloom
+{
+public:
+	// constructor / destructor
+	Bloom( const int width, const int height, const int levels = 5 );
+	~Bloom();
+	// methods
+	void Apply( Surface* target );
+	void Apply( FloatSurface* target );
+	// settings
+	float threshold = 0.7f;				// channel values below this do not bloom
+	float intensity = 0.6f;				// strength of the bloom added to the target
+	float sigma = 2.0f;					// blur width per level, in pixels of that level
+private:
+	void ApplyChain( FloatSurface* target );
+	// data members
+	int levelCount = 0;
+	FloatSurface* level[16] = {};		// downsampled chain; level 0 is half resolution
+	FloatSurface* full = 0;				// full resolution scratch buffer for 32-bit targets
+};
+
+} // namespace Tmpl8
\ No newline at end of file
@@ -0,0 +1,234 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the background loader defined in loader.h.
+
+#include "precomp.h"
+#include "tiny_bvh.h"
+using namespace tinybvh;
+#include "scene.h"
+#include "loader.h"
+
+// split a path in a directory and a file name, as Scene::AddScene does
+static void SplitPath( const char* path, string& dir, string& name )
+{
+	const string p( path );
+	const size_t slash = p.find_last_of( "/\\" );
+	dir = slash == string::npos ? "." : p.substr( 0, slash );
+	name = slash == string::npos ? p : p.substr( slash + 1 );
+}
+
+// ImageHandle: decode on the worker thread; nothing to publish
+void ImageHandle::Main()
+{
+	if (!FileExists( file.c_str() )) { error = "File not found: " + file; return; }
+	surface = new Surface( file.c_str() );
+	if (surface->pixels) return;
+	error = "could not decode " + file;
+	delete surface;
+	surface = 0;
+}
+
+void ImageHandle::Discard()
+{
+	delete surface;
+	surface = 0;
+}
+
+// MeshHandle: parse on the worker, build the mesh and its materials on the main thread
+MeshHandle::~MeshHandle()
+{
+	delete data;
+}
+
+void MeshHandle::Main()
+{
+	data = new OBJData();
+	Mesh::ParseOBJ( objFile, dir.c_str(), *data, error );
+}
+
+void MeshHandle::Publish()
+{
+	meshId = Scene::AddMesh( *data, name.c_str(), dir.c_str(), scale, flatShaded );
+	delete data;
+	data = 0;
+}
+
+// SceneHandle: parse on the worker, including texture decoding; convert on the main thread
+SceneHandle::~SceneHandle()
+{
+	delete model;
+}
+
+void SceneHandle::Main()
+{
+	model = new tinygltf::Model();
+	Scene::LoadGLTF( name.c_str(), dir.c_str(), *model, error );
+}
+
+void SceneHandle::Publish()
+{
+	nodeId = Scene::AddScene( *model, name.c_str(), dir.c_str(), transform );
+	delete model;
+	model = 0;
+}
+
+// AsyncLoader: constructor / destructor
+AsyncLoader::AsyncLoader( const int threadCount )
+{
+	int n = threadCount;
+	if (n < 1) n = max( 1, (int)thread::hardware_concurrency() - 1 ); // leave a core for the main thread
+	for (int i = 0; i < n; i++) workers.push_back( thread( &AsyncLoader::Worker, this ) );
+}
+
+AsyncLoader::~AsyncLoader()
+{
+	{
+		lock_guard<mutex> lock( queueMutex );
+		quit = true;
+	}
+	queueSignal.notify_all();
+	for (thread& t : workers) t.join();
+	for (AssetHandle* handle : pending) if (handle->released) handle->Discard(), delete handle;
+	for (AssetHandle* handle : handles) delete handle;
+}
+
+// worker thread: execute jobs until the loader is destroyed
+void AsyncLoader::Worker()
+{
+	while (1)
+	{
+		AssetHandle* handle = 0;
+		{
+			unique_lock<mutex> lock( queueMutex );
+			queueSignal.wait( lock, [this] { return quit || !queue.empty(); } );
+			if (quit) return;
+			handle = queue.front();
+			queue.pop_front();
+		}
+		handle->state.store( LOAD_BUSY, memory_order_release );
+		handle->Main();
+		// the state is the last thing a worker touches; after that the main thread owns the handle.
+		// Errors are not reported here: FatalError must run on the main thread (see Update).
+		if (handle->needsPublish && handle->error.empty()) handle->state.store( LOAD_PARSED, memory_order_release ); else
+		{
+			completed.fetch_add( 1, memory_order_release );
+			handle->state.store( handle->error.empty() ? LOAD_READY : LOAD_FAILED, memory_order_release );
+		}
+	}
+}
+
+// submit a new job
+void AsyncLoader::Submit( AssetHandle* handle )
+{
+	handles.push_back( handle );
+	pending.push_back( handle );
+	submitted++;
+	{
+		lock_guard<mutex> lock( queueMutex );
+		queue.push_back( handle );
+	}
+	queueSignal.notify_one();
+}
+
+ImageHandle* AsyncLoader::LoadSurface( const char* file )
+{
+	ImageHandle* handle = new ImageHandle();
+	handle->file = file;
+	Submit( handle );
+	return handle;
+}
+
+MeshHandle* AsyncLoader::LoadMesh( const char* objFile, const float scale, const bool flatShaded )
+{
+	MeshHandle* handle = new MeshHandle();
+	handle->file = objFile;
+	SplitPath( objFile, handle->dir, handle->name );
+	handle->objFile = Mesh::OBJFileName( handle->name.c_str(), handle->dir.c_str() ); // checks the extension
+	handle->scale = scale, handle->flatShaded = flatShaded;
+	Submit( handle );
+	return handle;
+}
+
+SceneHandle* AsyncLoader::LoadScene( const char* sceneFile, const mat4& transform )
+{
+	SceneHandle* handle = new SceneHandle();
+	handle->file = sceneFile;
+	SplitPath( sceneFile, handle->dir, handle->name );
+	handle->transform = transform;
+	Submit( handle );
+	return handle;
+}
+
+// publish parsed meshes and scenes and report failed loads; call once per
+// frame on the main thread. maxPublish limits the number of assets added to
+// the scene per call, so a batch of large scenes does not produce a single
+// very long frame. Released handles are deleted here once their worker is done.
+void AsyncLoader::Update( const int maxPublish )
+{
+	int published = 0;
+	for (size_t i = 0; i < pending.size(); )
+	{
+		AssetHandle* handle = pending[i];
+		const int state = handle->state.load( memory_order_acquire );
+		if (state == LOAD_FAILED && !handle->released) FatalError( "AsyncLoader: %s", handle->error.c_str() );
+		if (state == LOAD_PARSED && !handle->released)
+		{
+			if (published == maxPublish) { i++; continue; }
+			handle->Publish();
+			handle->state.store( LOAD_READY, memory_order_release );
+			completed.fetch_add( 1, memory_order_release );
+			published++;
+		}
+		else if (state == LOAD_PARSED) completed.fetch_add( 1, memory_order_release ); // released; never published
+		else if (state != LOAD_READY && state != LOAD_FAILED) { i++; continue; }
+		if (handle->released) handle->Discard(), delete handle;
+		pending.erase( pending.begin() + i );
+	}
+}
+
+// free a handle, including a result that is still attached to it: to keep a
+// loaded surface, take it first (set ImageHandle::surface to 0). Loads that are
+// still in flight are cancelled (queued) or discarded when their worker is done.
+void AsyncLoader::Release( AssetHandle* handle )
+{
+	const auto h = find( handles.begin(), handles.end(), handle );
+	FATALERROR_IF( h == handles.end(), "AsyncLoader: release of an unknown handle" );
+	handles.erase( h );
+	bool dequeued = false;
+	{
+		lock_guard<mutex> lock( queueMutex );
+		const auto q = find( queue.begin(), queue.end(), handle );
+		if (q != queue.end()) queue.erase( q ), dequeued = true;
+	}
+	const auto p = find( pending.begin(), pending.end(), handle );
+	const int state = handle->state.load( memory_order_acquire );
+	if (dequeued) submitted--;
+	else if (state != LOAD_READY && state != LOAD_FAILED)
+	{
+		// a worker is busy with it, or it still needs Publish; Update deletes it later
+		handle->released = true;
+		return;
+	}
+	if (p != pending.end()) pending.erase( p );
+	handle->Discard();
+	delete handle;
+}
+
+// block until all submitted assets are ready, or reported as failed
+void AsyncLoader::Flush()
+{
+	while (true)
+	{
+		Update( INT_MAX );
+		if (pending.empty()) break;
+		this_thread::sleep_for( chrono::milliseconds( 1 ) );
+	}
+}
+
+// fraction of submitted assets that is ready
+float AsyncLoader::Progress() const
+{
+	return submitted == 0 ? 1.0f : (float)completed.load( memory_order_acquire ) / (float)submitted;
+}
\ No newline at end of file
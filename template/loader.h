@@ -0,0 +1,135 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: a background loader for images, meshes and glTF scenes.
+// Files are decoded and parsed on worker threads; the returned handle
+// becomes 'Ready' once the asset can be used. Meshes and scenes must be
+// added to the (static) Scene on the main thread: AsyncLoader::Update takes
+// care of this and should be called once per frame, e.g. at the start of
+// Game::Tick. Typical use:
+//   AsyncLoader loader;
+//   SceneHandle* level = loader.LoadScene( "assets/level.gltf" );
+//   ...
+//   loader.Update();
+//   if (level->Ready()) ... // level->nodeId is now valid
+// Polling a handle is a single atomic load; no locks are taken on the main
+// thread except when new work is submitted or a handle is released.
+// A load that fails on a worker stores the reason in the handle; Update then
+// reports it on the main thread with FatalError, as the synchronous loaders
+// do. Handles live until the loader is destroyed, or until they are passed
+// to Release.
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace tinygltf { class Model; }
+
+namespace Tmpl8
+{
+
+struct OBJData;
+
+// states of an asset handle
+enum { LOAD_QUEUED = 0, LOAD_BUSY, LOAD_PARSED, LOAD_READY, LOAD_FAILED };
+
+// base class for asset handles; the worker threads execute Job::Main
+class AssetHandle : public Job
+{
+public:
+	virtual ~AssetHandle() = default;
+	bool Ready() const { return state.load( memory_order_acquire ) == LOAD_READY; }
+	bool Failed() const { return state.load( memory_order_acquire ) == LOAD_FAILED; }
+	int State() const { return state.load( memory_order_acquire ); }
+	string file;
+	string error;						// reason of a failed load; valid once the state is LOAD_FAILED
+protected:
+	friend class AsyncLoader;
+	virtual void Publish() {}			// main thread: make the parsed data available
+	virtual void Discard() {}			// main thread: free a result that nobody will collect
+	bool needsPublish = false;			// false if the asset is usable directly after Main
+	bool released = false;				// Release was called while a worker was busy; main thread only
+	atomic<int> state = LOAD_QUEUED;
+};
+
+// image; the surface is owned by the application once the handle is ready,
+// but AsyncLoader::Release deletes it if it is still attached to the handle
+class ImageHandle : public AssetHandle
+{
+public:
+	Surface* surface = 0;
+protected:
+	void Main() override;
+	void Discard() override;
+};
+
+// obj mesh; meshId is the index of the mesh in Scene::meshPool
+class MeshHandle : public AssetHandle
+{
+public:
+	MeshHandle() { needsPublish = true; }
+	~MeshHandle();
+	int meshId = -1;
+protected:
+	friend class AsyncLoader;
+	void Main() override;
+	void Publish() override;
+	string dir, name, objFile;
+	float scale = 1;
+	bool flatShaded = false;
+	OBJData* data = 0;
+};
+
+// glTF scene; nodeId is the index of the first node created for the scene
+class SceneHandle : public AssetHandle
+{
+public:
+	SceneHandle() { needsPublish = true; }
+	~SceneHandle();
+	int nodeId = -1;
+protected:
+	friend class AsyncLoader;
+	void Main() override;
+	void Publish() override;
+	string dir, name;
+	mat4 transform;
+	tinygltf::Model* model = 0;
+};
+
+// the loader service
+class AsyncLoader
+{
+public:
+	// constructor / destructor
+	AsyncLoader( const int threadCount = 0 );
+	~AsyncLoader();
+	// submitting work
+	ImageHandle* LoadSurface( const char* file );
+	MeshHandle* LoadMesh( const char* objFile, const float scale = 1.0f, const bool flatShaded = false );
+	SceneHandle* LoadScene( const char* sceneFile, const mat4& transform = mat4::Identity() );
+	// main thread
+	void Update( const int maxPublish = 1 );
+	void Flush();
+	void Release( AssetHandle* handle );
+	float Progress() const;
+	int Pending() const { return submitted - completed.load( memory_order_acquire ); }
+private:
+	void Submit( AssetHandle* handle );
+	void Worker();
+	// data members
+	vector<thread> workers;
+	list<AssetHandle*> queue;			// jobs waiting for a worker; protected by queueMutex
+	mutex queueMutex;
+	condition_variable queueSignal;
+	bool quit = false;
+	vector<AssetHandle*> handles;		// all handles that have not been released; main thread only
+	vector<AssetHandle*> pending;		// handles that are not ready yet, including released ones; main thread only
+	int submitted = 0;
+	atomic<int> completed = 0;
+};
+
+} // namespace Tmpl8
\ No newline at end of file
@@ -0,0 +1,307 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the noise functions defined in noise.h.
+// Reference for simplex noise: Stefan Gustavson, 'Simplex noise demystified',
+// https://github.com/stegu/perlin-noise/blob/master/simplexnoise.pdf
+
+#include "precomp.h"
+#include "noise.h"
+
+using namespace Tmpl8;
+
+// output scales: 2D Perlin is bounded by |gradient| * sqrt( 1 / 2 ); for the
+// others the unscaled maximum was measured (random search with local
+// refinement) and the scale leaves a 5% margin below 1
+#define PERLIN2_SCALE	0.6325f		// sqrt( 2 / 5 ): gradients have length sqrt( 5 )
+#define PERLIN3_SCALE	0.92f		// 0.95 / 1.036
+#define SIMPLEX2_SCALE	43.0f		// 0.95 / 0.0221
+#define SIMPLEX3_SCALE	73.0f		// 0.95 / 0.0130
+
+// hashing of lattice points; replaces the permutation table of the original
+#define HASHX	0x27d4eb2du
+#define HASHY	0x165667b1u
+#define HASHZ	0x5bd1e995u
+static inline uint Mix( uint h )
+{
+	h ^= h >> 15, h *= 0x2c1b3c6du;
+	h ^= h >> 12, h *= 0x297a2d39u;
+	return h ^ (h >> 15);
+}
+static inline uint Hash( const int x, const int y, const uint seed ) { return Mix( ((uint)x * HASHX) ^ ((uint)y * HASHY) ^ seed ); }
+static inline uint Hash( const int x, const int y, const int z, const uint seed ) { return Mix( ((uint)x * HASHX) ^ ((uint)y * HASHY) ^ ((uint)z * HASHZ) ^ seed ); }
+static inline int FastFloor( const float x ) { const int i = (int)x; return x < i ? i - 1 : i; }
+static inline float Fade( const float t ) { return t * t * t * (t * (t * 6 - 15) + 10); }
+static inline float Lerp( const float a, const float b, const float t ) { return a + t * (b - a); }
+
+// gradients: 2D uses (+/-1,+/-2) and (+/-2,+/-1), 3D uses the 12 edge centers of a cube
+static inline float Grad( const uint h, const float x, const float y )
+{
+	const float u = (h & 4) ? y : x, v = (h & 4) ? x : y;
+	return ((h & 1) ? -u : u) + ((h & 2) ? -2 * v : 2 * v);
+}
+static inline float Grad( const uint h, const float x, const float y, const float z )
+{
+	const uint i = h & 15;
+	const float u = i < 8 ? x : y, v = i < 4 ? y : (i == 12 || i == 14) ? x : z;
+	return ((i & 1) ? -u : u) + ((i & 2) ? -v : v);
+}
+
+// gradient noise
+float Tmpl8::Perlin2D( const float x, const float y, const uint seed )
+{
+	const int ix = FastFloor( x ), iy = FastFloor( y );
+	const float fx = x - ix, fy = y - iy, u = Fade( fx ), v = Fade( fy );
+	const float n00 = Grad( Hash( ix, iy, seed ), fx, fy );
+	const float n10 = Grad( Hash( ix + 1, iy, seed ), fx - 1, fy );
+	const float n01 = Grad( Hash( ix, iy + 1, seed ), fx, fy - 1 );
+	const float n11 = Grad( Hash( ix + 1, iy + 1, seed ), fx - 1, fy - 1 );
+	return Lerp( Lerp( n00, n10, u ), Lerp( n01, n11, u ), v ) * PERLIN2_SCALE;
+}
+
+float Tmpl8::Perlin3D( const float x, const float y, const float z, const uint seed )
+{
+	const int ix = FastFloor( x ), iy = FastFloor( y ), iz = FastFloor( z );
+	const float fx = x - ix, fy = y - iy, fz = z - iz;
+	const float u = Fade( fx ), v = Fade( fy ), w = Fade( fz );
+	float n[2][2][2];
+	for (int k = 0; k < 2; k++) for (int j = 0; j < 2; j++) for (int i = 0; i < 2; i++)
+		n[k][j][i] = Grad( Hash( ix + i, iy + j, iz + k, seed ), fx - i, fy - j, fz - k );
+	const float a = Lerp( Lerp( n[0][0][0], n[0][0][1], u ), Lerp( n[0][1][0], n[0][1][1], u ), v );
+	const float b = Lerp( Lerp( n[1][0][0], n[1][0][1], u ), Lerp( n[1][1][0], n[1][1][1], u ), v );
+	return Lerp( a, b, w ) * PERLIN3_SCALE;
+}
+
+// simplex noise
+float Tmpl8::Simplex2D( const float x, const float y, const uint seed )
+{
+	const float F2 = 0.36602540f, G2 = 0.21132487f; // (sqrt( 3 ) - 1) / 2, (3 - sqrt( 3 )) / 6
+	// skew the input space to find the simplex cell
+	const float s = (x + y) * F2;
+	const int i = FastFloor( x + s ), j = FastFloor( y + s );
+	const float t = (i + j) * G2, x0 = x - (i - t), y0 = y - (j - t);
+	// the point is in the lower or the upper triangle of the cell
+	const int i1 = x0 > y0 ? 1 : 0, j1 = 1 - i1;
+	const float cx[3] = { x0, x0 - i1 + G2, x0 - 1 + 2 * G2 };
+	const float cy[3] = { y0, y0 - j1 + G2, y0 - 1 + 2 * G2 };
+	const uint h[3] = { Hash( i, j, seed ), Hash( i + i1, j + j1, seed ), Hash( i + 1, j + 1, seed ) };
+	float n = 0;
+	for (int c = 0; c < 3; c++)
+	{
+		float r = 0.5f - cx[c] * cx[c] - cy[c] * cy[c];
+		if (r > 0) r *= r, n += r * r * Grad( h[c], cx[c], cy[c] );
+	}
+	return n * SIMPLEX2_SCALE;
+}
+
+float Tmpl8::Simplex3D( const float x, const float y, const float z, const uint seed )
+{
+	const float F3 = 1.0f / 3, G3 = 1.0f / 6;
+	const float s = (x + y + z) * F3;
+	const int i = FastFloor( x + s ), j = FastFloor( y + s ), k = FastFloor( z + s );
+	const float t = (i + j + k) * G3, x0 = x - (i - t), y0 = y - (j - t), z0 = z - (k - t);
+	// determine which of the six tetrahedra contains the point
+	int i1, j1, k1, i2, j2, k2;
+	if (x0 >= y0)
+	{
+		if (y0 >= z0) i1 = 1, j1 = 0, k1 = 0, i2 = 1, j2 = 1, k2 = 0;
+		else if (x0 >= z0) i1 = 1, j1 = 0, k1 = 0, i2 = 1, j2 = 0, k2 = 1;
+		else i1 = 0, j1 = 0, k1 = 1, i2 = 1, j2 = 0, k2 = 1;
+	}
+	else
+	{
+		if (y0 < z0) i1 = 0, j1 = 0, k1 = 1, i2 = 0, j2 = 1, k2 = 1;
+		else if (x0 < z0) i1 = 0, j1 = 1, k1 = 0, i2 = 0, j2 = 1, k2 = 1;
+		else i1 = 0, j1 = 1, k1 = 0, i2 = 1, j2 = 1, k2 = 0;
+	}
+	const float cx[4] = { x0, x0 - i1 + G3, x0 - i2 + 2 * G3, x0 - 1 + 3 * G3 };
+	const float cy[4] = { y0, y0 - j1 + G3, y0 - j2 + 2 * G3, y0 - 1 + 3 * G3 };
+	const float cz[4] = { z0, z0 - k1 + G3, z0 - k2 + 2 * G3, z0 - 1 + 3 * G3 };
+	const uint h[4] = {
+		Hash( i, j, k, seed ), Hash( i + i1, j + j1, k + k1, seed ),
+		Hash( i + i2, j + j2, k + k2, seed ), Hash( i + 1, j + 1, k + 1, seed )
+	};
+	float n = 0;
+	for (int c = 0; c < 4; c++)
+	{
+		float r = 0.5f - cx[c] * cx[c] - cy[c] * cy[c] - cz[c] * cz[c];
+		if (r > 0) r *= r, n += r * r * Grad( h[c], cx[c], cy[c], cz[c] );
+	}
+	return n * SIMPLEX3_SCALE;
+}
+
+// fractal sums; every octave uses its own seed, so that lattice points of
+// successive octaves do not line up
+#define OCTAVESEED( s, i ) ((s).seed + (uint)(i) * 0x9e3779b9u)
+static inline float Octave( const NoiseSettings& s, const int i, const float x, const float y )
+{
+	return s.type == NoiseSettings::SIMPLEX ? Simplex2D( x, y, OCTAVESEED( s, i ) ) : Perlin2D( x, y, OCTAVESEED( s, i ) );
+}
+static inline float Octave( const NoiseSettings& s, const int i, const float x, const float y, const float z )
+{
+	return s.type == NoiseSettings::SIMPLEX ? Simplex3D( x, y, z, OCTAVESEED( s, i ) ) : Perlin3D( x, y, z, OCTAVESEED( s, i ) );
+}
+
+float Tmpl8::FBm( const float x, const float y, const NoiseSettings& s )
+{
+	float sum = 0, norm = 0, amplitude = 1, f = s.frequency;
+	for (int i = 0; i < s.octaves; i++, amplitude *= s.gain, f *= s.lacunarity)
+		sum += Octave( s, i, x * f, y * f ) * amplitude, norm += amplitude;
+	return norm > 0 ? sum / norm : 0;
+}
+
+float Tmpl8::FBm( const float x, const float y, const float z, const NoiseSettings& s )
+{
+	float sum = 0, norm = 0, amplitude = 1, f = s.frequency;
+	for (int i = 0; i < s.octaves; i++, amplitude *= s.gain, f *= s.lacunarity)
+		sum += Octave( s, i, x * f, y * f, z * f ) * amplitude, norm += amplitude;
+	return norm > 0 ? sum / norm : 0;
+}
+
+float Tmpl8::Ridged( const float x, const float y, const NoiseSettings& s )
+{
+	float sum = 0, norm = 0, amplitude = 1, f = s.frequency;
+	for (int i = 0; i < s.octaves; i++, amplitude *= s.gain, f *= s.lacunarity)
+	{
+		const float r = 1 - fabsf( Octave( s, i, x * f, y * f ) );
+		sum += r * r * amplitude, norm += amplitude;
+	}
+	return norm > 0 ? sum / norm : 0;
+}
+
+float Tmpl8::Ridged( const float x, const float y, const float z, const NoiseSettings& s )
+{
+	float sum = 0, norm = 0, amplitude = 1, f = s.frequency;
+	for (int i = 0; i < s.octaves; i++, amplitude *= s.gain, f *= s.lacunarity)
+	{
+		const float r = 1 - fabsf( Octave( s, i, x * f, y * f, z * f ) );
+		sum += r * r * amplitude, norm += amplitude;
+	}
+	return norm > 0 ? sum / norm : 0;
+}
+
+// domain warping: the displacement is the fBm of two fields with different seeds
+#define WARPSEEDX	0x6a09e667u
+#define WARPSEEDY	0xbb67ae85u
+float Tmpl8::Warped( const float x, const float y, const NoiseSettings& s )
+{
+	NoiseSettings w = s;
+	w.seed = s.seed ^ WARPSEEDX;
+	const float qx = FBm( x, y, w );
+	w.seed = s.seed ^ WARPSEEDY;
+	const float qy = FBm( x, y, w );
+	return FBm( x + s.warp * qx, y + s.warp * qy, s );
+}
+
+static float Sample( const float x, const float y, const NoiseSettings& s, const int mode )
+{
+	return mode == NOISE_RIDGED ? Ridged( x, y, s ) : mode == NOISE_WARPED ? Warped( x, y, s ) : FBm( x, y, s );
+}
+
+#ifdef SIMD_F32X8
+
+// 2D gradient noise for 8 samples; follows Perlin2D( x, y, seed ) step by step
+static inline __m256i Mix8( __m256i h )
+{
+	h = _mm256_xor_si256( h, _mm256_srli_epi32( h, 15 ) ), h = _mm256_mullo_epi32( h, _mm256_set1_epi32( 0x2c1b3c6d ) );
+	h = _mm256_xor_si256( h, _mm256_srli_epi32( h, 12 ) ), h = _mm256_mullo_epi32( h, _mm256_set1_epi32( 0x297a2d39 ) );
+	return _mm256_xor_si256( h, _mm256_srli_epi32( h, 15 ) );
+}
+static inline __m256 Grad8( const __m256i h, const __m256 x, const __m256 y )
+{
+	// blendv tests the sign bit, so shift the hash bit that selects each option there
+	const __m256 swap = _mm256_castsi256_ps( _mm256_slli_epi32( h, 29 ) );
+	const __m256 u = _mm256_blendv_ps( x, y, swap ), v = _mm256_blendv_ps( y, x, swap );
+	const __m256 su = _mm256_castsi256_ps( _mm256_slli_epi32( h, 31 ) );
+	const __m256 sv = _mm256_castsi256_ps( _mm256_slli_epi32( _mm256_srli_epi32( h, 1 ), 31 ) );
+	return _mm256_add_ps( _mm256_xor_ps( u, su ), _mm256_xor_ps( _mm256_add_ps( v, v ), sv ) );
+}
+static inline __m256 Fade8( const __m256 t )
+{
+	const __m256 p = _mm256_add_ps( _mm256_mul_ps( t, _mm256_sub_ps( _mm256_mul_ps( t, _mm256_set1_ps( 6 ) ), _mm256_set1_ps( 15 ) ) ), _mm256_set1_ps( 10 ) );
+	return _mm256_mul_ps( _mm256_mul_ps( _mm256_mul_ps( t, t ), t ), p );
+}
+static inline __m256 Lerp8( const __m256 a, const __m256 b, const __m256 t ) { return _mm256_add_ps( a, _mm256_mul_ps( t, _mm256_sub_ps( b, a ) ) ); }
+static __m256 Perlin8( const __m256 x, const __m256 y, const uint seed )
+{
+	const __m256 flx = _mm256_floor_ps( x ), fly = _mm256_floor_ps( y );
+	const __m256 fx = _mm256_sub_ps( x, flx ), fy = _mm256_sub_ps( y, fly ), one = _mm256_set1_ps( 1 );
+	const __m256 fx1 = _mm256_sub_ps( fx, one ), fy1 = _mm256_sub_ps( fy, one );
+	const __m256 u = Fade8( fx ), v = Fade8( fy );
+	// (x + 1) * HASHX = x * HASHX + HASHX, so the corner hashes share the multiplies
+	const __m256i hx0 = _mm256_mullo_epi32( _mm256_cvttps_epi32( flx ), _mm256_set1_epi32( (int)HASHX ) );
+	const __m256i hx1 = _mm256_add_epi32( hx0, _mm256_set1_epi32( (int)HASHX ) ), seed8 = _mm256_set1_epi32( (int)seed );
+	const __m256i hy = _mm256_mullo_epi32( _mm256_cvttps_epi32( fly ), _mm256_set1_epi32( (int)HASHY ) );
+	const __m256i hy0 = _mm256_xor_si256( hy, seed8 ), hy1 = _mm256_xor_si256( _mm256_add_epi32( hy, _mm256_set1_epi32( (int)HASHY ) ), seed8 );
+	const __m256 n00 = Grad8( Mix8( _mm256_xor_si256( hx0, hy0 ) ), fx, fy );
+	const __m256 n10 = Grad8( Mix8( _mm256_xor_si256( hx1, hy0 ) ), fx1, fy );
+	const __m256 n01 = Grad8( Mix8( _mm256_xor_si256( hx0, hy1 ) ), fx, fy1 );
+	const __m256 n11 = Grad8( Mix8( _mm256_xor_si256( hx1, hy1 ) ), fx1, fy1 );
+	return _mm256_mul_ps( Lerp8( Lerp8( n00, n10, u ), Lerp8( n01, n11, u ), v ), _mm256_set1_ps( PERLIN2_SCALE ) );
+}
+static __m256 FBm8( const __m256 x, const __m256 y, const NoiseSettings& s )
+{
+	__m256 sum = _mm256_setzero_ps();
+	float norm = 0, amplitude = 1, f = s.frequency;
+	for (int i = 0; i < s.octaves; i++, amplitude *= s.gain, f *= s.lacunarity)
+	{
+		const __m256 f8 = _mm256_set1_ps( f );
+		const __m256 n = Perlin8( _mm256_mul_ps( x, f8 ), _mm256_mul_ps( y, f8 ), OCTAVESEED( s, i ) );
+		sum = _mm256_add_ps( sum, _mm256_mul_ps( n, _mm256_set1_ps( amplitude ) ) ), norm += amplitude;
+	}
+	return _mm256_mul_ps( sum, _mm256_set1_ps( norm > 0 ? 1 / norm : 0 ) );
+}
+static __m256 Ridged8( const __m256 x, const __m256 y, const NoiseSettings& s )
+{
+	const __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) ), one = _mm256_set1_ps( 1 );
+	__m256 sum = _mm256_setzero_ps();
+	float norm = 0, amplitude = 1, f = s.frequency;
+	for (int i = 0; i < s.octaves; i++, amplitude *= s.gain, f *= s.lacunarity)
+	{
+		const __m256 f8 = _mm256_set1_ps( f );
+		const __m256 n = Perlin8( _mm256_mul_ps( x, f8 ), _mm256_mul_ps( y, f8 ), OCTAVESEED( s, i ) );
+		const __m256 r = _mm256_sub_ps( one, _mm256_and_ps( n, absMask ) );
+		sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_mul_ps( r, r ), _mm256_set1_ps( amplitude ) ) ), norm += amplitude;
+	}
+	return _mm256_mul_ps( sum, _mm256_set1_ps( norm > 0 ? 1 / norm : 0 ) );
+}
+static __m256 Sample8( const __m256 x, const __m256 y, const NoiseSettings& s, const int mode )
+{
+	if (mode == NOISE_RIDGED) return Ridged8( x, y, s );
+	if (mode != NOISE_WARPED) return FBm8( x, y, s );
+	NoiseSettings w = s;
+	w.seed = s.seed ^ WARPSEEDX;
+	const __m256 qx = FBm8( x, y, w );
+	w.seed = s.seed ^ WARPSEEDY;
+	const __m256 qy = FBm8( x, y, w );
+	const __m256 warp = _mm256_set1_ps( s.warp );
+	return FBm8( _mm256_add_ps( x, _mm256_mul_ps( qx, warp ) ), _mm256_add_ps( y, _mm256_mul_ps( qy, warp ) ), s );
+}
+
+#endif
+
+// batch evaluation
+void Tmpl8::NoiseRow( float* dst, const int n, const float x0, const float y, const float dx, const NoiseSettings& s, const int mode )
+{
+	int i = 0;
+#ifdef SIMD_F32X8
+	if (s.type == NoiseSettings::PERLIN && CPUCaps::HW_AVX2 && CPUCaps::HW_FMA3)
+	{
+		const __m256 y8 = _mm256_set1_ps( y ), x08 = _mm256_set1_ps( x0 ), dx8 = _mm256_set1_ps( dx );
+		const __m256i lane = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+		for (; i + 8 <= n; i += 8)
+		{
+			const __m256 idx = _mm256_cvtepi32_ps( _mm256_add_epi32( lane, _mm256_set1_epi32( i ) ) );
+			_mm256_storeu_ps( dst + i, Sample8( _mm256_add_ps( x08, _mm256_mul_ps( idx, dx8 ) ), y8, s, mode ) );
+		}
+	}
+#endif
+	for (; i < n; i++) dst[i] = Sample( x0 + i * dx, y, s, mode );
+}
+
+void Tmpl8::NoiseGrid( float* dst, const int w, const int h, const float x0, const float y0, const float dx, const float dy, const NoiseSettings& s, const int mode )
+{
+#pragma omp parallel for schedule( dynamic, 4 )
+	for (int j = 0; j < h; j++) NoiseRow( dst + (size_t)j * w, w, x0, y0 + j * dy, dx, s, mode );
+}
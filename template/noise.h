@@ -0,0 +1,55 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: coherent noise. noise2D / noise3D in tmpl8math.h remain
+// available; the functions here are faster and of higher quality:
+// - Perlin: gradient noise (Perlin 2002) with a quintic fade curve.
+// - Simplex: Perlin's simplex noise, after Gustavson's 'Simplex noise
+//   demystified'; fewer corners per sample in 3D, no axis-aligned artifacts.
+// - FBm, Ridged, Warped: fractal sums of several octaves of the above.
+// Results are in [-1..1] (Ridged: [0..1]). There are no permutation tables:
+// lattice points are hashed with integer arithmetic, so a seed selects an
+// independent noise field at no cost.
+// NoiseRow and NoiseGrid evaluate many samples at once: 2D Perlin noise is
+// evaluated 8 samples at a time with AVX2, and grid rows are distributed
+// over the available cores using OpenMP.
+
+#pragma once
+
+namespace Tmpl8
+{
+
+// fractal noise settings
+struct NoiseSettings
+{
+	enum { PERLIN = 0, SIMPLEX };
+	int type = PERLIN;
+	int octaves = 6;			// number of layers
+	float frequency = 1;		// frequency of the first octave
+	float lacunarity = 2;		// frequency multiplier per octave
+	float gain = 0.5f;			// amplitude multiplier per octave
+	float warp = 1;				// displacement strength for Warped
+	uint seed = 0;
+};
+
+// single octave
+float Perlin2D( const float x, const float y, const uint seed = 0 );
+float Perlin3D( const float x, const float y, const float z, const uint seed = 0 );
+float Simplex2D( const float x, const float y, const uint seed = 0 );
+float Simplex3D( const float x, const float y, const float z, const uint seed = 0 );
+
+// fractal sums
+float FBm( const float x, const float y, const NoiseSettings& s = NoiseSettings() );
+float FBm( const float x, const float y, const float z, const NoiseSettings& s = NoiseSettings() );
+float Ridged( const float x, const float y, const NoiseSettings& s = NoiseSettings() );
+float Ridged( const float x, const float y, const float z, const NoiseSettings& s = NoiseSettings() );
+float Warped( const float x, const float y, const NoiseSettings& s = NoiseSettings() ); // fBm of fBm-displaced coordinates
+
+// batch evaluation. A row holds samples (x0 + i * dx, y), i = 0..n-1; a
+// grid holds rows at y0 + j * dy, j = 0..h-1, stored consecutively.
+enum { NOISE_FBM = 0, NOISE_RIDGED, NOISE_WARPED };
+void NoiseRow( float* dst, const int n, const float x0, const float y, const float dx, const NoiseSettings& s, const int mode = NOISE_FBM );
+void NoiseGrid( float* dst, const int w, const int h, const float x0, const float y0, const float dx, const float dy, const NoiseSettings& s, const int mode = NOISE_FBM );
+
+} // namespace Tmpl8
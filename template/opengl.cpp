@@ -82,9 +82,9 @@ void DrawQuad()
 }
 
 // OpenGL texture wrapper class
-GLTexture::GLTexture( uint w, uint h, uint type )
+GLTexture::GLTexture( uint w, uint h, uint t )
 {
-	width = w, height = h;
+	width = w, height = h, type = t;
 	glGenTextures( 1, &ID );
 	glBindTexture( GL_TEXTURE_2D, ID );
 	if (type == DEFAULT)
@@ -102,6 +102,33 @@ GLTexture::GLTexture( uint w, uint h, uint type )
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
 		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
 	}
+	else if (type == STREAMTARGET)
+	{
+		// render target that is updated every frame: immutable storage, filled
+		// from a ring of pixel buffer objects. With OpenGL 4.4 the buffers are
+		// mapped once, persistently; otherwise they are mapped for each upload.
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR ); // for dynamic resolution
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		if (GLAD_GL_VERSION_4_2) glTexStorage2D( GL_TEXTURE_2D, 1, GL_RGBA8, width, height );
+		else glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, 0 );
+		persistent = GLAD_GL_VERSION_4_4 != 0;
+		const GLsizeiptr size = (GLsizeiptr)width * height * sizeof( uint );
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers( 3, pbo );
+		for (int i = 0; i < 3; i++)
+		{
+			glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[i] );
+			if (!persistent) glBufferData( GL_PIXEL_UNPACK_BUFFER, size, 0, GL_STREAM_DRAW ); else
+			{
+				glBufferStorage( GL_PIXEL_UNPACK_BUFFER, size, 0, flags );
+				mapped[i] = (uint*)glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size, flags );
+				FATALERROR_IF( !mapped[i], "GLTexture: could not map pixel buffer" );
+			}
+		}
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	}
 	else /* type == FLOAT */
 	{
 		// floating point texture
@@ -117,6 +144,14 @@ GLTexture::GLTexture( uint w, uint h, uint type )
 
 GLTexture::~GLTexture()
 {
+	if (type == STREAMTARGET) for (int i = 0; i < 3; i++)
+	{
+		if (fence[i]) glDeleteSync( fence[i] );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[i] );
+		if (mapped[i]) glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+		glDeleteBuffers( 1, &pbo[i] );
+	}
 	glDeleteTextures( 1, &ID );
 	CheckGL();
 }
@@ -130,6 +165,38 @@ void GLTexture::Bind( const uint slot )
 
 void GLTexture::CopyFrom( Surface* src )
 {
+	if (type == STREAMTARGET)
+	{
+		// the CPU fills one buffer while the driver transfers the previous ones;
+		// a fence guards against overwriting a buffer that is still being read.
+		const uint i = ringIdx;
+		ringIdx = (ringIdx + 1) % 3;
+		if (fence[i])
+		{
+			while (glClientWaitSync( fence[i], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 /* 1s */ ) == GL_TIMEOUT_EXPIRED);
+			glDeleteSync( fence[i] );
+			fence[i] = 0;
+		}
+		// the surface may be smaller than the texture (dynamic resolution); in that
+		// case, only the top-left corner of the texture is updated. A larger surface
+		// is cropped; its rows are then packed into the buffer one by one.
+		const uint w = min( width, (uint)src->width ), h = min( height, (uint)src->height );
+		const GLsizeiptr size = (GLsizeiptr)w * h * sizeof( uint );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[i] );
+		uint* dst = mapped[i];
+		if (!persistent) dst = (uint*)glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+		FATALERROR_IF( !dst, "GLTexture: could not map pixel buffer" );
+		if ((uint)src->width == w) memcpy( dst, src->pixels, size );
+		else for (uint y = 0; y < h; y++) memcpy( dst + y * w, src->pixels + y * src->width, w * sizeof( uint ) );
+		if (!persistent) glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+		glBindTexture( GL_TEXTURE_2D, ID );
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, w, h, GL_BGRA, GL_UNSIGNED_BYTE, 0 );
+		fence[i] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+		CheckGL();
+		return;
+	}
 	glBindTexture( GL_TEXTURE_2D, ID );
 	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, src->pixels );
 	CheckGL();
@@ -230,6 +297,12 @@ void Shader::SetFloat( const char* name, const float v )
 	CheckGL();
 }
 
+void Shader::SetFloat2( const char* name, const float x, const float y )
+{
+	glUniform2f( glGetUniformLocation( ID, name ), x, y );
+	CheckGL();
+}
+
 void Shader::SetInt( const char* name, const int v )
 {
 	glUniform1i( glGetUniformLocation( ID, name ), v );
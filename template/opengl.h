@@ -8,7 +8,7 @@
 class GLTexture
 {
 public:
-	enum { DEFAULT = 0, FLOAT = 1, INTTARGET = 2 };
+	enum { DEFAULT = 0, FLOAT = 1, INTTARGET = 2, STREAMTARGET = 3 };
 	// constructor / destructor
 	GLTexture( uint width, uint height, uint type = DEFAULT );
 	~GLTexture();
@@ -20,6 +20,14 @@ public:
 	// public data members
 	GLuint ID = 0;
 	uint width = 0, height = 0;
+	uint type = DEFAULT;
+private:
+	// STREAMTARGET: ring of pixel buffer objects; see CopyFrom
+	GLuint pbo[3] = {};
+	GLsync fence[3] = {};
+	uint* mapped[3] = {};
+	uint ringIdx = 0;
+	bool persistent = false;
 };
 
 // template function access
@@ -40,6 +48,7 @@ public:
 	void SetInputTexture( uint slot, const char* name, GLTexture* texture );
 	void SetInputMatrix( const char* name, const mat4& matrix );
 	void SetFloat( const char* name, const float v );
+	void SetFloat2( const char* name, const float x, const float y );
 	void SetInt( const char* name, const int v );
 	void SetUInt( const char* name, const uint v );
 	void Unbind();
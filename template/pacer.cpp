@@ -0,0 +1,151 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the frame pacer defined in pacer.h.
+// The limiter sleeps while plenty of time is left and spins for the last
+// few milliseconds: sleeping alone is too coarse (the OS wakes us up late),
+// spinning alone keeps a core busy for the entire wait.
+
+#include "precomp.h"
+#include <thread>
+#ifdef _WIN32
+#include <mmsystem.h>
+#endif
+
+static int Bin( const float ms ) { return min( PACERBINS - 1, (int)(ms * (1.0f / PACERBINWIDTH)) ); }
+
+// constructor / destructor
+FramePacer::FramePacer()
+{
+#ifdef _WIN32
+	timeBeginPeriod( 1 ); // 1ms sleep granularity, instead of the default 15.6ms
+#endif
+	Reset();
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	timeEndPeriod( 1 );
+#endif
+}
+
+// clear the statistics
+void FramePacer::Reset()
+{
+	memset( history, 0, sizeof( history ) );
+	memset( bins, 0, sizeof( bins ) );
+	frame = 0;
+}
+
+// wait until 'ms' milliseconds have passed
+void FramePacer::Wait( const float ms )
+{
+	if (ms <= 0) return;
+	Timer t;
+	while (1000.0f * t.elapsed() + 1 < ms - spinTime) this_thread::sleep_for( chrono::milliseconds( 1 ) );
+	while (1000.0f * t.elapsed() < ms) _mm_pause();
+}
+
+// end the previous frame and start a new one: apply the frame rate limit,
+// record the frame time and return the (optionally smoothed) deltaTime
+float FramePacer::FrameStart()
+{
+	if (targetFPS > 0) Wait( 1000.0f / targetFPS - 1000.0f * timer.elapsed() );
+	const float ms = 1000.0f * timer.elapsed();
+	timer.reset();
+	// update the rolling window and its histogram
+	const int slot = frame % PACERHISTORY;
+	if (frame >= PACERHISTORY) bins[Bin( history[slot] )]--;
+	history[slot] = ms, bins[Bin( ms )]++, frame++;
+	// deltaTime for the simulation
+	float deltaTime = ms;
+	if (smoothFrames > 1)
+	{
+		const int n = min( smoothFrames, Frames() );
+		float sum = 0;
+		for (int i = 0; i < n; i++) sum += history[(frame - 1 - i) % PACERHISTORY];
+		deltaTime = sum / n;
+	}
+	return min( 500.0f, deltaTime );
+}
+
+// frame time below which p percent (0..100) of the frames in the window fall;
+// the result is rounded up to the histogram bin width
+float FramePacer::Percentile( const float p ) const
+{
+	const int n = Frames();
+	if (n == 0) return 0;
+	const int target = max( 1, (int)ceilf( p * 0.01f * n ) );
+	for (int i = 0, count = 0; i < PACERBINS - 1; i++)
+		if ((count += bins[i]) >= target) return (i + 1) * PACERBINWIDTH;
+	// the frame lands in the overflow bin; report the longest frame instead
+	float longest = 0;
+	for (int i = 0; i < n; i++) longest = max( longest, history[i] );
+	return longest;
+}
+
+float FramePacer::Average() const
+{
+	const int n = Frames();
+	float sum = 0;
+	for (int i = 0; i < n; i++) sum += history[i];
+	return n == 0 ? 0 : sum / n;
+}
+
+// draw a frame time graph (one column per frame, newest on the right), a
+// histogram and the percentiles. The vertical scale is twice the target
+// frame time, or 33ms if there is no target.
+void FramePacer::DrawOverlay( Surface* target, const int x, const int y, const int height ) const
+{
+	const int histWidth = 128, width = PACERHISTORY + 4 + histWidth;
+	if (x < 0 || y < 0 || x + width > target->width || y + height + 10 > target->height) return;
+	const float budget = targetFPS > 0 ? 1000.0f / targetFPS : 16.6f, range = 2 * budget;
+	// darken the background
+	for (int v = 0; v < height + 10; v++)
+	{
+		uint* line = target->pixels + x + (y + v) * target->width;
+		for (int u = 0; u < width; u++) line[u] = ScaleColor( line[u], 64 );
+	}
+	// frame time graph
+	const int n = Frames();
+	for (int i = 0; i < n; i++)
+	{
+		const float ms = history[(frame - n + i) % PACERHISTORY];
+		const int h = min( height, (int)(ms * height / range) ), u = x + PACERHISTORY - n + i;
+		const uint c = ms <= budget * 1.05f ? 0x00ff00 : ms <= budget * 1.5f ? 0xffff00 : 0xff0000;
+		for (int v = 0; v < h; v++) target->pixels[u + (y + height - 1 - v) * target->width] = c;
+	}
+	const int budgetLine = y + height - 1 - height / 2;
+	for (int u = 0; u < PACERHISTORY; u++) target->pixels[x + u + budgetLine * target->width] = 0x808080;
+	// histogram: the horizontal axis covers 0..range ms; bars are normalized to the fullest column
+	int columns[histWidth] = {}, highest = 1;
+	for (int i = 0; i < PACERBINS; i++)
+	{
+		const int u = min( histWidth - 1, (int)((i + 0.5f) * PACERBINWIDTH * histWidth / range) );
+		highest = max( highest, columns[u] += bins[i] );
+	}
+	const int hx = x + PACERHISTORY + 4;
+	for (int u = 0; u < histWidth; u++)
+	{
+		const int h = columns[u] * height / highest;
+		const uint c = u < histWidth / 2 ? 0x00c0ff : 0xff8000;
+		for (int v = 0; v < h; v++) target->pixels[hx + u + (y + height - 1 - v) * target->width] = c;
+	}
+	// statistics
+	char t[128];
+	snprintf( t, sizeof( t ), "avg %.1f p50 %.1f p95 %.1f p99 %.1f ms", Average(), Percentile( 50 ), Percentile( 95 ), Percentile( 99 ) );
+	target->Print( t, x + 2, y + height + 2, 0xffffff );
+}
+
+// write the frame times in the window to a csv file
+void FramePacer::SaveCSV( const char* file ) const
+{
+	FILE* f = fopen( file, "w" );
+	FATALERROR_IF( !f, "FramePacer: could not write %s", file );
+	fprintf( f, "frame,ms\n" );
+	const int n = Frames();
+	for (int i = 0; i < n; i++) fprintf( f, "%i,%.3f\n", frame - n + i, history[(frame - n + i) % PACERHISTORY] );
+	fclose( f );
+}
@@ -0,0 +1,52 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: frame pacing. The template owns a single FramePacer, which
+// is available to the application as TheApp::pacer. It can limit the frame
+// rate (set targetFPS), smooth the deltaTime passed to Tick (set
+// smoothFrames), and keeps a rolling histogram of frame times, from which
+// percentiles are calculated. Typical use, in Game::Tick:
+//   pacer->targetFPS = 60;
+//   pacer->DrawOverlay( screen, 2, 2 );
+//   if (IsKeyDown( GLFW_KEY_F9 )) pacer->SaveCSV( "frametimes.csv" );
+
+#pragma once
+
+#define PACERHISTORY		256		// number of frames in the rolling window
+#define PACERBINS			256		// histogram bins; the last bin collects all longer frames
+#define PACERBINWIDTH		0.25f	// histogram bin width, in milliseconds
+
+namespace Tmpl8
+{
+
+class FramePacer
+{
+public:
+	// constructor / destructor
+	FramePacer();
+	~FramePacer();
+	// called by the template at the start of each frame; returns deltaTime in ms
+	float FrameStart();
+	// statistics over the rolling window
+	float Percentile( const float p ) const;
+	float Average() const;
+	float LastFrameTime() const { return history[(frame + PACERHISTORY - 1) % PACERHISTORY]; }
+	int Frames() const { return min( frame, PACERHISTORY ); }
+	// output
+	void DrawOverlay( Surface* target, const int x, const int y, const int height = 64 ) const;
+	void SaveCSV( const char* file ) const;
+	void Reset();
+	// settings
+	float targetFPS = 0;				// 0: no limit
+	int smoothFrames = 0;				// 0: raw deltaTime; otherwise the average over this many frames
+	float spinTime = 2.0f;				// ms; the last part of a wait is spent spinning instead of sleeping
+private:
+	void Wait( const float ms );
+	Timer timer;						// time since the start of the current frame
+	float history[PACERHISTORY];		// frame times in ms, rolling
+	int bins[PACERBINS];				// histogram of the frames in 'history'
+	int frame = 0;						// total number of recorded frames
+};
+
+} // namespace Tmpl8
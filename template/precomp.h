@@ -54,10 +54,15 @@ using namespace std;
 
 // math classes
 #include "tmpl8math.h"
+#include "tmpl8simd.h"
+#include "fastmath.h"
+#include "rng.h"
 
 // template headers
 #include "surface.h"
 #include "sprite.h"
+#include "filter.h"
+#include "atlas.h"
 
 // namespaces
 using namespace Tmpl8;
@@ -217,9 +222,11 @@ void TextFileWrite( const string& text, const char* _File );
 // low-level: instruction set detection
 #ifdef _WIN32
 #define cpuid(info, x) __cpuidex(info, x, 0)
+#define xgetbv(x) _xgetbv(x)
 #else
 #include <cpuid.h>
 void cpuid( int info[4], int InfoType ) { __cpuid_count( InfoType, 0, info[0], info[1], info[2], info[3] ); }
+inline uint64_t xgetbv( uint index ) { uint eax, edx; __asm__ __volatile__( "xgetbv" : "=a"(eax), "=d"(edx) : "c"(index) ); return ((uint64_t)edx << 32) | eax; }
 #endif
 class CPUCaps // from https://github.com/Mysticial/FeatureDetector
 {
@@ -232,7 +239,7 @@ public:
 	static inline bool HW_AES = false, HW_SHA = false;
 	// SIMD: 256-bit
 	static inline bool HW_AVX = false, HW_XOP = false, HW_FMA3 = false, HW_FMA4 = false;
-	static inline bool HW_AVX2 = false;
+	static inline bool HW_AVX2 = false, HW_F16C = false;
 	// SIMD: 512-bit
 	static inline bool HW_AVX512F = false;    //  AVX512 Foundation
 	static inline bool HW_AVX512CD = false;   //  AVX512 Conflict Detection
@@ -251,10 +258,19 @@ public:
 		int nIds = info[0];
 		cpuid( info, 0x80000000 );
 		unsigned nExIds = info[0];
+		// the cpu flags alone are not enough: AVX state (ymm) and AVX-512 state (opmask, zmm)
+		// must also be enabled by the OS, which it reports via OSXSAVE and XCR0.
+		bool osAVX = false, osAVX512 = false;
 		// detect cpu features
 		if (nIds >= 0x00000001)
 		{
 			cpuid( info, 0x00000001 );
+			if (info[2] & ((int)1 << 27))
+			{
+				const uint64_t xcr0 = xgetbv( 0 );
+				osAVX = (xcr0 & 0x06) == 0x06;
+				osAVX512 = osAVX && (xcr0 & 0xe0) == 0xe0;
+			}
 			HW_MMX = (info[3] & ((int)1 << 23)) != 0;
 			HW_SSE = (info[3] & ((int)1 << 25)) != 0;
 			HW_SSE2 = (info[3] & ((int)1 << 26)) != 0;
@@ -263,28 +279,29 @@ public:
 			HW_SSE41 = (info[2] & ((int)1 << 19)) != 0;
 			HW_SSE42 = (info[2] & ((int)1 << 20)) != 0;
 			HW_AES = (info[2] & ((int)1 << 25)) != 0;
-			HW_AVX = (info[2] & ((int)1 << 28)) != 0;
-			HW_FMA3 = (info[2] & ((int)1 << 12)) != 0;
+			HW_AVX = osAVX && (info[2] & ((int)1 << 28)) != 0;
+			HW_FMA3 = osAVX && (info[2] & ((int)1 << 12)) != 0;
+			HW_F16C = osAVX && (info[2] & ((int)1 << 29)) != 0;
 			HW_RDRAND = (info[2] & ((int)1 << 30)) != 0;
 		}
 		if (nIds >= 0x00000007)
 		{
 			cpuid( info, 0x00000007 );
-			HW_AVX2 = (info[1] & ((int)1 << 5)) != 0;
+			HW_AVX2 = osAVX && (info[1] & ((int)1 << 5)) != 0;
 			HW_BMI1 = (info[1] & ((int)1 << 3)) != 0;
 			HW_BMI2 = (info[1] & ((int)1 << 8)) != 0;
 			HW_ADX = (info[1] & ((int)1 << 19)) != 0;
 			HW_SHA = (info[1] & ((int)1 << 29)) != 0;
 			HW_PREFETCHWT1 = (info[2] & ((int)1 << 0)) != 0;
-			HW_AVX512F = (info[1] & ((int)1 << 16)) != 0;
-			HW_AVX512CD = (info[1] & ((int)1 << 28)) != 0;
-			HW_AVX512PF = (info[1] & ((int)1 << 26)) != 0;
-			HW_AVX512ER = (info[1] & ((int)1 << 27)) != 0;
-			HW_AVX512VL = (info[1] & ((int)1 << 31)) != 0;
-			HW_AVX512BW = (info[1] & ((int)1 << 30)) != 0;
-			HW_AVX512DQ = (info[1] & ((int)1 << 17)) != 0;
-			HW_AVX512IFMA = (info[1] & ((int)1 << 21)) != 0;
-			HW_AVX512VBMI = (info[2] & ((int)1 << 1)) != 0;
+			HW_AVX512F = osAVX512 && (info[1] & ((int)1 << 16)) != 0;
+			HW_AVX512CD = osAVX512 && (info[1] & ((int)1 << 28)) != 0;
+			HW_AVX512PF = osAVX512 && (info[1] & ((int)1 << 26)) != 0;
+			HW_AVX512ER = osAVX512 && (info[1] & ((int)1 << 27)) != 0;
+			HW_AVX512VL = osAVX512 && (info[1] & ((int)1 << 31)) != 0;
+			HW_AVX512BW = osAVX512 && (info[1] & ((int)1 << 30)) != 0;
+			HW_AVX512DQ = osAVX512 && (info[1] & ((int)1 << 17)) != 0;
+			HW_AVX512IFMA = osAVX512 && (info[1] & ((int)1 << 21)) != 0;
+			HW_AVX512VBMI = osAVX512 && (info[2] & ((int)1 << 1)) != 0;
 		}
 		if (nExIds >= 0x80000001)
 		{
@@ -292,8 +309,8 @@ public:
 			HW_x64 = (info[3] & ((int)1 << 29)) != 0;
 			HW_ABM = (info[2] & ((int)1 << 5)) != 0;
 			HW_SSE4a = (info[2] & ((int)1 << 6)) != 0;
-			HW_FMA4 = (info[2] & ((int)1 << 16)) != 0;
-			HW_XOP = (info[2] & ((int)1 << 11)) != 0;
+			HW_FMA4 = osAVX && (info[2] & ((int)1 << 16)) != 0;
+			HW_XOP = osAVX && (info[2] & ((int)1 << 11)) != 0;
 		}
 	}
 };
@@ -392,6 +409,9 @@ void MarkAsDirty() { __dirty++; } \
 void MarkAsNotDirty() { Changed(); } \
 private: uint64_t __crc64 = CLEARCRC64; uint __dirty = 0; public:
 
+// frame pacing; depends on Timer
+#include "pacer.h"
+
 // application base class
 class TheApp
 {
@@ -406,6 +426,23 @@ public:
 	virtual void KeyUp( int key ) = 0;
 	virtual void KeyDown( int key ) = 0;
 	Surface* screen = 0;
+	FramePacer* pacer = 0;				// frame rate limit and frame time statistics; set by the template
+	// dynamic resolution: when enabled, the template shrinks screen->width and
+	// screen->height (never beyond SCRWIDTH x SCRHEIGHT) to keep the time spent
+	// in Tick close to targetFrameTime; the result is upscaled when presented.
+	bool dynamicResolution = false;
+	float targetFrameTime = 16.6f;		// in milliseconds
+	float minScreenScale = 0.5f;		// lowest internal resolution, relative to SCRWIDTH x SCRHEIGHT
+	float sharpen = 0.3f;				// strength of the sharpening filter used when upscaling
+	float screenScale = 1.0f;			// current internal resolution; set by the template
+	// idle-aware presentation: when enabled, the screen is uploaded and presented
+	// only after a Tick that called Invalidate(). In other frames the template
+	// sleeps until an input event arrives, or until idleTimeout has passed, so
+	// static menus, tools and paused games do not keep a core busy.
+	bool idlePresent = false;
+	float idleTimeout = 100.0f;			// in milliseconds; Tick is called at least this often
+	void Invalidate() { screenChanged = true; }
+	bool screenChanged = true;			// set by Invalidate; cleared by the template after presenting
 };
 
 // EOF
\ No newline at end of file
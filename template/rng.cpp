@@ -0,0 +1,162 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: implementation of the random number streams defined in
+// rng.h. Reference implementations: https://prng.di.unimi.it (xoshiro) and
+// https://www.pcg-random.org (PCG).
+
+#include "precomp.h"
+#include <atomic>
+
+using namespace Tmpl8;
+
+// xoshiro256++: the state is initialized with splitmix64, as recommended
+void Xoshiro256::Seed( const uint64_t seed )
+{
+	for (int i = 0; i < 4; i++) s[i] = SplitMix64( seed + i * 0x9e3779b97f4a7c15ull );
+}
+
+void Xoshiro256::Jump()
+{
+	static const uint64_t jump[4] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+	uint64_t t[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 4; i++) for (int b = 0; b < 64; b++)
+	{
+		if (jump[i] & (1ull << b)) t[0] ^= s[0], t[1] ^= s[1], t[2] ^= s[2], t[3] ^= s[3];
+		Next();
+	}
+	s[0] = t[0], s[1] = t[1], s[2] = t[2], s[3] = t[3];
+}
+
+// PCG32
+void PCG32::Seed( const uint64_t seed, const uint64_t stream )
+{
+	state = 0, inc = (stream << 1) | 1;
+	NextUInt();
+	state += seed;
+	NextUInt();
+}
+
+void PCG32::Advance( uint64_t delta )
+{
+	// combine 'delta' steps of the LCG into a single multiply-add, in log2( delta ) iterations
+	uint64_t curMult = 6364136223846793005ull, curPlus = inc, accMult = 1, accPlus = 0;
+	for (; delta > 0; delta >>= 1)
+	{
+		if (delta & 1) accMult *= curMult, accPlus = accPlus * curMult + curPlus;
+		curPlus = (curMult + 1) * curPlus;
+		curMult *= curMult;
+	}
+	state = accMult * state + accPlus;
+}
+
+// RandomBatch: 16 xoshiro128++ generators, one per lane
+void RandomBatch::Seed( const uint64_t seed )
+{
+	for (int i = 0; i < 16; i++) for (int k = 0; k < 4; k++)
+		s[k][i] = (uint)(SplitMix64( seed + (i * 4 + k) * 0x9e3779b97f4a7c15ull ) >> 32);
+}
+
+// advance all lanes by one step and write one number per lane
+void RandomBatch::Step( uint* out )
+{
+#ifdef SIMD_F32X16
+	if (CPUCaps::HW_AVX512F)
+	{
+		__m512i s0 = _mm512_load_si512( s[0] ), s1 = _mm512_load_si512( s[1] );
+		__m512i s2 = _mm512_load_si512( s[2] ), s3 = _mm512_load_si512( s[3] );
+		_mm512_storeu_si512( out, _mm512_add_epi32( _mm512_rol_epi32( _mm512_add_epi32( s0, s3 ), 7 ), s0 ) );
+		const __m512i t = _mm512_slli_epi32( s1, 9 );
+		s2 = _mm512_xor_si512( s2, s0 ), s3 = _mm512_xor_si512( s3, s1 );
+		s1 = _mm512_xor_si512( s1, s2 ), s0 = _mm512_xor_si512( s0, s3 );
+		s2 = _mm512_xor_si512( s2, t ), s3 = _mm512_rol_epi32( s3, 11 );
+		_mm512_store_si512( s[0], s0 ), _mm512_store_si512( s[1], s1 );
+		_mm512_store_si512( s[2], s2 ), _mm512_store_si512( s[3], s3 );
+		return;
+	}
+#endif
+#ifdef SIMD_F32X8
+	if (CPUCaps::HW_AVX2 && CPUCaps::HW_FMA3)
+	{
+		for (int half = 0; half < 16; half += 8)
+		{
+			__m256i s0 = _mm256_load_si256( (__m256i*)(s[0] + half) ), s1 = _mm256_load_si256( (__m256i*)(s[1] + half) );
+			__m256i s2 = _mm256_load_si256( (__m256i*)(s[2] + half) ), s3 = _mm256_load_si256( (__m256i*)(s[3] + half) );
+			const __m256i sum = _mm256_add_epi32( s0, s3 );
+			const __m256i rot = _mm256_or_si256( _mm256_slli_epi32( sum, 7 ), _mm256_srli_epi32( sum, 25 ) );
+			_mm256_storeu_si256( (__m256i*)(out + half), _mm256_add_epi32( rot, s0 ) );
+			const __m256i t = _mm256_slli_epi32( s1, 9 );
+			s2 = _mm256_xor_si256( s2, s0 ), s3 = _mm256_xor_si256( s3, s1 );
+			s1 = _mm256_xor_si256( s1, s2 ), s0 = _mm256_xor_si256( s0, s3 );
+			s2 = _mm256_xor_si256( s2, t ), s3 = _mm256_or_si256( _mm256_slli_epi32( s3, 11 ), _mm256_srli_epi32( s3, 21 ) );
+			_mm256_store_si256( (__m256i*)(s[0] + half), s0 ), _mm256_store_si256( (__m256i*)(s[1] + half), s1 );
+			_mm256_store_si256( (__m256i*)(s[2] + half), s2 ), _mm256_store_si256( (__m256i*)(s[3] + half), s3 );
+		}
+		return;
+	}
+#endif
+	for (int i = 0; i < 16; i++)
+	{
+		const uint sum = s[0][i] + s[3][i], t = s[1][i] << 9;
+		out[i] = ((sum << 7) | (sum >> 25)) + s[0][i];
+		s[2][i] ^= s[0][i], s[3][i] ^= s[1][i], s[1][i] ^= s[2][i], s[0][i] ^= s[3][i], s[2][i] ^= t;
+		s[3][i] = (s[3][i] << 11) | (s[3][i] >> 21);
+	}
+}
+
+void RandomBatch::Fill( uint* dst, const int n )
+{
+	int i = 0;
+	for (; i + 16 <= n; i += 16) Step( dst + i );
+	if (i == n) return;
+	uint tail[16];
+	Step( tail );
+	memcpy( dst + i, tail, (n - i) * sizeof( uint ) );
+}
+
+void RandomBatch::Fill( float* dst, const int n ) { Fill( dst, n, 0, 1 ); }
+
+void RandomBatch::Fill( float* dst, const int n, const float lo, const float hi )
+{
+	ALIGN( 64 ) uint r[16];
+	const float scale = (hi - lo) * (1.0f / 16777216.0f);
+	for (int i = 0; i < n; i += 16)
+	{
+		Step( r );
+		const int count = min( 16, n - i );
+		for (int j = 0; j < count; j++) dst[i + j] = lo + (r[j] >> 8) * scale;
+	}
+}
+
+// counter-based generator
+void Tmpl8::CounterFill( const uint64_t key, const uint64_t firstCounter, float* dst, const int n )
+{
+	const uint64_t k = SplitMix64( key );
+	for (int i = 0; i < n; i++) dst[i] = (uint)(SplitMix64( k ^ (firstCounter + i) ) >> 40) * (1.0f / 16777216.0f);
+}
+
+// per-thread generators: every thread starts from the same seed, and jumps
+// ahead 2^128 numbers per stream index. Threads that do not call
+// SeedThreadRNG get the next free index on first use.
+static atomic<int> threadCount = 0;
+static thread_local int threadStream = -1;
+
+Xoshiro256& Tmpl8::ThreadRNG()
+{
+	static thread_local Xoshiro256 rng = [] {
+		Xoshiro256 r;
+		if (threadStream < 0) threadStream = threadCount++;
+		for (int i = threadStream; i > 0; i--) r.Jump();
+		return r;
+	}();
+	return rng;
+}
+
+void Tmpl8::SeedThreadRNG( const uint64_t seed, const int stream )
+{
+	threadStream = stream;
+	Xoshiro256& rng = ThreadRNG();
+	rng.Seed( seed );
+	for (int i = stream; i > 0; i--) rng.Jump();
+}
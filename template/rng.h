@@ -0,0 +1,101 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: random number streams. RandomUInt() and RandomFloat() in
+// tmpl8math.h are fine for casual use; the generators here are meant for
+// code that needs many numbers, from many threads, reproducibly.
+// - Xoshiro256: xoshiro256++ by Blackman and Vigna; 64-bit output, 2^256
+//   period, Jump() yields 2^128 non-overlapping streams.
+// - PCG32: O'Neill's PCG-XSH-RR; 32-bit output, 2^63 selectable streams and
+//   O(log n) Advance, so item i of a parallel loop can start at position i.
+// - RandomBatch: 16 interleaved xoshiro128++ generators, stepped with AVX2 or
+//   AVX-512. Fill writes 16 numbers per step. The output does not depend on
+//   the instruction set, so results are the same on every machine.
+// - CounterUInt / CounterFloat: stateless; the result depends only on key
+//   and counter, so parallel runs are reproducible regardless of scheduling.
+// ThreadRNG() returns a generator that is private to the calling thread.
+
+#pragma once
+
+namespace Tmpl8
+{
+
+// xoshiro256++
+class Xoshiro256
+{
+public:
+	Xoshiro256( const uint64_t seed = 0x12345678 ) { Seed( seed ); }
+	void Seed( const uint64_t seed );
+	uint64_t Next()
+	{
+		const uint64_t result = Rotl( s[0] + s[3], 23 ) + s[0], t = s[1] << 17;
+		s[2] ^= s[0], s[3] ^= s[1], s[1] ^= s[2], s[0] ^= s[3], s[2] ^= t;
+		s[3] = Rotl( s[3], 45 );
+		return result;
+	}
+	uint NextUInt() { return (uint)(Next() >> 32); }
+	float NextFloat() { return (Next() >> 40) * (1.0f / 16777216.0f); } // [0..1)
+	float NextFloat( const float lo, const float hi ) { return lo + NextFloat() * (hi - lo); }
+	void Jump(); // equivalent to 2^128 calls to Next
+private:
+	static uint64_t Rotl( const uint64_t x, const int k ) { return (x << k) | (x >> (64 - k)); }
+	uint64_t s[4];
+};
+
+// PCG32
+class PCG32
+{
+public:
+	PCG32( const uint64_t seed = 0x12345678, const uint64_t stream = 0 ) { Seed( seed, stream ); }
+	void Seed( const uint64_t seed, const uint64_t stream = 0 );
+	uint NextUInt()
+	{
+		const uint64_t old = state;
+		state = old * 6364136223846793005ull + inc;
+		const uint xorshifted = (uint)(((old >> 18) ^ old) >> 27), rot = (uint)(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+	}
+	float NextFloat() { return (NextUInt() >> 8) * (1.0f / 16777216.0f); } // [0..1)
+	float NextFloat( const float lo, const float hi ) { return lo + NextFloat() * (hi - lo); }
+	void Advance( const uint64_t delta ); // skip 'delta' numbers
+private:
+	uint64_t state, inc;
+};
+
+// batch generator: 16 xoshiro128++ lanes
+class RandomBatch
+{
+public:
+	RandomBatch( const uint64_t seed = 0x12345678 ) { Seed( seed ); }
+	void Seed( const uint64_t seed );
+	// fill arrays; the stream advances in steps of 16 numbers, so numbers
+	// beyond n in the last step are discarded
+	void Fill( uint* dst, const int n );
+	void Fill( float* dst, const int n ); // [0..1)
+	void Fill( float* dst, const int n, const float lo, const float hi );
+private:
+	void Step( uint* out );
+	ALIGN( 64 ) uint s[4][16];	// state word k of lane i is s[k][i]
+};
+
+// counter-based generator: a strong hash of key and counter
+inline uint64_t SplitMix64( uint64_t x )
+{
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+inline uint CounterUInt( const uint64_t key, const uint64_t counter ) { return (uint)(SplitMix64( SplitMix64( key ) ^ counter ) >> 32); }
+inline float CounterFloat( const uint64_t key, const uint64_t counter ) { return (CounterUInt( key, counter ) >> 8) * (1.0f / 16777216.0f); }
+void CounterFill( const uint64_t key, const uint64_t firstCounter, float* dst, const int n );
+
+// per-thread generator; each thread gets its own stream. For reproducible
+// results, have each worker call SeedThreadRNG with the same seed and its
+// own stream index (e.g. its worker index); otherwise, stream indices are
+// handed out in the order in which threads first call ThreadRNG.
+Xoshiro256& ThreadRNG();
+void SeedThreadRNG( const uint64_t seed, const int stream );
+
+} // namespace Tmpl8
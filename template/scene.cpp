@@ -94,13 +94,20 @@ void Skin::ConvertFromGLTFSkin( const tinygltf::Skin& gltfSkin, const tinygltf::
 		const auto& bufferView = gltfModel.bufferViews[accessor.bufferView];
 		const auto& buffer = gltfModel.buffers[bufferView.buffer];
 		inverseBindMatrices.resize( accessor.count );
-		memcpy( inverseBindMatrices.data(), &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof( mat4 ) );
 		jointMat.resize( accessor.count );
-		// convert gltf's column-major to row-major
+		// convert gltf's column-major to row-major; the bottom row is (0, 0, 0, 1).
+		// glTF only guarantees 4-byte alignment, so each matrix is copied out first.
+		const int stride = accessor.ByteStride( bufferView );
+		const size_t first = accessor.byteOffset + bufferView.byteOffset;
+		const size_t end = accessor.count == 0 ? first : first + (accessor.count - 1) * stride + sizeof( mat4 );
+		FATALERROR_IF( accessor.type != TINYGLTF_TYPE_MAT4 || accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+			stride < (int)sizeof( mat4 ) || end > buffer.data.size(), "Skin %s: invalid inverse bind matrices", name.c_str() );
+		const unsigned char* src = buffer.data.data() + first;
 		for (int k = 0; k < accessor.count; k++)
 		{
-			mat4 M = inverseBindMatrices[k];
-			for (int i = 0; i < 4; i++) for (int j = 0; j < 4; j++) inverseBindMatrices[k].cell[j * 4 + i] = M.cell[i * 4 + j];
+			mat4 M;
+			memcpy( M.cell, src + k * stride, sizeof( mat4 ) );
+			for (int i = 0; i < 3; i++) for (int j = 0; j < 4; j++) inverseBindMatrices[k].cell[i * 4 + j] = M.cell[j * 4 + i];
 		}
 	}
 }
@@ -131,13 +138,21 @@ Mesh::Mesh( const tinygltf::Mesh& gltfMesh, const tinygltf::Model& gltfModel, co
 //  +-----------------------------------------------------------------------------+
 void Mesh::LoadGeometry( const char* file, const char* dir, const float scale, const bool flatShaded )
 {
-	// process supplied file name
 	mat4 T = mat4::Scale( scale ); // may include scale, translation, axis exchange
+	LoadGeometryFromOBJ( OBJFileName( file, dir ), dir, T, flatShaded );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  Mesh::OBJFileName                                                          |
+//  |  Combine file name and directory; verify the extension.               LH2'24|
+//  +-----------------------------------------------------------------------------+
+string Mesh::OBJFileName( const char* file, const char* dir )
+{
 	string combined = string( dir ) + (dir[strlen( dir ) - 1] == '/' ? "" : "/") + string( file );
 	for (int l = (int)combined.size(), i = 0; i < l; i++) if (combined[i] >= 'A' && combined[i] <= 'Z') combined[i] -= 'Z' - 'z';
 	string extension = (combined.find_last_of( "." ) != string::npos) ? combined.substr( combined.find_last_of( "." ) + 1 ) : "";
 	if (extension.compare( "obj" ) != 0) FATALERROR( "unsupported extension in file %s", combined.c_str() );
-	LoadGeometryFromOBJ( combined.c_str(), dir, T, flatShaded );
+	return combined;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -146,14 +161,36 @@ void Mesh::LoadGeometry( const char* file, const char* dir, const float scale, c
 //  +-----------------------------------------------------------------------------+
 void Mesh::LoadGeometryFromOBJ( const string& fileName, const char* directory, const mat4& T, const bool flatShaded )
 {
-	// load obj file
-	tinyobj::attrib_t attrib;
-	vector<tinyobj::shape_t> shapes;
-	vector<tinyobj::material_t> materials;
-	map<string, GLuint> textures;
+	OBJData data;
+	string error;
+	FATALERROR_IF( !ParseOBJ( fileName, directory, data, error ), "%s", error.c_str() );
+	BuildFromOBJ( data, fileName, directory, T, flatShaded );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  Mesh::ParseOBJ                                                             |
+//  |  Parse an obj file using tinyobj. This does not touch the scene, so it      |
+//  |  can be called from any thread (see AsyncLoader). Returns false and a       |
+//  |  message in 'error' if the file could not be loaded.                  LH2'24|
+//  +-----------------------------------------------------------------------------+
+bool Mesh::ParseOBJ( const string& fileName, const char* directory, OBJData& data, string& error )
+{
 	string err, warn;
-	tinyobj::LoadObj( &attrib, &shapes, &materials, &err, &warn, fileName.c_str(), directory );
-	FATALERROR_IF( err.size() > 0 || shapes.size() == 0, "tinyobj failed to load %s: %s", fileName.c_str(), err.c_str() );
+	tinyobj::LoadObj( &data.attrib, &data.shapes, &data.materials, &err, &warn, fileName.c_str(), directory );
+	if (err.size() == 0 && data.shapes.size() > 0) return true;
+	error = "tinyobj failed to load " + fileName + ": " + err;
+	return false;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  Mesh::BuildFromOBJ                                                         |
+//  |  Convert parsed obj data to a mesh; adds materials to the scene.      LH2'24|
+//  +-----------------------------------------------------------------------------+
+void Mesh::BuildFromOBJ( OBJData& data, const string& fileName, const char* directory, const mat4& T, const bool flatShaded )
+{
+	tinyobj::attrib_t& attrib = data.attrib;
+	vector<tinyobj::shape_t>& shapes = data.shapes;
+	vector<tinyobj::material_t>& materials = data.materials;
 	// material offset: if we loaded an object before this one, material indices should not start at 0.
 	int matIdxOffset = (int)Scene::materials.size();
 	// process materials
@@ -737,12 +774,15 @@ void Mesh::SetPose( const Skin* skin )
 	{
 		uint4 j4 = joints[i];
 		float4 w4 = weights[i];
-		mat4 skinMatrix = w4.x * skin->jointMat[j4.x];
+		affine3x4 skinMatrix = w4.x * skin->jointMat[j4.x];
 		skinMatrix += w4.y * skin->jointMat[j4.y];
 		skinMatrix += w4.z * skin->jointMat[j4.z];
 		skinMatrix += w4.w * skin->jointMat[j4.w];
 		vertices[i] = skinMatrix * original[i];
-		vertexNormals[i] = normalize( make_float3( make_float4( origNormal[i], 0 ) * skinMatrix ) );
+		// normals use the transposed 3x3 part: n.x * row0 + n.y * row1 + n.z * row2
+		const float3& N = origNormal[i];
+		const float* c = skinMatrix.cell;
+		vertexNormals[i] = normalize( make_float3( N.x * c[0] + N.y * c[4] + N.z * c[8], N.x * c[1] + N.y * c[5] + N.z * c[9], N.x * c[2] + N.y * c[6] + N.z * c[10] ) );
 	}
 	// adjust full triangles
 	for (int s = (int)triangles.size(), i = 0; i < s; i++)
@@ -785,7 +825,9 @@ void Mesh::UpdateBVH()
 	if (!bvh)
 	{
 		bvh = new BVH();
-		bvh->Build( (tinybvh::bvhvec4*)vertices.data(), (uint)vertices.size() / 3 );
+		const uint triCount = (uint)vertices.size() / 3;
+		if (triCount < MTBVHTHRESHOLD) bvh->Build( (tinybvh::bvhvec4*)vertices.data(), triCount );
+		else bvh->BuildMT( (tinybvh::bvhvec4*)vertices.data(), triCount );
 	}
 	else
 	{
@@ -815,6 +857,23 @@ int Mesh::Intersect( Ray& ray )
 	return steps;
 }
 
+//  +-----------------------------------------------------------------------------+
+//  |  Mesh::IsOccluded()                                                         |
+//  |  Test the (transformed) mesh BVH for any hit closer than ray.hit.t.   LH2'24|
+//  +-----------------------------------------------------------------------------+
+bool Mesh::IsOccluded( const Ray& ray )
+{
+	// transform a copy of the ray; t is unaffected, since D is not normalized
+	Ray localRay = ray;
+	float3* O = (float3*)&localRay.O;
+	float3* D = (float3*)&localRay.D;
+	float3* rD = (float3*)&localRay.rD;
+	*O = TransformPosition( *O, invTransform );
+	*D = TransformVector( *D, invTransform );
+	*rD = float3( safercp( D->x ), safercp( D->y ), safercp( D->z ) );
+	return bvh->IsOccluded( localRay );
+}
+
 //  +-----------------------------------------------------------------------------+
 //  |  Mesh::UpdateWorldBounds()                                                  |
 //  |  Update world-space bounds over the transformed AABB.                 LH2'24|
@@ -844,7 +903,7 @@ Node::Node( const int meshIdx, const mat4& transform )
 {
 	// setup a node based on a mesh index and a transform
 	meshID = meshIdx;
-	localTransform = transform;
+	localTransform = affine3x4( transform );
 	// process light emitting surfaces
 	PrepareLights();
 }
@@ -898,7 +957,7 @@ void Node::ConvertFromGLTFNode( const tinygltf::Node& gltfNode, const int nodeBa
 	if (gltfNode.matrix.size() == 16)
 	{
 		// we get a full matrix
-		for (int i = 0; i < 4; i++) for (int j = 0; j < 4; j++) matrix.cell[i * 4 + j] = (float)gltfNode.matrix[j * 4 + i];
+		for (int i = 0; i < 3; i++) for (int j = 0; j < 4; j++) matrix.cell[i * 4 + j] = (float)gltfNode.matrix[j * 4 + i];
 		buildFromTRS = true;
 	}
 	if (gltfNode.translation.size() == 3)
@@ -931,10 +990,7 @@ void Node::ConvertFromGLTFNode( const tinygltf::Node& gltfNode, const int nodeBa
 //  +-----------------------------------------------------------------------------+
 void Node::UpdateTransformFromTRS()
 {
-	mat4 T = mat4::Translate( translation );
-	mat4 R = rotation.toMatrix();
-	mat4 S = mat4::Scale( scale );
-	localTransform = T * R * S * matrix;
+	localTransform = affine3x4::FromTRS( translation, rotation.toMatrix(), scale ) * matrix;
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -943,7 +999,7 @@ void Node::UpdateTransformFromTRS()
 //  |  child nodes. If a change is detected, the light triangles are updated      |
 //  |  as well.                                                             LH2'24|
 //  +-----------------------------------------------------------------------------+
-void Node::Update( const mat4& T )
+void Node::Update( const affine3x4& T )
 {
 	if (transformed /* true if node was affected by animation channel */)
 	{
@@ -961,8 +1017,9 @@ void Node::Update( const mat4& T )
 	if (meshID > -1)
 	{
 		Mesh* mesh = Scene::meshPool[meshID];
-		mesh->transform = combinedTransform;
-		mesh->invTransform = combinedTransform.Inverted();
+		const affine3x4 invTransform = combinedTransform.Inverted();
+		mesh->transform = combinedTransform.ToMat4();
+		mesh->invTransform = invTransform.ToMat4();
 		if (morphed /* true if bone weights were affected by animation channel */)
 		{
 			mesh->SetPose( weights );
@@ -974,7 +1031,7 @@ void Node::Update( const mat4& T )
 			for (int s = (int)skin->joints.size(), j = 0; j < s; j++)
 			{
 				Node* jointNode = Scene::nodePool[skin->joints[j]];
-				skin->jointMat[j] = mesh->invTransform * jointNode->combinedTransform * skin->inverseBindMatrices[j];
+				skin->jointMat[j] = invTransform * jointNode->combinedTransform * skin->inverseBindMatrices[j];
 			}
 			mesh->SetPose( skin ); // TODO: I hope this doesn't overwrite SetPose(weights) ?
 		}
@@ -985,6 +1042,10 @@ void Node::Update( const mat4& T )
 			mesh->UpdateWorldBounds();
 		}
 	}
+	// bounds over this node and its descendants, for hierarchical culling
+	subtreeBounds.Reset();
+	if (meshID > -1) subtreeBounds.Grow( Scene::meshPool[meshID]->worldBounds );
+	for (int s = (int)childIdx.size(), i = 0; i < s; i++) subtreeBounds.Grow( Scene::nodePool[childIdx[i]]->subtreeBounds );
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -1005,7 +1066,7 @@ void Node::PrepareLights()
 			if (mat->IsEmissive())
 			{
 				tri->UpdateArea();
-				FatTri transformedTri = TransformedFatTri( tri, localTransform );
+				FatTri transformedTri = TransformedFatTri( tri, localTransform.ToMat4() );
 				TriLight* light = new TriLight( &transformedTri, i, ID );
 				tri->ltriIdx = (int)Scene::triLights.size(); // TODO: can't duplicate a light due to this.
 				Scene::triLights.push_back( light );
@@ -1041,7 +1102,7 @@ void Node::UpdateLights()
 		{
 			// triangle is light emitting; update it
 			tri->UpdateArea();
-			FatTri transformedTri = TransformedFatTri( tri, combinedTransform );
+			FatTri transformedTri = TransformedFatTri( tri, combinedTransform.ToMat4() );
 			*Scene::triLights[tri->ltriIdx] = TriLight( &transformedTri, i, ID );
 		}
 	}
@@ -1803,6 +1864,12 @@ int Scene::AddMesh( const char* objFile, const char* dir, const float scale, con
 	Mesh* newMesh = new Mesh( objFile, dir, scale, flatShaded );
 	return AddMesh( newMesh );
 }
+int Scene::AddMesh( OBJData& data, const char* objFile, const char* dir, const float scale, const bool flatShaded )
+{
+	Mesh* newMesh = new Mesh();
+	newMesh->BuildFromOBJ( data, Mesh::OBJFileName( objFile, dir ), dir, mat4::Scale( scale ), flatShaded );
+	return AddMesh( newMesh );
+}
 
 //  +-----------------------------------------------------------------------------+
 //  |  Scene::AddMesh                                                             |
@@ -1855,15 +1922,34 @@ int Scene::AddScene( const char* sceneFile, const mat4& transform )
 }
 int Scene::AddScene( const char* sceneFile, const char* dir, const mat4& transform )
 {
-	// offsets: if we loaded an object before this one, indices should not start at 0.
-	// based on https://github.com/SaschaWillems/Vulkan-glTF-PBR/blob/master/base/VulkanglTFModel.hpp
-	const int meshBase = (int)meshPool.size();
-	const int skinBase = (int)skins.size();
 	const int retVal = (int)nodePool.size();
-	const int nodeBase = (int)nodePool.size() + 1;
 	// load gltf file
 	string cleanFileName = string( dir ) + (dir[strlen( dir ) - 1] == '/' ? "" : "/") + string( sceneFile );
+	if (cleanFileName.size() > 4 && cleanFileName.substr( cleanFileName.size() - 4, 4 ).compare( ".obj" ) == 0)
+	{
+		// ugly to have this here, but it sure does make it easier to make a scene
+		// out of a single .obj file...
+		float3 scale3( transform.cell[0], transform.cell[5], transform.cell[10] );
+		float scale = (scale3.x == scale3.y && scale3.y == scale3.z) ? scale3.x : 1.0f;
+		uint meshId = AddMesh( sceneFile, dir, scale );
+		AddInstance( AddNode( new Node( meshId, transform * mat4::Scale( 1.0f / scale ) ) ) );
+		return retVal;
+	}
 	tinygltf::Model gltfModel;
+	string error;
+	FATALERROR_IF( !LoadGLTF( sceneFile, dir, gltfModel, error ), "%s", error.c_str() );
+	return AddScene( gltfModel, sceneFile, dir, transform );
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  Scene::LoadGLTF                                                            |
+//  |  Parse a gltf file. This does not touch the scene, so it can be called      |
+//  |  from any thread (see AsyncLoader). Returns false and a message in          |
+//  |  'error' if the file could not be loaded.                             LH2'24|
+//  +-----------------------------------------------------------------------------+
+bool Scene::LoadGLTF( const char* sceneFile, const char* dir, tinygltf::Model& gltfModel, string& error )
+{
+	string cleanFileName = string( dir ) + (dir[strlen( dir ) - 1] == '/' ? "" : "/") + string( sceneFile );
 	tinygltf::TinyGLTF loader;
 	string err, warn;
 	bool ret = false;
@@ -1871,24 +1957,29 @@ int Scene::AddScene( const char* sceneFile, const char* dir, const mat4& transfo
 	{
 		string extension4 = cleanFileName.substr( cleanFileName.size() - 5, 5 );
 		string extension3 = cleanFileName.substr( cleanFileName.size() - 4, 4 );
-		if (extension3.compare( ".obj" ) == 0)
-		{
-			// ugly to have this here, but it sure does make it easier to make a scene
-			// out of a single .obj file...
-			float3 scale3( transform.cell[0], transform.cell[5], transform.cell[10] );
-			float scale = (scale3.x == scale3.y && scale3.y == scale3.z) ? scale3.x : 1.0f;
-			uint meshId = AddMesh( sceneFile, dir, scale );
-			AddInstance( AddNode( new Node( meshId, transform * mat4::Scale( 1.0f / scale ) ) ) );
-			return retVal;
-		}
-		else if (extension4.compare( ".gltf" ) == 0)
+		if (extension4.compare( ".gltf" ) == 0)
 			ret = loader.LoadASCIIFromFile( &gltfModel, &err, &warn, cleanFileName.c_str() );
 		else if (extension3.compare( ".bin" ) == 0 || extension3.compare( ".glb" ) == 0)
 			ret = loader.LoadBinaryFromFile( &gltfModel, &err, &warn, cleanFileName.c_str() );
 	}
 	if (!warn.empty()) printf( "Warn: %s\n", warn.c_str() );
 	if (!err.empty()) printf( "Err: %s\n", err.c_str() );
-	FATALERROR_IF( !ret, "could not load glTF file:\n%s", cleanFileName.c_str() );
+	if (!ret) error = "could not load glTF file:\n" + cleanFileName;
+	return ret;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  Scene::AddScene                                                            |
+//  |  Add the contents of a parsed gltf file to the scene.                 LH2'24|
+//  +-----------------------------------------------------------------------------+
+int Scene::AddScene( tinygltf::Model& gltfModel, const char* sceneFile, const char* dir, const mat4& transform )
+{
+	// offsets: if we loaded an object before this one, indices should not start at 0.
+	// based on https://github.com/SaschaWillems/Vulkan-glTF-PBR/blob/master/base/VulkanglTFModel.hpp
+	const int meshBase = (int)meshPool.size();
+	const int skinBase = (int)skins.size();
+	const int retVal = (int)nodePool.size();
+	const int nodeBase = (int)nodePool.size() + 1;
 	// convert textures
 	vector<int> texIdx;
 	for (size_t s = gltfModel.textures.size(), i = 0; i < s; i++)
@@ -1956,7 +2047,7 @@ int Scene::AddScene( const char* sceneFile, const char* dir, const mat4& transfo
 	}
 	// push an extra node that holds a transform for the gltf scene
 	Node* newNode = new Node();
-	newNode->localTransform = transform;
+	newNode->localTransform = affine3x4( transform );
 	newNode->ID = nodeBase - 1;
 	nodePool.push_back( newNode );
 	// convert nodes
@@ -2237,18 +2328,17 @@ int Scene::FindNode( const char* name )
 void Scene::SetNodeTransform( const int nodeId, const mat4& transform )
 {
 	if (nodeId < 0 || nodeId >= nodePool.size()) return;
-	nodePool[nodeId]->localTransform = transform;
+	nodePool[nodeId]->localTransform = affine3x4( transform );
 }
 
 //  +-----------------------------------------------------------------------------+
 //  |  Scene::GetNodeTransform                                                    |
 //  |  Set the local transform for the specified node.                      LH2'24|
 //  +-----------------------------------------------------------------------------+
-const mat4& Scene::GetNodeTransform( const int nodeId )
+mat4 Scene::GetNodeTransform( const int nodeId )
 {
-	static mat4 dummyIdentity;
-	if (nodeId < 0 || nodeId >= nodePool.size()) return dummyIdentity;
-	return nodePool[nodeId]->localTransform;
+	if (nodeId < 0 || nodeId >= nodePool.size()) return mat4::Identity();
+	return nodePool[nodeId]->localTransform.ToMat4();
 }
 
 //  +-----------------------------------------------------------------------------+
@@ -2368,7 +2458,7 @@ void Scene::UpdateSceneGraph( const float deltaTime )
 	for (int nodeIdx : rootNodes)
 	{
 		Node* node = nodePool[nodeIdx];
-		mat4 T;
+		affine3x4 T;
 		node->Update( T /* start with an identity matrix */ );
 	}
 	// construct TLAS
@@ -2593,4 +2683,53 @@ int Scene::Intersect( Ray& ray )
 		}
 	}
 	return steps;
+}
+
+//  +-----------------------------------------------------------------------------+
+//  |  Scene::IsOccluded                                                          |
+//  |  Test a TLAS for any hit closer than ray.hit.t; stops at the first.   LH2'24|
+//  +-----------------------------------------------------------------------------+
+bool Scene::IsOccluded( const Ray& ray )
+{
+	if (!tlas)
+	{
+		for (Mesh* mesh : meshPool) if (mesh->IsOccluded( ray )) return true;
+		return false;
+	}
+	// any hit will do, so child nodes are not sorted by distance
+	tinybvh::BVH::BVHNode* node = &tlas->bvhNode[0], * stack[128];
+	uint stackPtr = 0;
+	while (1)
+	{
+		if (node->isLeaf())
+		{
+			for (uint i = 0; i < node->triCount; i++)
+				if (meshPool[tlas->triIdx[node->leftFirst + i]]->IsOccluded( ray )) return true;
+			if (stackPtr == 0) break; else node = stack[--stackPtr];
+			continue;
+		}
+		tinybvh::BVH::BVHNode* child1 = &tlas->bvhNode[node->leftFirst];
+		tinybvh::BVH::BVHNode* child2 = &tlas->bvhNode[node->leftFirst + 1];
+		const bool hit1 = child1->Intersect( ray ) != 1e30f, hit2 = child2->Intersect( ray ) != 1e30f;
+		if (hit1 && hit2) node = child1, stack[stackPtr++] = child2;
+		else if (hit1) node = child1;
+		else if (hit2) node = child2;
+		else if (stackPtr == 0) break; else node = stack[--stackPtr];
+	}
+	return false;
+}
+
+int Scene::IsOccluded( const Ray* rays, const int count, uint* occluded )
+{
+	// one 32-bit word of results per iteration, so threads never share a word
+	int occludedCount = 0;
+#pragma omp parallel for schedule( dynamic ) reduction( +: occludedCount )
+	for (int w = 0; w < (count + 31) >> 5; w++)
+	{
+		uint bits = 0;
+		for (int i = w * 32, last = min( count, i + 32 ); i < last; i++)
+			if (IsOccluded( rays[i] )) bits |= 1u << (i & 31), occludedCount++;
+		occluded[w] = bits;
+	}
+	return occludedCount;
 }
\ No newline at end of file
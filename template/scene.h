@@ -42,6 +42,7 @@
 
 #define MIPLEVELCOUNT		5
 #define BINTEXFILEVERSION	0x10001001
+#define MTBVHTHRESHOLD		4096	// smaller meshes build their BVH on one thread; too few tasks to pay for the workers
 #define CACHEIMAGES
 
 namespace Tmpl8
@@ -116,10 +117,21 @@ public:
 	void ConvertFromGLTFSkin( const tinygltf::Skin& gltfSkin, const tinygltf::Model& gltfModel, const int nodeBase );
 	string name;
 	int skeletonRoot = 0;
-	vector<mat4> inverseBindMatrices, jointMat;
+	vector<affine3x4> inverseBindMatrices, jointMat;
 	vector<int> joints; // node indices of the joints
 };
 
+//  +-----------------------------------------------------------------------------+
+//  |  OBJData                                                                    |
+//  |  Contents of an obj file, as parsed by Mesh::ParseOBJ.                LH2'24|
+//  +-----------------------------------------------------------------------------+
+struct OBJData
+{
+	tinyobj::attrib_t attrib;
+	vector<tinyobj::shape_t> shapes;
+	vector<tinyobj::material_t> materials;
+};
+
 //  +-----------------------------------------------------------------------------+
 //  |  Mesh                                                                       |
 //  |  Mesh data storage.                                                   LH2'24|
@@ -137,6 +149,9 @@ public:
 	// methods
 	void LoadGeometry( const char* file, const char* dir, const float scale = 1.0f, const bool flatShaded = false );
 	void LoadGeometryFromOBJ( const string& fileName, const char* directory, const mat4& transform, const bool flatShaded = false );
+	static string OBJFileName( const char* file, const char* dir );
+	static bool ParseOBJ( const string& fileName, const char* directory, OBJData& data, string& error );
+	void BuildFromOBJ( OBJData& data, const string& fileName, const char* directory, const mat4& transform, const bool flatShaded = false );
 	void ConvertFromGTLFMesh( const tinygltf::Mesh& gltfMesh, const tinygltf::Model& gltfModel, const vector<int>& matIdx, const int materialOverride );
 	void BuildFromIndexedData( const vector<int>& tmpIndices, const vector<float3>& tmpVertices,
 		const vector<float3>& tmpNormals, const vector<float2>& tmpUvs, const vector<float2>& tmpUv2s,
@@ -148,6 +163,7 @@ public:
 	void UpdateBVH();
 	void UpdateWorldBounds();
 	int Intersect( tinybvh::Ray& ray );
+	bool IsOccluded( const tinybvh::Ray& ray );
 	// data members
 	string name = "unnamed";			// name for the mesh						
 	int ID = -1;						// unique ID for the mesh: position in mesh array
@@ -182,7 +198,7 @@ public:
 	~Node();
 	// methods
 	void ConvertFromGLTFNode( const tinygltf::Node& gltfNode, const int nodeBase, const int meshBase, const int skinBase );
-	void Update( const mat4& T );		// recursively update the transform of this node and its children
+	void Update( const affine3x4& T );		// recursively update the transform of this node and its children
 	void UpdateTransformFromTRS();		// process T, R, S data to localTransform
 	void PrepareLights();				// create light trianslges from detected emissive triangles
 	void UpdateLights();				// fix light triangles when the transform changes
@@ -191,9 +207,9 @@ public:
 	float3 translation = { 0 };			// T
 	quat rotation;						// R
 	float3 scale = make_float3( 1 );	// S
-	mat4 matrix;						// object transform
-	mat4 localTransform;				// = matrix * T * R * S, in case of animation
-	mat4 combinedTransform;				// transform combined with ancestor transforms
+	affine3x4 matrix;					// object transform
+	affine3x4 localTransform;			// = matrix * T * R * S, in case of animation
+	affine3x4 combinedTransform;				// transform combined with ancestor transforms
 	int ID = -1;						// unique ID for the node: position in node array
 	int meshID = -1;					// id of the mesh this node refers to (if any, -1 otherwise)
 	int skinID = -1;					// id of the skin this node refers to (if any, -1 otherwise)
@@ -204,6 +220,7 @@ public:
 	bool treeChanged = false;			// this node or one of its children got updated
 	vector<int> childIdx;				// child nodes of this node
 	TRACKCHANGES;
+	aabb subtreeBounds;					// world bounds of the meshes of this node and its descendants, for culling
 protected:
 	int instanceID = -1;				// for mesh nodes: location in the instance array. For internal use only.
 };
@@ -525,7 +542,7 @@ public:
 	static int FindNextMaterialID( const char* name, const int matID );
 	static int FindNode( const char* name );
 	static void SetNodeTransform( const int nodeId, const mat4& transform );
-	static const mat4& GetNodeTransform( const int nodeId );
+	static mat4 GetNodeTransform( const int nodeId );
 	static void ResetAnimation( const int animId );
 	static void UpdateAnimation( const int animId, const float dt );
 	static int AnimationCount() { return (int)animations.size(); }
@@ -535,6 +552,9 @@ public:
 	static int AddMesh( const char* objFile, const float scale = 1.0f, const bool flatShaded = false );
 	static int AddScene( const char* sceneFile, const mat4& transform = mat4::Identity() );
 	static int AddScene( const char* sceneFile, const char* dir, const mat4& transform );
+	static bool LoadGLTF( const char* sceneFile, const char* dir, tinygltf::Model& gltfModel, string& error );
+	static int AddScene( tinygltf::Model& gltfModel, const char* sceneFile, const char* dir, const mat4& transform );
+	static int AddMesh( OBJData& data, const char* objFile, const char* dir, const float scale = 1.0f, const bool flatShaded = false );
 	static int AddMesh( const int triCount );
 	static void AddTriToMesh( const int meshId, const float3& v0, const float3& v1, const float3& v2, const int matId );
 	static int AddQuad( const float3 N, const float3 pos, const float width, const float height, const int matId, const int meshID = -1 );
@@ -551,6 +571,10 @@ public:
 	// scene graph / TLAS operations
 	static void UpdateSceneGraph( const float deltaTime );
 	static int Intersect( tinybvh::Ray& ray );
+	// occlusion: true if anything is hit between the ray origin and ray.hit.t. The
+	// array version sets bit i of 'occluded' for ray i and returns the occluded count.
+	static bool IsOccluded( const tinybvh::Ray& ray );
+	static int IsOccluded( const tinybvh::Ray* rays, const int count, uint* occluded );
 	// data members
 	static inline vector<int> rootNodes;						// root node indices of loaded (or instanced) objects
 	static inline vector<Node*> nodePool;						// all scene nodes
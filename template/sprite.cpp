@@ -14,7 +14,28 @@ Sprite::Sprite( Surface* surface, unsigned int frameCount ) :
 	currentFrame( 0 ),
 	flags( 0 ),
 	start( new unsigned int* [frameCount] ),
-	surface( surface )
+	surface( surface ),
+	pixels( surface->pixels ),
+	pitch( surface->width ),
+	framesPerRow( frameCount ),
+	ownSurface( true )
+{
+	InitializeStartData();
+}
+
+// constructor for a sprite that references a region of a shared surface
+Sprite::Sprite( Surface* page, int x, int y, int frameWidth, int frameHeight, unsigned int frameCount, unsigned int columns ) :
+	width( frameWidth ),
+	height( frameHeight ),
+	numFrames( frameCount ),
+	currentFrame( 0 ),
+	flags( 0 ),
+	start( new unsigned int* [frameCount] ),
+	surface( page ),
+	pixels( page->pixels + x + y * page->width ),
+	pitch( page->width ),
+	framesPerRow( columns ),
+	ownSurface( false )
 {
 	InitializeStartData();
 }
@@ -22,9 +43,10 @@ Sprite::Sprite( Surface* surface, unsigned int frameCount ) :
 // destructor
 Sprite::~Sprite()
 {
-	delete surface;
-	for (unsigned int i = 0; i < numFrames; i++) delete start[i];
-	delete start;
+	if (ownSurface) delete surface;
+	for (int i = 1; i < levelCount; i++) delete level[i];
+	for (unsigned int i = 0; i < numFrames; i++) delete[] start[i];
+	delete[] start;
 }
 
 // draw sprite to target surface
@@ -34,10 +56,10 @@ void Sprite::Draw( Surface* target, int x, int y )
 	if (y < -height || y >( target->height + height )) return;
 	int x1 = x, x2 = x + width;
 	int y1 = y, y2 = y + height;
-	uint* src = GetBuffer() + currentFrame * width;
+	uint* src = GetFrameBuffer( currentFrame );
 	if (x1 < 0) src += -x1, x1 = 0;
 	if (x2 > target->width) x2 = target->width;
-	if (y1 < 0) src += -y1 * width * numFrames, y1 = 0;
+	if (y1 < 0) src += -y1 * pitch, y1 = 0;
 	if (y2 > target->height) y2 = target->height;
 	uint* dest = target->pixels;
 	int xs;
@@ -57,7 +79,7 @@ void Sprite::Draw( Surface* target, int x, int y )
 				if (c1 & 0xffffff) *(dest + addr + i) = c1;
 			}
 			addr += target->width;
-			src += width * numFrames;
+			src += pitch;
 		}
 	}
 }
@@ -65,13 +87,86 @@ void Sprite::Draw( Surface* target, int x, int y )
 // draw scaled sprite
 void Sprite::DrawScaled( int x1, int y1, int w, int h, Surface* target )
 {
-	if (width == 0 || height == 0) return;
-	for (int x = 0; x < w; x++) for (int y = 0; y < h; y++)
+	if (width == 0 || height == 0 || w <= 0 || h <= 0) return;
+	// use the smallest prebuilt level that still has at least the requested resolution
+	int l = 0;
+	while (l + 1 < levelCount && level[l + 1]->width >= w && level[l + 1]->height / (int)numFrames >= h) l++;
+	const int lw = l ? level[l]->width : width, lh = l ? level[l]->height / numFrames : height;
+	const int lpitch = l ? lw : pitch;
+	const uint* src = l ? (level[l]->pixels + currentFrame * lw * lh) : GetFrameBuffer( currentFrame );
+	// clip against the target and draw line by line
+	const int xa = max( 0, -x1 ), xb = min( w, target->width - x1 );
+	const int ya = max( 0, -y1 ), yb = min( h, target->height - y1 );
+	for (int y = ya; y < yb; y++)
+	{
+		const uint* line = src + ((y * lh) / h) * lpitch;
+		uint* dest = target->pixels + x1 + (y1 + y) * target->width;
+		for (int x = xa; x < xb; x++)
+		{
+			const uint color = line[(x * lw) / w];
+			if (color & 0xffffff) dest[x] = color;
+		}
+	}
+}
+
+// store the frames below each other, so each frame occupies a single
+// contiguous block of width * height pixels. A sprite that references a
+// shared surface (an atlas page) gets its own copy; the page is not modified.
+void Sprite::Relayout()
+{
+	if (framesPerRow == 1 && pitch == width) return; // already contiguous
+	Surface* stacked = new Surface( width, height * numFrames );
+	for (unsigned int f = 0; f < numFrames; f++)
 	{
-		int u = (int)((float)x * ((float)width / (float)w));
-		int v = (int)((float)y * ((float)height / (float)h));
-		uint color = GetBuffer()[u + v * width * numFrames];
-		if (color & 0xffffff) target->pixels[x1 + x + ((y1 + y) * target->width)] = color;
+		const uint* src = GetFrameBuffer( f );
+		uint* dst = stacked->pixels + f * width * height;
+		for (int y = 0; y < height; y++) memcpy( dst + y * width, src + y * pitch, width * sizeof( uint ) );
+	}
+	if (ownSurface) delete surface;
+	surface = stacked, ownSurface = true;
+	pixels = stacked->pixels, pitch = width, framesPerRow = 1;
+}
+
+// average of the opaque pixels in a 2x2 block; transparent if most are transparent
+static uint AverageOpaque( const uint p0, const uint p1, const uint p2, const uint p3 )
+{
+	const uint p[4] = { p0, p1, p2, p3 };
+	uint a = 0, r = 0, g = 0, b = 0, n = 0;
+	for (int i = 0; i < 4; i++) if (p[i] & 0xffffff)
+	{
+		a += p[i] >> 24, r += (p[i] >> 16) & 255, g += (p[i] >> 8) & 255, b += p[i] & 255;
+		n++;
+	}
+	if (n < 2) return 0;
+	const uint c = ((a / n) << 24) + ((r / n) << 16) + ((g / n) << 8) + (b / n);
+	return (c & 0xffffff) ? c : (c | 1); // keep opaque black pixels opaque
+}
+
+// build a chain of downscaled copies of each frame, for use by DrawScaled
+void Sprite::BuildLevels( int count )
+{
+	Relayout();
+	for (int i = 1; i < levelCount; i++) delete level[i];
+	levelCount = 1;
+	count = min( count, MAXSPRITELEVELS );
+	int sw = width, sh = height;
+	const uint* src = pixels;
+	while (levelCount < count && sw > 1 && sh > 1)
+	{
+		const int dw = sw / 2, dh = sh / 2;
+		Surface* dst = new Surface( dw, dh * numFrames );
+		for (unsigned int f = 0; f < numFrames; f++)
+		{
+			const uint* s = src + f * sw * sh;
+			uint* d = dst->pixels + f * dw * dh;
+			for (int y = 0; y < dh; y++) for (int x = 0; x < dw; x++)
+			{
+				const uint* line0 = s + y * 2 * sw + x * 2, * line1 = line0 + sw;
+				d[x + y * dw] = AverageOpaque( line0[0], line0[1], line1[0], line1[1] );
+			}
+		}
+		level[levelCount++] = dst;
+		src = dst->pixels, sw = dw, sh = dh;
 	}
 }
 
@@ -84,7 +179,7 @@ void Sprite::InitializeStartData()
 		for (int y = 0; y < height; ++y)
 		{
 			start[f][y] = width;
-			uint* addr = GetBuffer() + f * width + y * width * numFrames;
+			uint* addr = GetFrameBuffer( f ) + y * pitch;
 			for (int x = 0; x < width; ++x) if (addr[x])
 			{
 				start[f][y] = x;
@@ -4,25 +4,40 @@
 
 #pragma once
 
+#define MAXSPRITELEVELS	8
+
 namespace Tmpl8
 {
 
 // basic sprite class
+// Frames are stored side by side in a grid of 'framesPerRow' columns; the
+// pixels of a frame are accessed via a base pointer and a pitch, so a sprite
+// can reference a sub-rectangle of a larger surface, e.g. an atlas page.
+// Relayout stores each frame as a contiguous block; BuildLevels adds
+// downscaled copies of the frames, which DrawScaled uses for small sprites.
+// Note that Relayout (and therefore BuildLevels) copies the frames of a sprite
+// on a shared surface to a surface that the sprite owns: after that, changes to
+// the atlas page no longer show up in the sprite, and GetSurface returns the copy.
 class Sprite
 {
 public:
 	// structors
 	Sprite( Surface* surface, unsigned int frameCount );
+	Sprite( Surface* page, int x, int y, int frameWidth, int frameHeight, unsigned int frameCount, unsigned int columns );
 	~Sprite();
 	// methods
 	void Draw( Surface* target, int x, int y );
 	void DrawScaled( int x, int y, int width, int height, Surface* target );
+	void Relayout();
+	void BuildLevels( int count = MAXSPRITELEVELS );
 	void SetFlags( unsigned int f ) { flags = f; }
 	void SetFrame( unsigned int i ) { currentFrame = i; }
 	unsigned int GetFlags() const { return flags; }
 	int GetWidth() { return width; }
 	int GetHeight() { return height; }
-	uint* GetBuffer() { return surface->pixels; }
+	int GetPitch() { return pitch; }
+	uint* GetBuffer() { return pixels; }
+	uint* GetFrameBuffer( unsigned int frame ) { return pixels + (frame % framesPerRow) * width + (frame / framesPerRow) * height * pitch; }
 	unsigned int Frames() { return numFrames; }
 	Surface* GetSurface() { return surface; }
 	void InitializeStartData();
@@ -34,6 +49,12 @@ private:
 	unsigned int flags;
 	unsigned int** start;
 	Surface* surface;
+	uint* pixels;					// top-left pixel of the first frame
+	int pitch;						// distance between lines, in pixels
+	unsigned int framesPerRow;		// frames per line of frames
+	bool ownSurface;				// false when the surface is shared, e.g. an atlas page
+	Surface* level[MAXSPRITELEVELS] = {};	// downscaled frames; level 0 is the sprite itself
+	int levelCount = 1;
 };
 
 }
\ No newline at end of file
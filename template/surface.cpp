@@ -10,8 +10,120 @@
 #define STBI_NO_PNM
 #include "lib/stb_image.h"
 
+#include <sys/stat.h>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
 using namespace Tmpl8;
 
+#ifdef CACHESURFACESINMEMORY
+
+// process-wide cache of decoded images, keyed by path. An entry is used only
+// if the modification time of the file did not change since it was decoded.
+struct CachedImage
+{
+	time_t mtime = 0;
+	int width = 0, height = 0;
+	uint* pixels = 0;
+};
+static unordered_map<string, CachedImage> imageCache;
+static mutex imageCacheMutex;
+
+#endif
+
+// convert stb_image output to 0xAARRGGBB, four pixels at a time
+static void SwizzleRGBA( const unsigned char* src, uint* dst, const int count )
+{
+	const __m128i shuffle = _mm_setr_epi8( 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 );
+	int i = 0;
+	for (; i < (count & ~3); i += 4)
+	{
+		const __m128i rgba = _mm_loadu_si128( (const __m128i*)(src + i * 4) );
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_shuffle_epi8( rgba, shuffle ) );
+	}
+	for (; i < count; i++) dst[i] = (src[i * 4 + 3] << 24) + (src[i * 4 + 0] << 16) + (src[i * 4 + 1] << 8) + src[i * 4 + 2];
+}
+static void SwizzleRGB( const unsigned char* src, uint* dst, const int count )
+{
+	// 12 bytes in, 16 bytes out; alpha is set to zero. The last 16-byte load
+	// must stay inside the source buffer, so the tail is done in scalar code.
+	const __m128i shuffle = _mm_setr_epi8( 2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128 );
+	int i = 0;
+	for (; i + 6 <= count; i += 4)
+	{
+		const __m128i rgb = _mm_loadu_si128( (const __m128i*)(src + i * 3) );
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_shuffle_epi8( rgb, shuffle ) );
+	}
+	for (; i < count; i++) dst[i] = (src[i * 3 + 0] << 16) + (src[i * 3 + 1] << 8) + src[i * 3 + 2];
+}
+
+// decode an image file using stb_image; returns 0 if decoding failed
+static uint* DecodeImage( const char* file, int& width, int& height )
+{
+	int n;
+	unsigned char* data = stbi_load( file, &width, &height, &n, 0 );
+	if (!data) return 0;
+	uint* pixels = (uint*)MALLOC64( width * height * sizeof( uint ) );
+	const int s = width * height;
+	if (n == 1) /* greyscale */ for (int i = 0; i < s; i++)
+	{
+		const unsigned char p = data[i];
+		pixels[i] = p + (p << 8) + (p << 16);
+	}
+	else if (n == 2) /* greyscale with alpha */ for (int i = 0; i < s; i++)
+	{
+		const unsigned char p = data[i * 2];
+		pixels[i] = (data[i * 2 + 1] << 24) + p + (p << 8) + (p << 16);
+	}
+	else if (n == 4) SwizzleRGBA( data, pixels, s ); // bitmap has alpha data
+	else SwizzleRGB( data, pixels, s ); // no alpha
+	stbi_image_free( data );
+	return pixels;
+}
+
+#ifdef CACHESURFACES
+
+// decoded pixels are stored next to the image file, with a 16-byte header
+static uint* LoadSurfaceCache( const char* file, int& width, int& height )
+{
+	FILE* f = fopen( file, "rb" );
+	if (!f) return 0;
+	uint header[4];
+	uint* pixels = 0;
+	if (fread( header, 4, 4, f ) == 4 && header[0] == BINSURFACEFILEVERSION && header[1] > 0 && header[2] > 0 && header[1] <= 65536 && header[2] <= 65536)
+	{
+		const size_t s = (size_t)header[1] * header[2];
+		pixels = (uint*)MALLOC64( s * sizeof( uint ) );
+		if (fread( pixels, 4, s, f ) == s) width = (int)header[1], height = (int)header[2];
+		else FREE64( pixels ), pixels = 0; // truncated file
+	}
+	fclose( f );
+	return pixels;
+}
+static void SaveSurfaceCache( const char* file, const uint* pixels, const int width, const int height )
+{
+	// write to a temporary file, then rename it, so that threads or processes
+	// that save the same image never produce or read a partially written file
+	static atomic<int> counter( 0 );
+	char tmpFile[1024];
+	snprintf( tmpFile, sizeof( tmpFile ), "%s.%zx.%i.tmp", file, hash<thread::id>()(this_thread::get_id()), counter++ );
+	FILE* f = fopen( tmpFile, "wb" );
+	if (!f) return; // read-only location; the cache is optional
+	const uint header[4] = { BINSURFACEFILEVERSION, (uint)width, (uint)height, 0 };
+	const size_t s = (size_t)width * height;
+	const bool ok = fwrite( header, 4, 4, f ) == 4 && fwrite( pixels, 4, s, f ) == s;
+	if (fclose( f ) != 0 || !ok) { remove( tmpFile ); return; }
+#ifdef _MSC_VER
+	if (!MoveFileExA( tmpFile, file, MOVEFILE_REPLACE_EXISTING )) remove( tmpFile );
+#else
+	if (rename( tmpFile, file ) != 0) remove( tmpFile );
+#endif
+}
+
+#endif
+
 // Surface class implementation
 
 Surface::Surface( int w, int h, uint* b ) : pixels( b ), width( w ), height( h ) {}
@@ -33,28 +145,59 @@ Surface::Surface( const char* file ) : pixels( 0 ), width( 0 ), height( 0 )
 
 void Surface::LoadFromFile( const char* file )
 {
-	// use stb_image to load the image file
-	int n;
-	unsigned char* data = stbi_load( file, &width, &height, &n, 0 );
-	if (!data) return; // load failed
-	pixels = (uint*)MALLOC64( width * height * sizeof( uint ) );
-	ownBuffer = true; // needs to be deleted in destructor
-	const int s = width * height;
-	if (n == 1) /* greyscale */ for (int i = 0; i < s; i++)
+#ifdef CACHESURFACESINMEMORY
+	struct stat s;
+	if (stat( file, &s )) return; // file not found
+	// see if this file was loaded before
 	{
-		const unsigned char p = data[i];
-		pixels[i] = p + (p << 8) + (p << 16);
-	}
-	else if (n == 4) // bitmap has alpha data
-	{
-		for (int i = 0; i < s; i++) pixels[i] = (data[i * 4 + 3] << 24) + (data[i * 4 + 0] << 16) + (data[i * 4 + 1] << 8) + data[i * 4 + 2];
+		lock_guard<mutex> lock( imageCacheMutex );
+		auto it = imageCache.find( file );
+		if (it != imageCache.end() && it->second.mtime == s.st_mtime)
+		{
+			width = it->second.width, height = it->second.height;
+			pixels = (uint*)MALLOC64( width * height * sizeof( uint ) );
+			memcpy( pixels, it->second.pixels, width * height * sizeof( uint ) );
+			ownBuffer = true; // needs to be deleted in destructor
+			return;
+		}
 	}
-	else // no alpha
+#endif
+	// try the on-disk cache, then fall back to stb_image
+	uint* decoded = 0;
+#ifdef CACHESURFACES
+	const string binFile = string( file ) + ".pix";
+	// FileIsNewer fails on a missing source; leave that case to DecodeImage
+	if (FileExists( file ) && !FileIsNewer( file, binFile.c_str() )) decoded = LoadSurfaceCache( binFile.c_str(), width, height );
+	if (!decoded)
 	{
-		for (int i = 0; i < s; i++) pixels[i] = (data[i * n + 0] << 16) + (data[i * n + 1] << 8) + data[i * n + 2];
+		decoded = DecodeImage( file, width, height );
+		if (decoded) SaveSurfaceCache( binFile.c_str(), decoded, width, height );
 	}
-	// free stb_image data
-	stbi_image_free( data );
+#else
+	decoded = DecodeImage( file, width, height );
+#endif
+	if (!decoded) return; // load failed
+	pixels = decoded;
+	ownBuffer = true; // needs to be deleted in destructor
+#ifdef CACHESURFACESINMEMORY
+	// keep a copy in the cache
+	uint* copy = (uint*)MALLOC64( width * height * sizeof( uint ) );
+	memcpy( copy, decoded, width * height * sizeof( uint ) );
+	lock_guard<mutex> lock( imageCacheMutex );
+	CachedImage& entry = imageCache[file];
+	FREE64( entry.pixels );
+	entry = { s.st_mtime, width, height, copy };
+#endif
+}
+
+// release all images kept by LoadFromFile
+void Surface::FlushImageCache()
+{
+#ifdef CACHESURFACESINMEMORY
+	lock_guard<mutex> lock( imageCacheMutex );
+	for (auto& entry : imageCache) FREE64( entry.second.pixels );
+	imageCache.clear();
+#endif
 }
 
 Surface::~Surface()
@@ -246,4 +389,49 @@ void Surface::InitCharset()
 	int i;
 	for (i = 0; i < 256; i++) transl[i] = 45;
 	for (i = 0; i < 50; i++) transl[(unsigned char)c[i]] = i;
+}
+
+// FloatSurface class implementation
+
+FloatSurface::FloatSurface( int w, int h ) : width( w ), height( h )
+{
+	pixels = (float4*)MALLOC64( w * h * sizeof( float4 ) );
+}
+
+FloatSurface::~FloatSurface()
+{
+	FREE64( pixels );
+}
+
+void FloatSurface::Clear( const float4& c )
+{
+	const int s = width * height;
+	for (int i = 0; i < s; i++) pixels[i] = c;
+}
+
+// FloatSurface::CopyFrom: Convert a 32-bit surface to floating point, mapping
+// each channel from 0..255 to 0..1. Both surfaces must have the same size.
+void FloatSurface::CopyFrom( const Surface* src )
+{
+	const __m128 scale4 = _mm_set1_ps( 1.0f / 255.0f );
+	const int s = min( width * height, src->width * src->height );
+	for (int i = 0; i < s; i++)
+	{
+		const __m128i c4 = _mm_cvtepu8_epi32( _mm_cvtsi32_si128( (int)src->pixels[i] ) );
+		_mm_store_ps( &pixels[i].x, _mm_mul_ps( _mm_cvtepi32_ps( c4 ), scale4 ) );
+	}
+}
+
+// FloatSurface::CopyTo: Convert back to 32-bit, with clamping. Channel order
+// is preserved: x = blue, y = green, z = red, w = alpha.
+void FloatSurface::CopyTo( Surface* dst ) const
+{
+	const __m128 scale4 = _mm_set1_ps( 255.0f );
+	const int s = min( width * height, dst->width * dst->height );
+	for (int i = 0; i < s; i++)
+	{
+		const __m128i c4 = _mm_cvtps_epi32( _mm_mul_ps( _mm_load_ps( &pixels[i].x ), scale4 ) );
+		const __m128i c8 = _mm_packus_epi32( c4, c4 );
+		dst->pixels[i] = (uint)_mm_cvtsi128_si32( _mm_packus_epi16( c8, c8 ) );
+	}
 }
\ No newline at end of file
@@ -7,6 +7,16 @@
 namespace Tmpl8
 {
 
+// optional image caches, both off by default:
+// CACHESURFACES stores decoded images on disk, next to the original file
+// (file.png.pix, uncompressed: 16MB for a 2048x2048 image);
+// CACHESURFACESINMEMORY keeps a copy of each decoded image in memory, until
+// FlushImageCache, so that loading the same file again is a memcpy. Note that
+// CACHEIMAGES in scene.h is unrelated: it controls the texture cache.
+// #define CACHESURFACES
+// #define CACHESURFACESINMEMORY
+#define BINSURFACEFILEVERSION	0x10000001
+
 // helper macro for line clipping
 #define OUTCODE(x,y) (((x)<xmin)?1:(((x)>xmax)?2:0))+(((y)<ymin)?4:(((y)>ymax)?8:0))
 
@@ -64,6 +74,7 @@ public:
 	void Line( float x1, float y1, float x2, float y2, uint c );
 	void Plot( int x, int y, uint c );
 	void LoadFromFile( const char* file );
+	static void FlushImageCache();
 	void CopyTo( Surface* dst, int x, int y );
 	void Box( int x1, int y1, int x2, int y2, uint color );
 	void Bar( int x1, int y1, int x2, int y2, uint color );
@@ -77,6 +88,25 @@ public:
 	static inline bool fontInitialized = false;
 };
 
+// 128-bit (floating point) surface container
+class FloatSurface
+{
+public:
+	// constructor / destructor
+	FloatSurface() = default;
+	FloatSurface( int w, int h );
+	~FloatSurface();
+	FloatSurface( const FloatSurface& ) = delete; // owns its pixels; copying would free them twice
+	FloatSurface& operator=( const FloatSurface& ) = delete;
+	// operations
+	void Clear( const float4& c );
+	void CopyFrom( const Surface* src );
+	void CopyTo( Surface* dst ) const;
+	// attributes
+	float4* pixels = 0;
+	int width = 0, height = 0;
+};
+
 // 8-bit (paletized) surface container
 class Surface8
 {
@@ -27,7 +27,7 @@ extern "C"
 
 GLFWwindow* window = 0;
 GLFWwindow* GetGLFWWindow() { return window; }
-static bool hasFocus = true, running = true;
+static bool hasFocus = true, running = true, windowDamaged = false;
 static GLTexture* renderTarget = 0;
 static int scrwidth = 0, scrheight = 0;
 static TheApp* app = 0;
@@ -45,17 +45,42 @@ bool WindowHasFocus() { return hasFocus; }
 // provide access to key state array
 bool IsKeyDown( const uint key ) { return keystate[key & 511] == 1; }
 
+// dynamic resolution controller: adjust the internal resolution of the screen
+// surface so the time spent in Tick approaches the target frame time. Render
+// cost is assumed to be proportional to pixel count; the scale is changed
+// only when the smoothed frame time leaves a band around the target, and by
+// at most 10% per frame, to prevent oscillation.
+void UpdateScreenScale( const float tickTime )
+{
+	static float smoothed = 0;
+	static int hold = 0;
+	smoothed = smoothed == 0 ? tickTime : (0.9f * smoothed + 0.1f * tickTime);
+	const float target = app->targetFrameTime;
+	float scale = app->screenScale;
+	if (hold > 0) hold--; else if (smoothed > target * 1.05f || (smoothed < target * 0.8f && scale < 1))
+	{
+		const float adjust = clamp( sqrtf( target / max( smoothed, 0.01f ) ), 0.9f, 1.1f );
+		scale = clamp( scale * adjust, app->minScreenScale, 1.0f );
+		smoothed = 0, hold = 8; // measure a few frames at the new resolution
+	}
+	app->screenScale = scale;
+	app->screen->width = scale < 1 ? ((int)(SCRWIDTH * scale) & ~3) : SCRWIDTH;
+	app->screen->height = scale < 1 ? (int)(SCRHEIGHT * scale) : SCRHEIGHT;
+}
+
 // GLFW callbacks
 void InitRenderTarget( int w, int h )
 {
 	// allocate render target and surface
 	scrwidth = w, scrheight = h;
-	renderTarget = new GLTexture( scrwidth, scrheight, GLTexture::INTTARGET );
+	renderTarget = new GLTexture( scrwidth, scrheight, GLTexture::STREAMTARGET );
 }
 void ReshapeWindowCallback( GLFWwindow*, int w, int h )
 {
 	glViewport( 0, 0, w, h );
+	windowDamaged = true;
 }
+void WindowRefreshCallback( GLFWwindow* ) { windowDamaged = true; }
 void KeyEventCallback( GLFWwindow*, int key, int, int action, int )
 {
 	if (key == GLFW_KEY_ESCAPE) running = false;
@@ -102,6 +127,7 @@ int main()
 	glfwMakeContextCurrent( window );
 	// register callbacks
 	glfwSetWindowSizeCallback( window, ReshapeWindowCallback );
+	glfwSetWindowRefreshCallback( window, WindowRefreshCallback );
 	glfwSetKeyCallback( window, KeyEventCallback );
 	glfwSetWindowFocusCallback( window, WindowFocusCallback );
 	glfwSetMouseButtonCallback( window, MouseButtonCallback );
@@ -139,6 +165,7 @@ int main()
 	Surface* screen = new Surface( SCRWIDTH, SCRHEIGHT );
 	app = new Game();
 	app->screen = screen;
+	app->pacer = new FramePacer();
 	app->Init();
 	// done, enter main loop
 #if 0
@@ -202,10 +229,15 @@ int main()
 		fs, true );
 #else
 #if 1
-	// basic shader, no gamma correction
+	// basic shader, no gamma correction. For dynamic resolution, uv is scaled
+	// by s to the part of the texture that was rendered, and the result is
+	// sharpened with strength k.
 	Shader* shader = new Shader(
 		"#version 330\nin vec4 p;\nout vec2 u;void main(){u=vec2((p.x+1)/2,1-(p.y+1)/2);gl_Position=vec4(p.x,p.y,1,1);}",
-		"#version 330\nuniform sampler2D c;in vec2 u;out vec4 f;void main(){f=texture(c,u);}", true );
+		"#version 330\nuniform sampler2D c;uniform vec2 s;uniform float k;in vec2 u;out vec4 f;void main(){"
+		"vec2 r=1.0/textureSize(c,0),t=clamp(u*s,0.5*r,s-0.5*r);vec4 a=texture(c,t);if(k>0){"
+		"vec4 n=texture(c,t-vec2(r.x,0))+texture(c,t+vec2(r.x,0))+texture(c,t-vec2(0,r.y))+texture(c,t+vec2(0,r.y));"
+		"a=clamp(a+k*(a-0.25*n),0.0,1.0);}f=a;}", true );
 #else
 	// fxaa shader
 	Shader* shader = new Shader(
@@ -332,20 +364,33 @@ int main()
 	static Timer timer;
 	while (!glfwWindowShouldClose( window ))
 	{
-		deltaTime = min( 500.0f, 1000.0f * timer.elapsed() );
+		deltaTime = app->pacer->FrameStart();
 		timer.reset();
 		app->Tick( deltaTime );
+		const bool present = !app->idlePresent || app->screenChanged;
+		const float tickTime = 1000.0f * timer.elapsed();
 		// send the rendering result to the screen using OpenGL
 		if (frameNr++ > 1)
 		{
-			if (app->screen) renderTarget->CopyFrom( app->screen );
-			shader->Bind();
-			shader->SetInputTexture( 0, "c", renderTarget );
-			DrawQuad();
-			shader->Unbind();
-			glfwSwapBuffers( window );
-			glfwPollEvents();
+			if (present || windowDamaged)
+			{
+				// a damaged window is repainted from the render target; no upload needed
+				// the render target keeps the size of the last uploaded frame for repaints
+				static int2 shownSize = make_int2( SCRWIDTH, SCRHEIGHT );
+				if (present && app->screen) renderTarget->CopyFrom( app->screen ), shownSize = make_int2( app->screen->width, app->screen->height );
+				shader->Bind();
+				shader->SetInputTexture( 0, "c", renderTarget );
+				shader->SetFloat2( "s", (float)shownSize.x / SCRWIDTH, (float)shownSize.y / SCRHEIGHT );
+				shader->SetFloat( "k", app->screenScale < 1 ? app->sharpen : 0 );
+				DrawQuad();
+				shader->Unbind();
+				glfwSwapBuffers( window );
+			}
+			app->screenChanged = windowDamaged = false;
+			if (present) glfwPollEvents(); else glfwWaitEventsTimeout( 0.001 * app->idleTimeout );
 		}
+		// resize only after presenting: the frame above was drawn at the old size
+		if (present && app->dynamicResolution) UpdateScreenScale( tickTime );
 		if (!running) break;
 	}
 	// close down
@@ -6,13 +6,17 @@
 // math library defined in tmpl8math.h.
 
 #include "precomp.h"
+#include <atomic>
 
 // random number generator - Marsaglia's xor32
 // This is a high-quality RNG that uses a single 32-bit seed. More info:
 // https://www.researchgate.net/publication/5142825_Xorshift_RNGs
 
-// RNG seed. NOTE: in a multithreaded application, don't use a single seed!
-static uint seed = 0x12345678;
+// RNG seed. Each thread has its own seed; the first thread that calls
+// RandomUInt gets the classic seed, so single-threaded sequences do not change.
+// For heavy use, see the generators in rng.h.
+static atomic<uint> seedCount = 0;
+static thread_local uint seed = [] { const uint i = seedCount++; return i == 0 ? 0x12345678u : InitSeed( i ); }();
 
 // WangHash: calculates a high-quality seed based on an arbitrary non-zero
 // integer. Use this to create your own seed based on e.g. thread index.
@@ -81,7 +85,10 @@ static float SmoothedNoise( const int i, const int x, const int y )
 }
 static float Interpolate( const float a, const float b, const float x )
 {
-	const float ft = x * 3.1415927f, f = (1 - cosf( ft )) * 0.5f;
+	// cosine interpolation: (1 - cos( pi x )) / 2 = (1 + sin( pi (|x| - 1/2) )) / 2; the
+	// sine is a 7th order series, which stays within 1e-4 of the cosf version
+	const float t = (fabsf( x ) - 0.5f) * 3.1415927f, t2 = t * t;
+	const float f = 0.5f + 0.5f * t * (1 - t2 * (1.0f / 6 - t2 * (1.0f / 120 - t2 * (1.0f / 5040))));
 	return a * (1 - f) + b * f;
 }
 static float InterpolatedNoise( const int i, const float x, const float y )
@@ -160,38 +167,193 @@ uint4::uint4( const uint3& a, const uint d )
 	x = a.x, y = a.y, z = a.z;
 	w = d;
 }
+// mat4 operations, using SSE; rows are 16-byte aligned
 mat4 operator*( const mat4& a, const mat4& b )
 {
+	// each row of the result is a linear combination of the rows of b
 	mat4 r;
-	for (uint i = 0; i < 16; i += 4)
-		for (uint j = 0; j < 4; ++j)
-		{
-			r[i + j] =
-				(a.cell[i + 0] * b.cell[j + 0]) +
-				(a.cell[i + 1] * b.cell[j + 4]) +
-				(a.cell[i + 2] * b.cell[j + 8]) +
-				(a.cell[i + 3] * b.cell[j + 12]);
-		}
+	const __m128 b0 = _mm_load_ps( b.cell ), b1 = _mm_load_ps( b.cell + 4 );
+	const __m128 b2 = _mm_load_ps( b.cell + 8 ), b3 = _mm_load_ps( b.cell + 12 );
+	for (int i = 0; i < 16; i += 4)
+	{
+		const __m128 row = _mm_add_ps(
+			_mm_add_ps( _mm_mul_ps( _mm_set1_ps( a.cell[i] ), b0 ), _mm_mul_ps( _mm_set1_ps( a.cell[i + 1] ), b1 ) ),
+			_mm_add_ps( _mm_mul_ps( _mm_set1_ps( a.cell[i + 2] ), b2 ), _mm_mul_ps( _mm_set1_ps( a.cell[i + 3] ), b3 ) ) );
+		_mm_store_ps( r.cell + i, row );
+	}
 	return r;
 }
 mat4 operator*( const mat4& a, const float s )
 {
 	mat4 r;
-	for (uint i = 0; i < 16; i += 4) r.cell[i] = a.cell[i] * s;
+	const __m128 s4 = _mm_set1_ps( s );
+	for (int i = 0; i < 16; i += 4) _mm_store_ps( r.cell + i, _mm_mul_ps( _mm_load_ps( a.cell + i ), s4 ) );
 	return r;
 }
-mat4 operator*( const float s, const mat4& a )
+mat4 operator*( const float s, const mat4& a ) { return a * s; }
+mat4 operator+( const mat4& a, const mat4& b )
 {
 	mat4 r;
-	for (uint i = 0; i < 16; i++) r.cell[i] = a.cell[i] * s;
+	for (int i = 0; i < 16; i += 4) _mm_store_ps( r.cell + i, _mm_add_ps( _mm_load_ps( a.cell + i ), _mm_load_ps( b.cell + i ) ) );
 	return r;
 }
-mat4 operator+( const mat4& a, const mat4& b )
+
+// general 4x4 inverse using 2x2 blocks, after Eric Zhang, "Fast 4x4 matrix
+// inverse with SSE SIMD, explained". A 2x2 matrix is stored in a __m128 as
+// (m00, m01, m10, m11).
+#define SHUFFLE4( a, b, x, y, z, w ) _mm_shuffle_ps( a, b, _MM_SHUFFLE( w, z, y, x ) )
+#define SWIZZLE4( a, x, y, z, w ) SHUFFLE4( a, a, x, y, z, w )
+static inline __m128 Mat2Mul( const __m128 a, const __m128 b ) // a * b
+{
+	return _mm_add_ps( _mm_mul_ps( a, SWIZZLE4( b, 0, 3, 0, 3 ) ), _mm_mul_ps( SWIZZLE4( a, 1, 0, 3, 2 ), SWIZZLE4( b, 2, 1, 2, 1 ) ) );
+}
+static inline __m128 Mat2AdjMul( const __m128 a, const __m128 b ) // adjugate( a ) * b
+{
+	return _mm_sub_ps( _mm_mul_ps( SWIZZLE4( a, 3, 3, 0, 0 ), b ), _mm_mul_ps( SWIZZLE4( a, 1, 1, 2, 2 ), SWIZZLE4( b, 2, 3, 0, 1 ) ) );
+}
+static inline __m128 Mat2MulAdj( const __m128 a, const __m128 b ) // a * adjugate( b )
+{
+	return _mm_sub_ps( _mm_mul_ps( a, SWIZZLE4( b, 3, 0, 3, 0 ) ), _mm_mul_ps( SWIZZLE4( a, 1, 0, 3, 2 ), SWIZZLE4( b, 2, 1, 2, 1 ) ) );
+}
+mat4 mat4::Inverted() const
+{
+	const __m128 r0 = _mm_load_ps( cell ), r1 = _mm_load_ps( cell + 4 ), r2 = _mm_load_ps( cell + 8 ), r3 = _mm_load_ps( cell + 12 );
+	// the four 2x2 blocks: | A B |
+	//                      | C D |
+	const __m128 A = _mm_movelh_ps( r0, r1 ), B = _mm_movehl_ps( r1, r0 );
+	const __m128 C = _mm_movelh_ps( r2, r3 ), D = _mm_movehl_ps( r3, r2 );
+	// determinants of the blocks: ( |A|, |B|, |C|, |D| )
+	const __m128 detSub = _mm_sub_ps( _mm_mul_ps( SHUFFLE4( r0, r2, 0, 2, 0, 2 ), SHUFFLE4( r1, r3, 1, 3, 1, 3 ) ),
+		_mm_mul_ps( SHUFFLE4( r0, r2, 1, 3, 1, 3 ), SHUFFLE4( r1, r3, 0, 2, 0, 2 ) ) );
+	const __m128 detA = SWIZZLE4( detSub, 0, 0, 0, 0 ), detB = SWIZZLE4( detSub, 1, 1, 1, 1 );
+	const __m128 detC = SWIZZLE4( detSub, 2, 2, 2, 2 ), detD = SWIZZLE4( detSub, 3, 3, 3, 3 );
+	// adjugates of the blocks of the inverse
+	const __m128 D_C = Mat2AdjMul( D, C ), A_B = Mat2AdjMul( A, B );
+	__m128 X = _mm_sub_ps( _mm_mul_ps( detD, A ), Mat2Mul( B, D_C ) );
+	__m128 W = _mm_sub_ps( _mm_mul_ps( detA, D ), Mat2Mul( C, A_B ) );
+	__m128 Y = _mm_sub_ps( _mm_mul_ps( detB, C ), Mat2MulAdj( D, A_B ) );
+	__m128 Z = _mm_sub_ps( _mm_mul_ps( detC, B ), Mat2MulAdj( A, D_C ) );
+	// determinant: |A||D| + |B||C| - tr( (A#B)(D#C) )
+	__m128 tr = _mm_mul_ps( A_B, SWIZZLE4( D_C, 0, 2, 1, 3 ) );
+	tr = _mm_add_ps( tr, _mm_movehl_ps( tr, tr ) );
+	tr = _mm_add_ss( tr, SWIZZLE4( tr, 1, 1, 1, 1 ) );
+	const float det = _mm_cvtss_f32( _mm_sub_ss( _mm_add_ss( _mm_mul_ss( detA, detD ), _mm_mul_ss( detB, detC ) ), tr ) );
+	if (det == 0) return mat4();
+	const __m128 rcpDet = _mm_div_ps( _mm_setr_ps( 1, -1, -1, 1 ), _mm_set1_ps( det ) );
+	X = _mm_mul_ps( X, rcpDet ), Y = _mm_mul_ps( Y, rcpDet );
+	Z = _mm_mul_ps( Z, rcpDet ), W = _mm_mul_ps( W, rcpDet );
+	// combine the adjugate shuffle with the final layout
+	mat4 r;
+	_mm_store_ps( r.cell, SHUFFLE4( X, Y, 3, 1, 3, 1 ) );
+	_mm_store_ps( r.cell + 4, SHUFFLE4( X, Y, 2, 0, 2, 0 ) );
+	_mm_store_ps( r.cell + 8, SHUFFLE4( Z, W, 3, 1, 3, 1 ) );
+	_mm_store_ps( r.cell + 12, SHUFFLE4( Z, W, 2, 0, 2, 0 ) );
+	return r;
+}
+
+// affine inverse: the columns of the inverse of the 3x3 part are the cross
+// products of its rows, divided by the determinant; the translation becomes
+// -inverse( 3x3 ) * t.
+static inline __m128 Cross4( const __m128 a, const __m128 b )
+{
+	const __m128 c = _mm_sub_ps( _mm_mul_ps( a, SWIZZLE4( b, 1, 2, 0, 3 ) ), _mm_mul_ps( SWIZZLE4( a, 1, 2, 0, 3 ), b ) );
+	return SWIZZLE4( c, 1, 2, 0, 3 );
+}
+mat4 mat4::InvertedAffine() const
 {
+	const __m128 mask = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+	const __m128 r0 = _mm_load_ps( cell ), r1 = _mm_load_ps( cell + 4 ), r2 = _mm_load_ps( cell + 8 );
+	const __m128 a = _mm_and_ps( r0, mask ), b = _mm_and_ps( r1, mask ), c = _mm_and_ps( r2, mask );
+	__m128 c0 = Cross4( b, c ), c1 = Cross4( c, a ), c2 = Cross4( a, b ), c3 = _mm_setzero_ps();
+	__m128 d = _mm_mul_ps( a, c0 );
+	d = _mm_add_ps( d, _mm_movehl_ps( d, d ) );
+	const float det = _mm_cvtss_f32( _mm_add_ss( d, SWIZZLE4( d, 1, 1, 1, 1 ) ) );
+	if (det == 0) return mat4();
+	const __m128 rcpDet = _mm_set1_ps( 1.0f / det );
+	c0 = _mm_mul_ps( c0, rcpDet ), c1 = _mm_mul_ps( c1, rcpDet ), c2 = _mm_mul_ps( c2, rcpDet );
+	_MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+	// translation: -R * t, where t is the last column of the input
+	const __m128 t = _mm_setr_ps( cell[3], cell[7], cell[11], 0 );
 	mat4 r;
-	for (uint i = 0; i < 16; i += 4) r.cell[i] = a.cell[i] + b.cell[i];
+	_mm_store_ps( r.cell, c0 ), _mm_store_ps( r.cell + 4, c1 ), _mm_store_ps( r.cell + 8, c2 );
+	for (int i = 0; i < 3; i++)
+	{
+		__m128 v = _mm_mul_ps( _mm_load_ps( r.cell + i * 4 ), t );
+		v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+		r.cell[i * 4 + 3] = -_mm_cvtss_f32( _mm_add_ss( v, SWIZZLE4( v, 1, 1, 1, 1 ) ) );
+	}
 	return r;
 }
+// affine3x4: products and inverses on the three rows; the implicit bottom
+// row (0, 0, 0, 1) only contributes the translation of the left operand.
+affine3x4 operator*( const affine3x4& a, const affine3x4& b )
+{
+	const __m128 b0 = b.Row( 0 ), b1 = b.Row( 1 ), b2 = b.Row( 2 );
+	const __m128 wmask = _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) );
+	affine3x4 r;
+	for (int i = 0; i < 3; i++)
+	{
+		const __m128 ai = a.Row( i );
+		__m128 v = _mm_and_ps( ai, wmask );
+		v = _mm_add_ps( v, _mm_mul_ps( SWIZZLE4( ai, 0, 0, 0, 0 ), b0 ) );
+		v = _mm_add_ps( v, _mm_mul_ps( SWIZZLE4( ai, 1, 1, 1, 1 ), b1 ) );
+		v = _mm_add_ps( v, _mm_mul_ps( SWIZZLE4( ai, 2, 2, 2, 2 ), b2 ) );
+		_mm_store_ps( r.cell + i * 4, v );
+	}
+	return r;
+}
+affine3x4 operator*( const float s, const affine3x4& a )
+{
+	const __m128 s4 = _mm_set1_ps( s );
+	affine3x4 r;
+	for (int i = 0; i < 3; i++) _mm_store_ps( r.cell + i * 4, _mm_mul_ps( a.Row( i ), s4 ) );
+	return r;
+}
+float4 operator*( const affine3x4& a, const float4& b )
+{
+	const __m128 b4 = _mm_load_ps( &b.x );
+	__m128 v0 = _mm_mul_ps( a.Row( 0 ), b4 ), v1 = _mm_mul_ps( a.Row( 1 ), b4 );
+	__m128 v2 = _mm_mul_ps( a.Row( 2 ), b4 ), v3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS( v0, v1, v2, v3 );
+	float4 r;
+	_mm_store_ps( &r.x, _mm_add_ps( _mm_add_ps( v0, v1 ), _mm_add_ps( v2, v3 ) ) );
+	r.w = b.w;
+	return r;
+}
+// the inverse rows and translation are built as columns, then transposed:
+// column j of inverse( 3x3 ) is c_j, and the translation -inverse( 3x3 ) * t
+// is the sum of t_j * c_j.
+static inline affine3x4 AffineFromColumns( __m128 c0, __m128 c1, __m128 c2, const affine3x4& M, const __m128 scale )
+{
+	const __m128 tx = SWIZZLE4( M.Row( 0 ), 3, 3, 3, 3 ), ty = SWIZZLE4( M.Row( 1 ), 3, 3, 3, 3 ), tz = SWIZZLE4( M.Row( 2 ), 3, 3, 3, 3 );
+	__m128 c3 = _mm_sub_ps( _mm_setzero_ps(), _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, c0 ), _mm_mul_ps( ty, c1 ) ), _mm_mul_ps( tz, c2 ) ) );
+	_MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+	affine3x4 r;
+	_mm_store_ps( r.cell, _mm_mul_ps( c0, scale ) );
+	_mm_store_ps( r.cell + 4, _mm_mul_ps( c1, scale ) );
+	_mm_store_ps( r.cell + 8, _mm_mul_ps( c2, scale ) );
+	return r;
+}
+affine3x4 affine3x4::Inverted() const
+{
+	const __m128 mask = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+	const __m128 a = _mm_and_ps( Row( 0 ), mask ), b = _mm_and_ps( Row( 1 ), mask ), c = _mm_and_ps( Row( 2 ), mask );
+	const __m128 c0 = Cross4( b, c ), c1 = Cross4( c, a ), c2 = Cross4( a, b );
+	__m128 d = _mm_mul_ps( a, c0 );
+	d = _mm_add_ps( d, _mm_movehl_ps( d, d ) );
+	const float det = _mm_cvtss_f32( _mm_add_ss( d, SWIZZLE4( d, 1, 1, 1, 1 ) ) );
+	if (det == 0) return affine3x4();
+	return AffineFromColumns( c0, c1, c2, *this, _mm_set1_ps( 1.0f / det ) );
+}
+affine3x4 affine3x4::InvertedRigid() const
+{
+	// the columns of the inverse rotation are the rows of the rotation
+	const __m128 mask = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+	return AffineFromColumns( _mm_and_ps( Row( 0 ), mask ), _mm_and_ps( Row( 1 ), mask ), _mm_and_ps( Row( 2 ), mask ), *this, _mm_set1_ps( 1 ) );
+}
+#undef SWIZZLE4
+#undef SHUFFLE4
+
 bool operator==( const mat4& a, const mat4& b )
 {
 	for (uint i = 0; i < 16; i++)
@@ -225,15 +387,15 @@ float3 TransformVector( const float3& a, const mat4& M )
 // Fast matrix-vector multiplication using SSE
 float3 TransformPosition_SSE( const __m128& a, const mat4& M )
 {
-	__m128 a4 = a;
-	a4.m128_f32[3] = 1;
+	const __m128 a4 = _mm_or_ps( _mm_and_ps( a, _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) ) ), _mm_setr_ps( 0, 0, 0, 1 ) );
 	__m128 v0 = _mm_mul_ps( a4, _mm_load_ps( &M.cell[0] ) );
 	__m128 v1 = _mm_mul_ps( a4, _mm_load_ps( &M.cell[4] ) );
 	__m128 v2 = _mm_mul_ps( a4, _mm_load_ps( &M.cell[8] ) );
 	__m128 v3 = _mm_mul_ps( a4, _mm_load_ps( &M.cell[12] ) );
 	_MM_TRANSPOSE4_PS( v0, v1, v2, v3 );
-	__m128 v = _mm_add_ps( _mm_add_ps( v0, v1 ), _mm_add_ps( v2, v3 ) );
-	return float3( v.m128_f32[0], v.m128_f32[1], v.m128_f32[2] );
+	union { __m128 v; float f[4]; };
+	v = _mm_add_ps( _mm_add_ps( v0, v1 ), _mm_add_ps( v2, v3 ) );
+	return float3( f[0], f[1], f[2] );
 }
 float3 TransformVector_SSE( const __m128& a, const mat4& M )
 {
@@ -242,8 +404,66 @@ float3 TransformVector_SSE( const __m128& a, const mat4& M )
 	__m128 v2 = _mm_mul_ps( a, _mm_load_ps( &M.cell[8] ) );
 	__m128 v3 = _mm_mul_ps( a, _mm_load_ps( &M.cell[12] ) );
 	_MM_TRANSPOSE4_PS( v0, v1, v2, v3 );
-	__m128 v = _mm_add_ps( _mm_add_ps( v0, v1 ), v2 );
-	return float3( v.m128_f32[0], v.m128_f32[1], v.m128_f32[2] );
+	union { __m128 v; float f[4]; };
+	v = _mm_add_ps( _mm_add_ps( v0, v1 ), v2 );
+	return float3( f[0], f[1], f[2] );
+}
+
+// batch transforms: process N elements at a time in structure-of-arrays
+// form, using the widest lane type the CPU supports; the rest is scalar.
+template <class T> static int TransformBatch( const mat4& M, const float3* in, float3* out, const int n, const bool position )
+{
+	const T w = position ? 1.0f : 0.0f;
+	int i = 0;
+	for (; i + T::lanes <= n; i += T::lanes)
+	{
+		const wide3<T> v = wide3<T>::Load( in + i );
+		wide3<T> r;
+		r.x = madd( T( M[0] ), v.x, madd( T( M[1] ), v.y, madd( T( M[2] ), v.z, T( M[3] ) * w ) ) );
+		r.y = madd( T( M[4] ), v.x, madd( T( M[5] ), v.y, madd( T( M[6] ), v.z, T( M[7] ) * w ) ) );
+		r.z = madd( T( M[8] ), v.x, madd( T( M[9] ), v.y, madd( T( M[10] ), v.z, T( M[11] ) * w ) ) );
+		r.Store( out + i );
+	}
+	return i;
+}
+template <class T> static int TransformBatch( const mat4& M, const float4* in, float4* out, const int n, const bool position )
+{
+	int i = 0;
+	for (; i + T::lanes <= n; i += T::lanes)
+	{
+		const wide4<T> v = wide4<T>::Load( in + i );
+		wide4<T> r;
+		const T w = position ? v.w : T( 0 );
+		r.x = madd( T( M[0] ), v.x, madd( T( M[1] ), v.y, madd( T( M[2] ), v.z, T( M[3] ) * w ) ) );
+		r.y = madd( T( M[4] ), v.x, madd( T( M[5] ), v.y, madd( T( M[6] ), v.z, T( M[7] ) * w ) ) );
+		r.z = madd( T( M[8] ), v.x, madd( T( M[9] ), v.y, madd( T( M[10] ), v.z, T( M[11] ) * w ) ) );
+		r.w = position ? madd( T( M[12] ), v.x, madd( T( M[13] ), v.y, madd( T( M[14] ), v.z, T( M[15] ) * w ) ) ) : v.w;
+		r.Store( out + i );
+	}
+	return i;
+}
+template <class V> static int TransformWide( const mat4& M, const V* in, V* out, const int n, const bool position )
+{
+#ifdef SIMD_F32X8
+	if (CPUCaps::HW_AVX2 && CPUCaps::HW_FMA3) return TransformBatch<f32x8>( M, in, out, n, position );
+#endif
+	return TransformBatch<f32x4>( M, in, out, n, position );
+}
+void TransformPositions( const mat4& M, const float3* in, float3* out, const int n )
+{
+	for (int i = TransformWide( M, in, out, n, true ); i < n; i++) out[i] = TransformPosition( in[i], M );
+}
+void TransformVectors( const mat4& M, const float3* in, float3* out, const int n )
+{
+	for (int i = TransformWide( M, in, out, n, false ); i < n; i++) out[i] = TransformVector( in[i], M );
+}
+void TransformPositions( const mat4& M, const float4* in, float4* out, const int n )
+{
+	for (int i = TransformWide( M, in, out, n, true ); i < n; i++) out[i] = M * in[i];
+}
+void TransformVectors( const mat4& M, const float4* in, float4* out, const int n )
+{
+	for (int i = TransformWide( M, in, out, n, false ); i < n; i++) out[i] = make_float4( TransformVector( make_float3( in[i] ), M ), in[i].w );
 }
 
 // 16-bit floats
@@ -258,4 +478,101 @@ half float_to_half( const float x )
 {
 	const uint b = as_uint( x ) + 0x00001000, e = (b & 0x7F800000) >> 23, m = b & 0x007FFFFF;
 	return (half)((b & 0x80000000) >> 16 | (e > 112) * ((((e - 112) << 10) & 0x7C00) | m >> 13) | ((e < 113) & (e > 101)) * ((((0x007FF000 + m) >> (125 - e)) + 1) >> 1) | (e > 143) * 0x7FFF); // sign : normalized : denormalized : saturate
-}
\ No newline at end of file
+}
+
+// half-float arrays. The SSE2 versions follow Fabian Giesen's branchless
+// conversions (https://gist.github.com/rygorous/2156668) and produce the same
+// bits as F16C: round to nearest even, overflow to infinity, denormals kept,
+// NaNs quieted with their upper payload bits preserved.
+#if defined( _MSC_VER ) || defined( __F16C__ )
+#define HALF_F16C
+#endif
+static __m128 HalfToFloat4( const __m128i h ) // four halves in the low 16 bits of each lane
+{
+	const __m128i expmant = _mm_and_si128( h, _mm_set1_epi32( 0x7fff ) );
+	const __m128i sign = _mm_slli_epi32( _mm_xor_si128( h, expmant ), 16 );
+	// move exponent and mantissa in place and rebias with a multiply by 2^112; this also normalizes denormals
+	const __m128 scaled = _mm_mul_ps( _mm_castsi128_ps( _mm_slli_epi32( expmant, 13 ) ), _mm_castsi128_ps( _mm_set1_epi32( (254 - 15) << 23 ) ) );
+	const __m128i infnan = _mm_and_si128( _mm_cmpgt_epi32( expmant, _mm_set1_epi32( 0x7bff ) ), _mm_set1_epi32( 255 << 23 ) );
+	// NaNs keep their payload and come out quiet, like vcvtph2ps
+	const __m128i quiet = _mm_and_si128( _mm_cmpgt_epi32( expmant, _mm_set1_epi32( 0x7c00 ) ), _mm_set1_epi32( 0x00400000 ) );
+	return _mm_or_ps( scaled, _mm_castsi128_ps( _mm_or_si128( _mm_or_si128( sign, infnan ), quiet ) ) );
+}
+static __m128i FloatToHalf4( const __m128 f ) // results in the low 16 bits of each lane, sign-extended
+{
+	const __m128 justsign = _mm_and_ps( f, _mm_castsi128_ps( _mm_set1_epi32( 0x80000000 ) ) );
+	const __m128 absf = _mm_xor_ps( f, justsign );
+	const __m128i absi = _mm_castps_si128( absf );
+	// specials: everything from 65520 up becomes infinity; NaNs are quieted and keep the top 10 payload bits
+	const __m128i regular = _mm_cmpgt_epi32( _mm_set1_epi32( (127 + 16) << 23 ), absi );
+	const __m128i payload = _mm_or_si128( _mm_and_si128( _mm_srli_epi32( absi, 13 ), _mm_set1_epi32( 0x3ff ) ), _mm_set1_epi32( 0x200 ) );
+	const __m128i nan = _mm_and_si128( _mm_castps_si128( _mm_cmpunord_ps( absf, absf ) ), payload );
+	const __m128i special = _mm_or_si128( nan, _mm_set1_epi32( 0x7c00 ) );
+	// denormal results: let the fp adder do the rounding
+	const __m128i magic = _mm_set1_epi32( ((127 - 15) + (23 - 10) + 1) << 23 );
+	const __m128i denormal = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( absf, _mm_castsi128_ps( magic ) ) ), magic );
+	const __m128i isDenormal = _mm_cmpgt_epi32( _mm_set1_epi32( (127 - 14) << 23 ), absi );
+	// normal results: rebias, round to nearest even and shift
+	const __m128i odd = _mm_srai_epi32( _mm_slli_epi32( absi, 31 - 13 ), 31 );
+	const __m128i rounded = _mm_sub_epi32( _mm_add_epi32( absi, _mm_set1_epi32( 0xfff - ((127 - 15) << 23) ) ), odd );
+	const __m128i normal = _mm_srli_epi32( rounded, 13 );
+	const __m128i finite = _mm_or_si128( _mm_and_si128( isDenormal, denormal ), _mm_andnot_si128( isDenormal, normal ) );
+	const __m128i joined = _mm_or_si128( _mm_and_si128( regular, finite ), _mm_andnot_si128( regular, special ) );
+	return _mm_or_si128( joined, _mm_srai_epi32( _mm_castps_si128( justsign ), 16 ) );
+}
+void HalfToFloat( const half* src, float* dst, const int n )
+{
+	int i = 0;
+#ifdef SIMD_F32X16
+	if (CPUCaps::HW_AVX512F) for (; i + 16 <= n; i += 16)
+		_mm512_storeu_ps( dst + i, _mm512_cvtph_ps( _mm256_loadu_si256( (__m256i*)(src + i) ) ) );
+#endif
+#ifdef HALF_F16C
+	if (CPUCaps::HW_F16C) for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps( dst + i, _mm256_cvtph_ps( _mm_loadu_si128( (__m128i*)(src + i) ) ) );
+#endif
+	for (; i + 8 <= n; i += 8)
+	{
+		const __m128i h = _mm_loadu_si128( (__m128i*)(src + i) ), zero = _mm_setzero_si128();
+		_mm_storeu_ps( dst + i, HalfToFloat4( _mm_unpacklo_epi16( h, zero ) ) );
+		_mm_storeu_ps( dst + i + 4, HalfToFloat4( _mm_unpackhi_epi16( h, zero ) ) );
+	}
+	// tail: convert a padded copy
+	ALIGN( 16 ) half h[4] = {};
+	ALIGN( 16 ) float f[4];
+	for (; i < n; i += 4)
+	{
+		const int count = min( 4, n - i );
+		memcpy( h, src + i, count * sizeof( half ) );
+		_mm_store_ps( f, HalfToFloat4( _mm_unpacklo_epi16( _mm_loadl_epi64( (__m128i*)h ), _mm_setzero_si128() ) ) );
+		memcpy( dst + i, f, count * sizeof( float ) );
+	}
+}
+void FloatToHalf( const float* src, half* dst, const int n )
+{
+	int i = 0;
+#ifdef SIMD_F32X16
+	if (CPUCaps::HW_AVX512F) for (; i + 16 <= n; i += 16)
+		_mm256_storeu_si256( (__m256i*)(dst + i), _mm512_cvtps_ph( _mm512_loadu_ps( src + i ), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ) );
+#endif
+#ifdef HALF_F16C
+	if (CPUCaps::HW_F16C) for (; i + 8 <= n; i += 8)
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm256_cvtps_ph( _mm256_loadu_ps( src + i ), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ) );
+#endif
+	for (; i + 8 <= n; i += 8)
+	{
+		// packs saturates to signed 16-bit; negative results are sign-extended, so nothing is clipped
+		const __m128i lo = FloatToHalf4( _mm_loadu_ps( src + i ) ), hi = FloatToHalf4( _mm_loadu_ps( src + i + 4 ) );
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_packs_epi32( lo, hi ) );
+	}
+	ALIGN( 16 ) float f[4] = {};
+	ALIGN( 16 ) half h[8];
+	for (; i < n; i += 4)
+	{
+		const int count = min( 4, n - i );
+		memcpy( f, src + i, count * sizeof( float ) );
+		const __m128i r = FloatToHalf4( _mm_load_ps( f ) );
+		_mm_store_si128( (__m128i*)h, _mm_packs_epi32( r, r ) );
+		memcpy( dst + i, h, count * sizeof( half ) );
+	}
+}
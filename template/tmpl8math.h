@@ -680,10 +680,9 @@ public:
 	CHECK_RESULT mat4 Transposed() const
 	{
 		mat4 M;
-		M[0] = cell[0], M[1] = cell[4], M[2] = cell[8], M[3] = cell[12];
-		M[4] = cell[1], M[5] = cell[5], M[6] = cell[9], M[7] = cell[13];
-		M[8] = cell[2], M[9] = cell[6], M[10] = cell[10], M[11] = cell[14];
-		M[12] = cell[3], M[13] = cell[7], M[14] = cell[11], M[15] = cell[15];
+		__m128 r0 = _mm_load_ps( cell ), r1 = _mm_load_ps( cell + 4 ), r2 = _mm_load_ps( cell + 8 ), r3 = _mm_load_ps( cell + 12 );
+		_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+		_mm_store_ps( M.cell, r0 ), _mm_store_ps( M.cell + 4, r1 ), _mm_store_ps( M.cell + 8, r2 ), _mm_store_ps( M.cell + 12, r3 );
 		return M;
 	}
 	CHECK_RESULT mat4 FastInvertedTransformNoScale() const
@@ -710,53 +709,11 @@ public:
 		r[11] = -(cell[3] * r[8] + cell[7] * r[9] + cell[11] * r[10]);
 		return r;
 	}
-	CHECK_RESULT mat4 Inverted() const
-	{
-		// from MESA, via http://stackoverflow.com/questions/1148309/inverting-a-4x4-matrix
-		const float inv[16] = {
-			cell[5] * cell[10] * cell[15] - cell[5] * cell[11] * cell[14] - cell[9] * cell[6] * cell[15] +
-			cell[9] * cell[7] * cell[14] + cell[13] * cell[6] * cell[11] - cell[13] * cell[7] * cell[10],
-			-cell[1] * cell[10] * cell[15] + cell[1] * cell[11] * cell[14] + cell[9] * cell[2] * cell[15] -
-			cell[9] * cell[3] * cell[14] - cell[13] * cell[2] * cell[11] + cell[13] * cell[3] * cell[10],
-			cell[1] * cell[6] * cell[15] - cell[1] * cell[7] * cell[14] - cell[5] * cell[2] * cell[15] +
-			cell[5] * cell[3] * cell[14] + cell[13] * cell[2] * cell[7] - cell[13] * cell[3] * cell[6],
-			-cell[1] * cell[6] * cell[11] + cell[1] * cell[7] * cell[10] + cell[5] * cell[2] * cell[11] -
-			cell[5] * cell[3] * cell[10] - cell[9] * cell[2] * cell[7] + cell[9] * cell[3] * cell[6],
-			-cell[4] * cell[10] * cell[15] + cell[4] * cell[11] * cell[14] + cell[8] * cell[6] * cell[15] -
-			cell[8] * cell[7] * cell[14] - cell[12] * cell[6] * cell[11] + cell[12] * cell[7] * cell[10],
-			cell[0] * cell[10] * cell[15] - cell[0] * cell[11] * cell[14] - cell[8] * cell[2] * cell[15] +
-			cell[8] * cell[3] * cell[14] + cell[12] * cell[2] * cell[11] - cell[12] * cell[3] * cell[10],
-			-cell[0] * cell[6] * cell[15] + cell[0] * cell[7] * cell[14] + cell[4] * cell[2] * cell[15] -
-			cell[4] * cell[3] * cell[14] - cell[12] * cell[2] * cell[7] + cell[12] * cell[3] * cell[6],
-			cell[0] * cell[6] * cell[11] - cell[0] * cell[7] * cell[10] - cell[4] * cell[2] * cell[11] +
-			cell[4] * cell[3] * cell[10] + cell[8] * cell[2] * cell[7] - cell[8] * cell[3] * cell[6],
-			cell[4] * cell[9] * cell[15] - cell[4] * cell[11] * cell[13] - cell[8] * cell[5] * cell[15] +
-			cell[8] * cell[7] * cell[13] + cell[12] * cell[5] * cell[11] - cell[12] * cell[7] * cell[9],
-			-cell[0] * cell[9] * cell[15] + cell[0] * cell[11] * cell[13] + cell[8] * cell[1] * cell[15] -
-			cell[8] * cell[3] * cell[13] - cell[12] * cell[1] * cell[11] + cell[12] * cell[3] * cell[9],
-			cell[0] * cell[5] * cell[15] - cell[0] * cell[7] * cell[13] - cell[4] * cell[1] * cell[15] +
-			cell[4] * cell[3] * cell[13] + cell[12] * cell[1] * cell[7] - cell[12] * cell[3] * cell[5],
-			-cell[0] * cell[5] * cell[11] + cell[0] * cell[7] * cell[9] + cell[4] * cell[1] * cell[11] -
-			cell[4] * cell[3] * cell[9] - cell[8] * cell[1] * cell[7] + cell[8] * cell[3] * cell[5],
-			-cell[4] * cell[9] * cell[14] + cell[4] * cell[10] * cell[13] + cell[8] * cell[5] * cell[14] -
-			cell[8] * cell[6] * cell[13] - cell[12] * cell[5] * cell[10] + cell[12] * cell[6] * cell[9],
-			cell[0] * cell[9] * cell[14] - cell[0] * cell[10] * cell[13] - cell[8] * cell[1] * cell[14] +
-			cell[8] * cell[2] * cell[13] + cell[12] * cell[1] * cell[10] - cell[12] * cell[2] * cell[9],
-			-cell[0] * cell[5] * cell[14] + cell[0] * cell[6] * cell[13] + cell[4] * cell[1] * cell[14] -
-			cell[4] * cell[2] * cell[13] - cell[12] * cell[1] * cell[6] + cell[12] * cell[2] * cell[5],
-			cell[0] * cell[5] * cell[10] - cell[0] * cell[6] * cell[9] - cell[4] * cell[1] * cell[10] +
-			cell[4] * cell[2] * cell[9] + cell[8] * cell[1] * cell[6] - cell[8] * cell[2] * cell[5]
-		};
-		const float det = cell[0] * inv[0] + cell[1] * inv[4] + cell[2] * inv[8] + cell[3] * inv[12];
-		mat4 retVal;
-		if (det != 0)
-		{
-			const float invdet = 1.0f / det;
-			for (int i = 0; i < 16; i++) retVal.cell[i] = inv[i] * invdet;
-		}
-		return retVal;
-	}
-
+	// general inverse; returns the identity matrix if the matrix is singular
+	CHECK_RESULT mat4 Inverted() const;
+	// inverse of a matrix with (0, 0, 0, 1) as the bottom row (any combination
+	// of translation, rotation, scale and shear); cheaper than Inverted
+	CHECK_RESULT mat4 InvertedAffine() const;
 	CHECK_RESULT mat4 Inverted3x3() const
 	{
 		// via https://stackoverflow.com/questions/983999/simple-3x3-matrix-inverse-code-c
@@ -813,6 +770,68 @@ float3 TransformPosition( const float3& a, const mat4& M );
 float3 TransformVector( const float3& a, const mat4& M );
 float3 TransformPosition_SSE( const __m128& a, const mat4& M );
 float3 TransformVector_SSE( const __m128& a, const mat4& M );
+// batch transforms; as TransformPosition and TransformVector, but for arrays.
+// Positions are not divided by w. 'in' and 'out' may point to the same array.
+void TransformPositions( const mat4& M, const float3* in, float3* out, const int n );
+void TransformVectors( const mat4& M, const float3* in, float3* out, const int n );
+void TransformPositions( const mat4& M, const float4* in, float4* out, const int n ); // full M * v
+void TransformVectors( const mat4& M, const float4* in, float4* out, const int n ); // 3x3 part only; w is copied
+
+// affine transform: the top three rows of a mat4, with an implicit bottom row
+// of (0, 0, 0, 1). Stored as three SSE rows; composing two affine3x4s takes
+// 9 multiply-adds per row instead of the 16 of a full mat4 product, and the
+// inverse needs no 4x4 cofactors. Used by the scene graph and for skinning;
+// convert to mat4 where a full matrix is needed (GPU upload, projection).
+class affine3x4
+{
+public:
+	affine3x4() = default;
+	explicit affine3x4( const mat4& M ) { memcpy( cell, M.cell, 48 ); }
+	mat4 ToMat4() const { mat4 M; memcpy( M.cell, cell, 48 ); return M; }
+	__declspec(align(16)) float cell[12] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0 };
+	float& operator [] ( const int idx ) { return cell[idx]; }
+	const float& operator [] ( const int idx ) const { return cell[idx]; }
+	__m128 Row( const int i ) const { return _mm_load_ps( cell + i * 4 ); }
+	float3 GetTranslation() const { return make_float3( cell[3], cell[7], cell[11] ); }
+	static affine3x4 Identity() { return affine3x4{}; }
+	// T * R * S, with R a rotation matrix (e.g. from quat::toMatrix)
+	static affine3x4 FromTRS( const float3& t, const mat4& R, const float3& s )
+	{
+		affine3x4 r;
+		for (int i = 0; i < 3; i++)
+			r.cell[i * 4 + 0] = R.cell[i * 4 + 0] * s.x, r.cell[i * 4 + 1] = R.cell[i * 4 + 1] * s.y,
+			r.cell[i * 4 + 2] = R.cell[i * 4 + 2] * s.z, r.cell[i * 4 + 3] = (&t.x)[i];
+		return r;
+	}
+	affine3x4& operator += ( const affine3x4& a )
+	{
+		for (int i = 0; i < 3; i++) _mm_store_ps( cell + i * 4, _mm_add_ps( Row( i ), a.Row( i ) ) );
+		return *this;
+	}
+	// general inverse (translation, rotation, scale and shear); returns the
+	// identity if the 3x3 part is singular
+	CHECK_RESULT affine3x4 Inverted() const;
+	// inverse of a rotation + translation: the transposed rotation and -R^T * t,
+	// as mat4::FastInvertedTransformNoScale. Requires orthonormal rows, i.e. no
+	// scale or shear; use Inverted otherwise.
+	CHECK_RESULT affine3x4 InvertedRigid() const;
+	inline float3 TransformPosition( const float3& v ) const
+	{
+		return make_float3( cell[0] * v.x + cell[1] * v.y + cell[2] * v.z + cell[3],
+			cell[4] * v.x + cell[5] * v.y + cell[6] * v.z + cell[7],
+			cell[8] * v.x + cell[9] * v.y + cell[10] * v.z + cell[11] );
+	}
+	inline float3 TransformVector( const float3& v ) const
+	{
+		return make_float3( cell[0] * v.x + cell[1] * v.y + cell[2] * v.z,
+			cell[4] * v.x + cell[5] * v.y + cell[6] * v.z,
+			cell[8] * v.x + cell[9] * v.y + cell[10] * v.z );
+	}
+};
+
+affine3x4 operator * ( const affine3x4& a, const affine3x4& b );
+affine3x4 operator * ( const float s, const affine3x4& a );
+float4 operator * ( const affine3x4& a, const float4& b ); // xyz transformed by the rows, w is copied
 
 class quat // based on https://github.com/adafruit
 {
@@ -1018,6 +1037,12 @@ float noise3D( const float x, const float y, const float z );
 // half-floats
 float half_to_float( const half x );
 half float_to_half( const float x );
+// arrays: F16C or AVX-512 when available, SSE2 otherwise. Unlike float_to_half
+// these round to nearest even and convert out-of-range values to infinity, as
+// the hardware does, and NaNs come out quiet with their upper payload bits
+// kept; all paths produce identical results.
+void HalfToFloat( const half* src, float* dst, const int n );
+void FloatToHalf( const float* src, half* dst, const int n );
 
 // bad float detection (method from OpenCV)
 inline bool isnan( const float value )
@@ -0,0 +1,458 @@
+// Template, 2024 IGAD Edition
+// Get the latest version from: https://github.com/jbikker/tmpl8
+// IGAD/NHTV/BUAS/UU - Jacco Bikker - 2006-2024
+
+// In this file: SIMD-wide math, for processing 4, 8 or 16 elements at once.
+// Overview:
+// - Lane types: f32x4 (SSE), f32x8 (AVX2) and f32x16 (AVX-512F) hold one
+//   float per lane and support the usual arithmetic, comparisons, fminf /
+//   fmaxf, lerp, select and horizontal reductions. Comparisons yield a mask:
+//   for f32x4 and f32x8 this is a vector with all bits set in active lanes,
+//   for f32x16 it is an m32x16 (a 16-bit AVX-512 mask).
+// - Structure-of-arrays types: wide2<T>, wide3<T> and wide4<T> hold N
+//   float2 / float3 / float4 values, one component per lane type. The
+//   typedefs float3x8, float4x8 etc. name these for 4, 8 and 16 lanes; note
+//   that float4x4 is four float4 values, not a matrix (see mat4).
+// - Gather / scatter: Load and Store convert between arrays of float2 /
+//   float3 / float4 (AoS) and the wide types; Gather and Scatter do the same
+//   for indexed elements.
+// Code written against wide3<T> compiles for all lane types, e.g.:
+//   template <class T> void Integrate( float3* pos, float3* vel, const int n, const float dt )
+//   {
+//       const int N = T::lanes;
+//       for (int i = 0; i < n; i += N) // n must be a multiple of N
+//       {
+//           wide3<T> p = wide3<T>::Load( pos + i ), v = wide3<T>::Load( vel + i );
+//           v.y -= 9.81f * dt;
+//           p += v * dt;
+//           p.Store( pos + i ), v.Store( vel + i );
+//       }
+//   }
+//   if (CPUCaps::HW_AVX2 && CPUCaps::HW_FMA3) Integrate<f32x8>( ... ); else Integrate<f32x4>( ... );
+// MSVC compiles all lane types; check CPUCaps before using f32x8 (HW_AVX2
+// and HW_FMA3: madd is a fused multiply-add) or f32x16 (HW_AVX512F). Other compilers only get the lane types enabled by
+// their command line (-mavx2, -mavx512f); see SIMD_F32X8 and SIMD_F32X16.
+
+#pragma once
+
+#if defined( _MSC_VER ) || defined( __AVX2__ )
+#define SIMD_F32X8
+#endif
+#if defined( _MSC_VER ) || defined( __AVX512F__ )
+#define SIMD_F32X16
+#endif
+
+#pragma warning ( push )
+#pragma warning ( disable: 4201 /* nameless struct / union */ )
+
+namespace Tmpl8
+{
+
+// 4 lanes, SSE
+struct f32x4
+{
+	enum { lanes = 4 };
+	typedef f32x4 mask;
+	f32x4() = default;
+	f32x4( const __m128 a ) : v( a ) {}
+	f32x4( const float a ) : v( _mm_set1_ps( a ) ) {}
+	static f32x4 Load( const float* p ) { return _mm_load_ps( p ); } // p must be 16-byte aligned
+	static f32x4 LoadU( const float* p ) { return _mm_loadu_ps( p ); }
+	void Store( float* p ) const { _mm_store_ps( p, v ); }
+	void StoreU( float* p ) const { _mm_storeu_ps( p, v ); }
+	static f32x4 Gather( const float* base, const int* idx, const int stride = 1 )
+	{
+		return _mm_setr_ps( base[idx[0] * stride], base[idx[1] * stride], base[idx[2] * stride], base[idx[3] * stride] );
+	}
+	static f32x4 Gather( const float* base, const int stride )
+	{
+		return _mm_setr_ps( base[0], base[stride], base[2 * stride], base[3 * stride] );
+	}
+	void Scatter( float* base, const int* idx, const int stride = 1 ) const
+	{
+		for (int i = 0; i < 4; i++) base[idx[i] * stride] = f[i];
+	}
+	void Scatter( float* base, const int stride ) const
+	{
+		for (int i = 0; i < 4; i++) base[i * stride] = f[i];
+	}
+	float& operator [] ( const int i ) { return f[i]; }
+	const float& operator [] ( const int i ) const { return f[i]; }
+	union { __m128 v; float f[4]; };
+};
+
+#ifdef SIMD_F32X8
+
+// 8 lanes, AVX2
+struct f32x8
+{
+	enum { lanes = 8 };
+	typedef f32x8 mask;
+	f32x8() = default;
+	f32x8( const __m256 a ) : v( a ) {}
+	f32x8( const float a ) : v( _mm256_set1_ps( a ) ) {}
+	static f32x8 Load( const float* p ) { return _mm256_load_ps( p ); } // p must be 32-byte aligned
+	static f32x8 LoadU( const float* p ) { return _mm256_loadu_ps( p ); }
+	void Store( float* p ) const { _mm256_store_ps( p, v ); }
+	void StoreU( float* p ) const { _mm256_storeu_ps( p, v ); }
+	static f32x8 Gather( const float* base, const int* idx, const int stride = 1 )
+	{
+		const __m256i i = _mm256_mullo_epi32( _mm256_loadu_si256( (const __m256i*)idx ), _mm256_set1_epi32( stride ) );
+		return _mm256_i32gather_ps( base, i, 4 );
+	}
+	static f32x8 Gather( const float* base, const int stride )
+	{
+		const __m256i i = _mm256_mullo_epi32( _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ), _mm256_set1_epi32( stride ) );
+		return _mm256_i32gather_ps( base, i, 4 );
+	}
+	void Scatter( float* base, const int* idx, const int stride = 1 ) const
+	{
+		for (int i = 0; i < 8; i++) base[idx[i] * stride] = f[i]; // AVX2 has no scatter
+	}
+	void Scatter( float* base, const int stride ) const
+	{
+		for (int i = 0; i < 8; i++) base[i * stride] = f[i];
+	}
+	float& operator [] ( const int i ) { return f[i]; }
+	const float& operator [] ( const int i ) const { return f[i]; }
+	union { __m256 v; float f[8]; };
+};
+
+#endif
+
+#ifdef SIMD_F32X16
+
+// 16 lanes, AVX-512F; comparisons produce a bit mask
+struct m32x16
+{
+	m32x16() = default;
+	m32x16( const __mmask16 a ) : k( a ) {}
+	__mmask16 k;
+};
+
+struct f32x16
+{
+	enum { lanes = 16 };
+	typedef m32x16 mask;
+	f32x16() = default;
+	f32x16( const __m512 a ) : v( a ) {}
+	f32x16( const float a ) : v( _mm512_set1_ps( a ) ) {}
+	static f32x16 Load( const float* p ) { return _mm512_load_ps( p ); } // p must be 64-byte aligned
+	static f32x16 LoadU( const float* p ) { return _mm512_loadu_ps( p ); }
+	void Store( float* p ) const { _mm512_store_ps( p, v ); }
+	void StoreU( float* p ) const { _mm512_storeu_ps( p, v ); }
+	static f32x16 Gather( const float* base, const int* idx, const int stride = 1 )
+	{
+		const __m512i i = _mm512_mullo_epi32( _mm512_loadu_si512( idx ), _mm512_set1_epi32( stride ) );
+		return _mm512_i32gather_ps( i, base, 4 );
+	}
+	static f32x16 Gather( const float* base, const int stride )
+	{
+		const __m512i i = _mm512_mullo_epi32( _mm512_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 ), _mm512_set1_epi32( stride ) );
+		return _mm512_i32gather_ps( i, base, 4 );
+	}
+	void Scatter( float* base, const int* idx, const int stride = 1 ) const
+	{
+		const __m512i i = _mm512_mullo_epi32( _mm512_loadu_si512( idx ), _mm512_set1_epi32( stride ) );
+		_mm512_i32scatter_ps( base, i, v, 4 );
+	}
+	void Scatter( float* base, const int stride ) const
+	{
+		const __m512i i = _mm512_mullo_epi32( _mm512_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 ), _mm512_set1_epi32( stride ) );
+		_mm512_i32scatter_ps( base, i, v, 4 );
+	}
+	float& operator [] ( const int i ) { return f[i]; }
+	const float& operator [] ( const int i ) const { return f[i]; }
+	union { __m512 v; float f[16]; };
+};
+
+#endif
+
+// structure-of-arrays vectors; T is one of the lane types above
+template <class T> struct wide2
+{
+	wide2() = default;
+	wide2( const T& a, const T& b ) : x( a ), y( b ) {}
+	wide2( const float2& a ) : x( a.x ), y( a.y ) {}
+	static wide2 Load( const float2* p ) { return wide2( T::Gather( &p->x, 2 ), T::Gather( &p->y, 2 ) ); }
+	static wide2 Gather( const float2* p, const int* idx ) { return wide2( T::Gather( &p->x, idx, 2 ), T::Gather( &p->y, idx, 2 ) ); }
+	void Store( float2* p ) const { x.Scatter( &p->x, 2 ), y.Scatter( &p->y, 2 ); }
+	void Scatter( float2* p, const int* idx ) const { x.Scatter( &p->x, idx, 2 ), y.Scatter( &p->y, idx, 2 ); }
+	float2 operator [] ( const int i ) const { return make_float2( x[i], y[i] ); }
+	T x, y;
+};
+template <class T> struct wide3
+{
+	wide3() = default;
+	wide3( const T& a, const T& b, const T& c ) : x( a ), y( b ), z( c ) {}
+	wide3( const float3& a ) : x( a.x ), y( a.y ), z( a.z ) {}
+	static wide3 Load( const float3* p ) { return wide3( T::Gather( &p->x, 3 ), T::Gather( &p->y, 3 ), T::Gather( &p->z, 3 ) ); }
+	static wide3 Gather( const float3* p, const int* idx ) { return wide3( T::Gather( &p->x, idx, 3 ), T::Gather( &p->y, idx, 3 ), T::Gather( &p->z, idx, 3 ) ); }
+	void Store( float3* p ) const { x.Scatter( &p->x, 3 ), y.Scatter( &p->y, 3 ), z.Scatter( &p->z, 3 ); }
+	void Scatter( float3* p, const int* idx ) const { x.Scatter( &p->x, idx, 3 ), y.Scatter( &p->y, idx, 3 ), z.Scatter( &p->z, idx, 3 ); }
+	float3 operator [] ( const int i ) const { return make_float3( x[i], y[i], z[i] ); }
+	T x, y, z;
+};
+template <class T> struct wide4
+{
+	wide4() = default;
+	wide4( const T& a, const T& b, const T& c, const T& d ) : x( a ), y( b ), z( c ), w( d ) {}
+	wide4( const float4& a ) : x( a.x ), y( a.y ), z( a.z ), w( a.w ) {}
+	static wide4 Load( const float4* p ) { return wide4( T::Gather( &p->x, 4 ), T::Gather( &p->y, 4 ), T::Gather( &p->z, 4 ), T::Gather( &p->w, 4 ) ); }
+	static wide4 Gather( const float4* p, const int* idx )
+	{
+		return wide4( T::Gather( &p->x, idx, 4 ), T::Gather( &p->y, idx, 4 ), T::Gather( &p->z, idx, 4 ), T::Gather( &p->w, idx, 4 ) );
+	}
+	void Store( float4* p ) const { x.Scatter( &p->x, 4 ), y.Scatter( &p->y, 4 ), z.Scatter( &p->z, 4 ), w.Scatter( &p->w, 4 ); }
+	void Scatter( float4* p, const int* idx ) const { x.Scatter( &p->x, idx, 4 ), y.Scatter( &p->y, idx, 4 ), z.Scatter( &p->z, idx, 4 ), w.Scatter( &p->w, idx, 4 ); }
+	float4 operator [] ( const int i ) const { return make_float4( x[i], y[i], z[i], w[i] ); }
+	T x, y, z, w;
+};
+
+typedef wide2<f32x4> float2x4;
+typedef wide3<f32x4> float3x4;
+typedef wide4<f32x4> float4x4;
+#ifdef SIMD_F32X8
+typedef wide2<f32x8> float2x8;
+typedef wide3<f32x8> float3x8;
+typedef wide4<f32x8> float4x8;
+#endif
+#ifdef SIMD_F32X16
+typedef wide2<f32x16> float2x16;
+typedef wide3<f32x16> float3x16;
+typedef wide4<f32x16> float4x16;
+#endif
+
+}
+
+#pragma warning ( pop )
+
+// operations on the lane types. Like the operations in tmpl8math.h, these are
+// not in namespace Tmpl8, so they do not hide the scalar sqrtf, fminf etc.
+// from code inside the namespace.
+inline f32x4 operator+( const f32x4& a, const f32x4& b ) { return _mm_add_ps( a.v, b.v ); }
+inline f32x4 operator-( const f32x4& a, const f32x4& b ) { return _mm_sub_ps( a.v, b.v ); }
+inline f32x4 operator*( const f32x4& a, const f32x4& b ) { return _mm_mul_ps( a.v, b.v ); }
+inline f32x4 operator/( const f32x4& a, const f32x4& b ) { return _mm_div_ps( a.v, b.v ); }
+inline f32x4 operator-( const f32x4& a ) { return _mm_xor_ps( a.v, _mm_set1_ps( -0.0f ) ); }
+inline void operator+=( f32x4& a, const f32x4& b ) { a.v = _mm_add_ps( a.v, b.v ); }
+inline void operator-=( f32x4& a, const f32x4& b ) { a.v = _mm_sub_ps( a.v, b.v ); }
+inline void operator*=( f32x4& a, const f32x4& b ) { a.v = _mm_mul_ps( a.v, b.v ); }
+inline void operator/=( f32x4& a, const f32x4& b ) { a.v = _mm_div_ps( a.v, b.v ); }
+inline f32x4 operator<( const f32x4& a, const f32x4& b ) { return _mm_cmplt_ps( a.v, b.v ); }
+inline f32x4 operator<=( const f32x4& a, const f32x4& b ) { return _mm_cmple_ps( a.v, b.v ); }
+inline f32x4 operator>( const f32x4& a, const f32x4& b ) { return _mm_cmpgt_ps( a.v, b.v ); }
+inline f32x4 operator>=( const f32x4& a, const f32x4& b ) { return _mm_cmpge_ps( a.v, b.v ); }
+inline f32x4 operator==( const f32x4& a, const f32x4& b ) { return _mm_cmpeq_ps( a.v, b.v ); }
+inline f32x4 operator!=( const f32x4& a, const f32x4& b ) { return _mm_cmpneq_ps( a.v, b.v ); }
+inline f32x4 operator&( const f32x4& a, const f32x4& b ) { return _mm_and_ps( a.v, b.v ); }
+inline f32x4 operator|( const f32x4& a, const f32x4& b ) { return _mm_or_ps( a.v, b.v ); }
+inline f32x4 operator^( const f32x4& a, const f32x4& b ) { return _mm_xor_ps( a.v, b.v ); }
+inline f32x4 andnot( const f32x4& a, const f32x4& b ) { return _mm_andnot_ps( a.v, b.v ); } // ~a & b
+inline f32x4 select( const f32x4& m, const f32x4& a, const f32x4& b ) { return _mm_or_ps( _mm_and_ps( m.v, a.v ), _mm_andnot_ps( m.v, b.v ) ); }
+inline int bits( const f32x4& m ) { return _mm_movemask_ps( m.v ); }
+inline bool any( const f32x4& m ) { return _mm_movemask_ps( m.v ) != 0; }
+inline bool all( const f32x4& m ) { return _mm_movemask_ps( m.v ) == 15; }
+inline f32x4 fminf( const f32x4& a, const f32x4& b ) { return _mm_min_ps( a.v, b.v ); }
+inline f32x4 fmaxf( const f32x4& a, const f32x4& b ) { return _mm_max_ps( a.v, b.v ); }
+inline f32x4 clamp( const f32x4& v, const f32x4& a, const f32x4& b ) { return _mm_min_ps( _mm_max_ps( v.v, a.v ), b.v ); }
+inline f32x4 fabs( const f32x4& a ) { return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a.v ); }
+inline f32x4 sqrtf( const f32x4& a ) { return _mm_sqrt_ps( a.v ); }
+inline f32x4 rsqrtf( const f32x4& a ) { return _mm_rsqrt_ps( a.v ); } // approximation, 12 bits
+inline f32x4 rcp( const f32x4& a ) { return _mm_rcp_ps( a.v ); } // approximation, 12 bits
+inline f32x4 floorf( const f32x4& a )
+{
+#if defined( _MSC_VER ) || defined( __SSE4_1__ )
+	return _mm_floor_ps( a.v );
+#else
+	// truncate, then correct negative non-integers; valid for |a| < 2^31
+	const __m128 t = _mm_cvtepi32_ps( _mm_cvttps_epi32( a.v ) );
+	return _mm_sub_ps( t, _mm_and_ps( _mm_cmpgt_ps( t, a.v ), _mm_set1_ps( 1 ) ) );
+#endif
+}
+inline f32x4 madd( const f32x4& a, const f32x4& b, const f32x4& c ) // a * b + c
+{
+#if defined( __FMA__ ) || defined( __AVX2__ )
+	return _mm_fmadd_ps( a.v, b.v, c.v );
+#else
+	return _mm_add_ps( _mm_mul_ps( a.v, b.v ), c.v );
+#endif
+}
+inline f32x4 lerp( const f32x4& a, const f32x4& b, const f32x4& t ) { return madd( t, b - a, a ); }
+inline float hsum( const f32x4& a )
+{
+	const __m128 s = _mm_add_ps( a.v, _mm_movehl_ps( a.v, a.v ) );
+	return _mm_cvtss_f32( _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) ) );
+}
+inline float hmin( const f32x4& a )
+{
+	const __m128 s = _mm_min_ps( a.v, _mm_movehl_ps( a.v, a.v ) );
+	return _mm_cvtss_f32( _mm_min_ss( s, _mm_shuffle_ps( s, s, 1 ) ) );
+}
+inline float hmax( const f32x4& a )
+{
+	const __m128 s = _mm_max_ps( a.v, _mm_movehl_ps( a.v, a.v ) );
+	return _mm_cvtss_f32( _mm_max_ss( s, _mm_shuffle_ps( s, s, 1 ) ) );
+}
+
+#ifdef SIMD_F32X8
+inline f32x8 operator+( const f32x8& a, const f32x8& b ) { return _mm256_add_ps( a.v, b.v ); }
+inline f32x8 operator-( const f32x8& a, const f32x8& b ) { return _mm256_sub_ps( a.v, b.v ); }
+inline f32x8 operator*( const f32x8& a, const f32x8& b ) { return _mm256_mul_ps( a.v, b.v ); }
+inline f32x8 operator/( const f32x8& a, const f32x8& b ) { return _mm256_div_ps( a.v, b.v ); }
+inline f32x8 operator-( const f32x8& a ) { return _mm256_xor_ps( a.v, _mm256_set1_ps( -0.0f ) ); }
+inline void operator+=( f32x8& a, const f32x8& b ) { a.v = _mm256_add_ps( a.v, b.v ); }
+inline void operator-=( f32x8& a, const f32x8& b ) { a.v = _mm256_sub_ps( a.v, b.v ); }
+inline void operator*=( f32x8& a, const f32x8& b ) { a.v = _mm256_mul_ps( a.v, b.v ); }
+inline void operator/=( f32x8& a, const f32x8& b ) { a.v = _mm256_div_ps( a.v, b.v ); }
+inline f32x8 operator<( const f32x8& a, const f32x8& b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_LT_OQ ); }
+inline f32x8 operator<=( const f32x8& a, const f32x8& b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_LE_OQ ); }
+inline f32x8 operator>( const f32x8& a, const f32x8& b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_GT_OQ ); }
+inline f32x8 operator>=( const f32x8& a, const f32x8& b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_GE_OQ ); }
+inline f32x8 operator==( const f32x8& a, const f32x8& b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_EQ_OQ ); }
+inline f32x8 operator!=( const f32x8& a, const f32x8& b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_NEQ_UQ ); }
+inline f32x8 operator&( const f32x8& a, const f32x8& b ) { return _mm256_and_ps( a.v, b.v ); }
+inline f32x8 operator|( const f32x8& a, const f32x8& b ) { return _mm256_or_ps( a.v, b.v ); }
+inline f32x8 operator^( const f32x8& a, const f32x8& b ) { return _mm256_xor_ps( a.v, b.v ); }
+inline f32x8 andnot( const f32x8& a, const f32x8& b ) { return _mm256_andnot_ps( a.v, b.v ); } // ~a & b
+inline f32x8 select( const f32x8& m, const f32x8& a, const f32x8& b ) { return _mm256_blendv_ps( b.v, a.v, m.v ); }
+inline int bits( const f32x8& m ) { return _mm256_movemask_ps( m.v ); }
+inline bool any( const f32x8& m ) { return _mm256_movemask_ps( m.v ) != 0; }
+inline bool all( const f32x8& m ) { return _mm256_movemask_ps( m.v ) == 255; }
+inline f32x8 fminf( const f32x8& a, const f32x8& b ) { return _mm256_min_ps( a.v, b.v ); }
+inline f32x8 fmaxf( const f32x8& a, const f32x8& b ) { return _mm256_max_ps( a.v, b.v ); }
+inline f32x8 clamp( const f32x8& v, const f32x8& a, const f32x8& b ) { return _mm256_min_ps( _mm256_max_ps( v.v, a.v ), b.v ); }
+inline f32x8 fabs( const f32x8& a ) { return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a.v ); }
+inline f32x8 sqrtf( const f32x8& a ) { return _mm256_sqrt_ps( a.v ); }
+inline f32x8 rsqrtf( const f32x8& a ) { return _mm256_rsqrt_ps( a.v ); } // approximation, 12 bits
+inline f32x8 rcp( const f32x8& a ) { return _mm256_rcp_ps( a.v ); } // approximation, 12 bits
+inline f32x8 floorf( const f32x8& a ) { return _mm256_floor_ps( a.v ); }
+inline f32x8 madd( const f32x8& a, const f32x8& b, const f32x8& c ) { return _mm256_fmadd_ps( a.v, b.v, c.v ); } // a * b + c; requires FMA3
+inline f32x8 lerp( const f32x8& a, const f32x8& b, const f32x8& t ) { return madd( t, b - a, a ); }
+inline f32x4 low4( const f32x8& a ) { return _mm256_castps256_ps128( a.v ); }
+inline f32x4 high4( const f32x8& a ) { return _mm256_extractf128_ps( a.v, 1 ); }
+inline float hsum( const f32x8& a ) { return hsum( low4( a ) + high4( a ) ); }
+inline float hmin( const f32x8& a ) { return hmin( fminf( low4( a ), high4( a ) ) ); }
+inline float hmax( const f32x8& a ) { return hmax( fmaxf( low4( a ), high4( a ) ) ); }
+#endif
+
+#ifdef SIMD_F32X16
+inline m32x16 operator&( const m32x16& a, const m32x16& b ) { return (__mmask16)(a.k & b.k); }
+inline m32x16 operator|( const m32x16& a, const m32x16& b ) { return (__mmask16)(a.k | b.k); }
+inline m32x16 operator^( const m32x16& a, const m32x16& b ) { return (__mmask16)(a.k ^ b.k); }
+inline m32x16 operator~( const m32x16& a ) { return (__mmask16)~a.k; }
+inline m32x16 andnot( const m32x16& a, const m32x16& b ) { return (__mmask16)(~a.k & b.k); } // ~a & b
+inline int bits( const m32x16& m ) { return m.k; }
+inline bool any( const m32x16& m ) { return m.k != 0; }
+inline bool all( const m32x16& m ) { return m.k == 0xffff; }
+
+inline f32x16 operator+( const f32x16& a, const f32x16& b ) { return _mm512_add_ps( a.v, b.v ); }
+inline f32x16 operator-( const f32x16& a, const f32x16& b ) { return _mm512_sub_ps( a.v, b.v ); }
+inline f32x16 operator*( const f32x16& a, const f32x16& b ) { return _mm512_mul_ps( a.v, b.v ); }
+inline f32x16 operator/( const f32x16& a, const f32x16& b ) { return _mm512_div_ps( a.v, b.v ); }
+inline f32x16 operator-( const f32x16& a ) // float xor requires AVX512DQ; use the integer version
+{
+	return _mm512_castsi512_ps( _mm512_xor_si512( _mm512_castps_si512( a.v ), _mm512_set1_epi32( (int)0x80000000 ) ) );
+}
+inline void operator+=( f32x16& a, const f32x16& b ) { a.v = _mm512_add_ps( a.v, b.v ); }
+inline void operator-=( f32x16& a, const f32x16& b ) { a.v = _mm512_sub_ps( a.v, b.v ); }
+inline void operator*=( f32x16& a, const f32x16& b ) { a.v = _mm512_mul_ps( a.v, b.v ); }
+inline void operator/=( f32x16& a, const f32x16& b ) { a.v = _mm512_div_ps( a.v, b.v ); }
+inline m32x16 operator<( const f32x16& a, const f32x16& b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_LT_OQ ); }
+inline m32x16 operator<=( const f32x16& a, const f32x16& b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_LE_OQ ); }
+inline m32x16 operator>( const f32x16& a, const f32x16& b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_GT_OQ ); }
+inline m32x16 operator>=( const f32x16& a, const f32x16& b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_GE_OQ ); }
+inline m32x16 operator==( const f32x16& a, const f32x16& b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_EQ_OQ ); }
+inline m32x16 operator!=( const f32x16& a, const f32x16& b ) { return _mm512_cmp_ps_mask( a.v, b.v, _CMP_NEQ_UQ ); }
+inline f32x16 select( const m32x16& m, const f32x16& a, const f32x16& b ) { return _mm512_mask_blend_ps( m.k, b.v, a.v ); }
+inline f32x16 fminf( const f32x16& a, const f32x16& b ) { return _mm512_min_ps( a.v, b.v ); }
+inline f32x16 fmaxf( const f32x16& a, const f32x16& b ) { return _mm512_max_ps( a.v, b.v ); }
+inline f32x16 clamp( const f32x16& v, const f32x16& a, const f32x16& b ) { return _mm512_min_ps( _mm512_max_ps( v.v, a.v ), b.v ); }
+inline f32x16 fabs( const f32x16& a ) { return _mm512_abs_ps( a.v ); }
+inline f32x16 sqrtf( const f32x16& a ) { return _mm512_sqrt_ps( a.v ); }
+inline f32x16 rsqrtf( const f32x16& a ) { return _mm512_rsqrt14_ps( a.v ); } // approximation, 14 bits
+inline f32x16 rcp( const f32x16& a ) { return _mm512_rcp14_ps( a.v ); } // approximation, 14 bits
+inline f32x16 floorf( const f32x16& a ) { return _mm512_roundscale_ps( a.v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC ); }
+inline f32x16 madd( const f32x16& a, const f32x16& b, const f32x16& c ) { return _mm512_fmadd_ps( a.v, b.v, c.v ); } // a * b + c
+inline f32x16 lerp( const f32x16& a, const f32x16& b, const f32x16& t ) { return madd( t, b - a, a ); }
+inline float hsum( const f32x16& a ) { return _mm512_reduce_add_ps( a.v ); }
+inline float hmin( const f32x16& a ) { return _mm512_reduce_min_ps( a.v ); }
+inline float hmax( const f32x16& a ) { return _mm512_reduce_max_ps( a.v ); }
+#endif
+
+// operations on the structure-of-arrays types
+template <class T> inline wide2<T> operator-( const wide2<T>& a ) { return wide2<T>( -a.x, -a.y ); }
+template <class T> inline wide3<T> operator-( const wide3<T>& a ) { return wide3<T>( -a.x, -a.y, -a.z ); }
+template <class T> inline wide4<T> operator-( const wide4<T>& a ) { return wide4<T>( -a.x, -a.y, -a.z, -a.w ); }
+template <class T> inline wide2<T> operator+( const wide2<T>& a, const wide2<T>& b ) { return wide2<T>( a.x + b.x, a.y + b.y ); }
+template <class T> inline wide3<T> operator+( const wide3<T>& a, const wide3<T>& b ) { return wide3<T>( a.x + b.x, a.y + b.y, a.z + b.z ); }
+template <class T> inline wide4<T> operator+( const wide4<T>& a, const wide4<T>& b ) { return wide4<T>( a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w ); }
+template <class T> inline wide2<T> operator-( const wide2<T>& a, const wide2<T>& b ) { return wide2<T>( a.x - b.x, a.y - b.y ); }
+template <class T> inline wide3<T> operator-( const wide3<T>& a, const wide3<T>& b ) { return wide3<T>( a.x - b.x, a.y - b.y, a.z - b.z ); }
+template <class T> inline wide4<T> operator-( const wide4<T>& a, const wide4<T>& b ) { return wide4<T>( a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w ); }
+template <class T> inline wide2<T> operator*( const wide2<T>& a, const wide2<T>& b ) { return wide2<T>( a.x * b.x, a.y * b.y ); }
+template <class T> inline wide3<T> operator*( const wide3<T>& a, const wide3<T>& b ) { return wide3<T>( a.x * b.x, a.y * b.y, a.z * b.z ); }
+template <class T> inline wide4<T> operator*( const wide4<T>& a, const wide4<T>& b ) { return wide4<T>( a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w ); }
+template <class T> inline wide2<T> operator/( const wide2<T>& a, const wide2<T>& b ) { return wide2<T>( a.x / b.x, a.y / b.y ); }
+template <class T> inline wide3<T> operator/( const wide3<T>& a, const wide3<T>& b ) { return wide3<T>( a.x / b.x, a.y / b.y, a.z / b.z ); }
+template <class T> inline wide4<T> operator/( const wide4<T>& a, const wide4<T>& b ) { return wide4<T>( a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w ); }
+template <class T> inline wide2<T> operator*( const wide2<T>& a, const T& b ) { return wide2<T>( a.x * b, a.y * b ); }
+template <class T> inline wide3<T> operator*( const wide3<T>& a, const T& b ) { return wide3<T>( a.x * b, a.y * b, a.z * b ); }
+template <class T> inline wide4<T> operator*( const wide4<T>& a, const T& b ) { return wide4<T>( a.x * b, a.y * b, a.z * b, a.w * b ); }
+template <class T> inline wide2<T> operator*( const T& b, const wide2<T>& a ) { return wide2<T>( a.x * b, a.y * b ); }
+template <class T> inline wide3<T> operator*( const T& b, const wide3<T>& a ) { return wide3<T>( a.x * b, a.y * b, a.z * b ); }
+template <class T> inline wide4<T> operator*( const T& b, const wide4<T>& a ) { return wide4<T>( a.x * b, a.y * b, a.z * b, a.w * b ); }
+template <class T> inline wide2<T> operator*( const wide2<T>& a, const float b ) { return a * T( b ); }
+template <class T> inline wide3<T> operator*( const wide3<T>& a, const float b ) { return a * T( b ); }
+template <class T> inline wide4<T> operator*( const wide4<T>& a, const float b ) { return a * T( b ); }
+template <class T> inline wide2<T> operator*( const float b, const wide2<T>& a ) { return a * T( b ); }
+template <class T> inline wide3<T> operator*( const float b, const wide3<T>& a ) { return a * T( b ); }
+template <class T> inline wide4<T> operator*( const float b, const wide4<T>& a ) { return a * T( b ); }
+template <class T> inline wide2<T> operator/( const wide2<T>& a, const T& b ) { return a * (T( 1 ) / b); }
+template <class T> inline wide3<T> operator/( const wide3<T>& a, const T& b ) { return a * (T( 1 ) / b); }
+template <class T> inline wide4<T> operator/( const wide4<T>& a, const T& b ) { return a * (T( 1 ) / b); }
+template <class T> inline void operator+=( wide2<T>& a, const wide2<T>& b ) { a.x += b.x, a.y += b.y; }
+template <class T> inline void operator+=( wide3<T>& a, const wide3<T>& b ) { a.x += b.x, a.y += b.y, a.z += b.z; }
+template <class T> inline void operator+=( wide4<T>& a, const wide4<T>& b ) { a.x += b.x, a.y += b.y, a.z += b.z, a.w += b.w; }
+template <class T> inline void operator-=( wide2<T>& a, const wide2<T>& b ) { a.x -= b.x, a.y -= b.y; }
+template <class T> inline void operator-=( wide3<T>& a, const wide3<T>& b ) { a.x -= b.x, a.y -= b.y, a.z -= b.z; }
+template <class T> inline void operator-=( wide4<T>& a, const wide4<T>& b ) { a.x -= b.x, a.y -= b.y, a.z -= b.z, a.w -= b.w; }
+template <class T> inline void operator*=( wide2<T>& a, const T& b ) { a.x *= b, a.y *= b; }
+template <class T> inline void operator*=( wide3<T>& a, const T& b ) { a.x *= b, a.y *= b, a.z *= b; }
+template <class T> inline void operator*=( wide4<T>& a, const T& b ) { a.x *= b, a.y *= b, a.z *= b, a.w *= b; }
+template <class T> inline T dot( const wide2<T>& a, const wide2<T>& b ) { return madd( a.x, b.x, a.y * b.y ); }
+template <class T> inline T dot( const wide3<T>& a, const wide3<T>& b ) { return madd( a.x, b.x, madd( a.y, b.y, a.z * b.z ) ); }
+template <class T> inline T dot( const wide4<T>& a, const wide4<T>& b ) { return madd( a.x, b.x, madd( a.y, b.y, madd( a.z, b.z, a.w * b.w ) ) ); }
+template <class T> inline wide3<T> cross( const wide3<T>& a, const wide3<T>& b )
+{
+	return wide3<T>( a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x );
+}
+template <class T> inline T sqrLength( const wide2<T>& v ) { return dot( v, v ); }
+template <class T> inline T sqrLength( const wide3<T>& v ) { return dot( v, v ); }
+template <class T> inline T sqrLength( const wide4<T>& v ) { return dot( v, v ); }
+template <class T> inline T length( const wide2<T>& v ) { return sqrtf( dot( v, v ) ); }
+template <class T> inline T length( const wide3<T>& v ) { return sqrtf( dot( v, v ) ); }
+template <class T> inline T length( const wide4<T>& v ) { return sqrtf( dot( v, v ) ); }
+// normalize uses a full-precision reciprocal square root; fastNormalize uses the hardware approximation
+template <class T> inline wide2<T> normalize( const wide2<T>& v ) { return v * (T( 1 ) / sqrtf( dot( v, v ) )); }
+template <class T> inline wide3<T> normalize( const wide3<T>& v ) { return v * (T( 1 ) / sqrtf( dot( v, v ) )); }
+template <class T> inline wide4<T> normalize( const wide4<T>& v ) { return v * (T( 1 ) / sqrtf( dot( v, v ) )); }
+template <class T> inline wide3<T> fastNormalize( const wide3<T>& v ) { return v * rsqrtf( dot( v, v ) ); }
+template <class T> inline wide2<T> fminf( const wide2<T>& a, const wide2<T>& b ) { return wide2<T>( fminf( a.x, b.x ), fminf( a.y, b.y ) ); }
+template <class T> inline wide3<T> fminf( const wide3<T>& a, const wide3<T>& b ) { return wide3<T>( fminf( a.x, b.x ), fminf( a.y, b.y ), fminf( a.z, b.z ) ); }
+template <class T> inline wide4<T> fminf( const wide4<T>& a, const wide4<T>& b ) { return wide4<T>( fminf( a.x, b.x ), fminf( a.y, b.y ), fminf( a.z, b.z ), fminf( a.w, b.w ) ); }
+template <class T> inline wide2<T> fmaxf( const wide2<T>& a, const wide2<T>& b ) { return wide2<T>( fmaxf( a.x, b.x ), fmaxf( a.y, b.y ) ); }
+template <class T> inline wide3<T> fmaxf( const wide3<T>& a, const wide3<T>& b ) { return wide3<T>( fmaxf( a.x, b.x ), fmaxf( a.y, b.y ), fmaxf( a.z, b.z ) ); }
+template <class T> inline wide4<T> fmaxf( const wide4<T>& a, const wide4<T>& b ) { return wide4<T>( fmaxf( a.x, b.x ), fmaxf( a.y, b.y ), fmaxf( a.z, b.z ), fmaxf( a.w, b.w ) ); }
+template <class T> inline wide2<T> lerp( const wide2<T>& a, const wide2<T>& b, const T& t ) { return wide2<T>( lerp( a.x, b.x, t ), lerp( a.y, b.y, t ) ); }
+template <class T> inline wide3<T> lerp( const wide3<T>& a, const wide3<T>& b, const T& t ) { return wide3<T>( lerp( a.x, b.x, t ), lerp( a.y, b.y, t ), lerp( a.z, b.z, t ) ); }
+template <class T> inline wide4<T> lerp( const wide4<T>& a, const wide4<T>& b, const T& t ) { return wide4<T>( lerp( a.x, b.x, t ), lerp( a.y, b.y, t ), lerp( a.z, b.z, t ), lerp( a.w, b.w, t ) ); }
+template <class T> inline wide2<T> select( const typename T::mask& m, const wide2<T>& a, const wide2<T>& b ) { return wide2<T>( select( m, a.x, b.x ), select( m, a.y, b.y ) ); }
+template <class T> inline wide3<T> select( const typename T::mask& m, const wide3<T>& a, const wide3<T>& b )
+{
+	return wide3<T>( select( m, a.x, b.x ), select( m, a.y, b.y ), select( m, a.z, b.z ) );
+}
+template <class T> inline wide4<T> select( const typename T::mask& m, const wide4<T>& a, const wide4<T>& b )
+{
+	return wide4<T>( select( m, a.x, b.x ), select( m, a.y, b.y ), select( m, a.z, b.z ), select( m, a.w, b.w ) );
+}